@@ -0,0 +1,239 @@
+/*
+ * allocator_benchmark.c
+ *
+ * Runs small "queries" (a union of a few bitmaps intersected with another
+ * one, then counted) over a directory of real data, first with the default
+ * allocator, then with a per-query arena installed as the thread allocator:
+ * every temporary is carved out of a few large blocks and the whole arena is
+ * rewound once the query is answered, instead of freeing each container.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "benchmark.h"
+#include "numbersfromtextfiles.h"
+#include "roaring.h"
+
+enum {
+    ARENA_BLOCK_SIZE = 1 << 20,
+    ARENA_HEADER = 16,  // size of the allocation, needed by realloc
+    UNION_WIDTH = 8
+};
+
+typedef struct arena_block_s {
+    struct arena_block_s *next;
+    size_t size;
+    size_t used;
+    char *data;
+} arena_block_t;
+
+typedef struct arena_s {
+    arena_block_t *head;
+    arena_block_t *current;
+    size_t allocations;
+} arena_t;
+
+static _Thread_local arena_t arena;
+
+static arena_block_t *arena_new_block(size_t size) {
+    arena_block_t *b = malloc(sizeof(arena_block_t));
+    if (b == NULL) return NULL;
+    if (posix_memalign((void **)&b->data, 64, size)) {
+        free(b);
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+/* returns memory aligned to "alignment" with ARENA_HEADER bytes in front */
+static void *arena_alloc(size_t alignment, size_t size) {
+    arena.allocations++;
+    for (;;) {
+        arena_block_t *b = arena.current;
+        if (b != NULL) {
+            size_t start = (b->used + ARENA_HEADER + alignment - 1) &
+                           ~(alignment - 1);
+            if (start + size <= b->size) {
+                b->used = start + size;
+                memcpy(b->data + start - ARENA_HEADER, &size, sizeof(size));
+                return b->data + start;
+            }
+            if (b->next != NULL) {  // left over from a previous query
+                arena.current = b->next;
+                arena.current->used = 0;
+                continue;
+            }
+        }
+        size_t need = size + ARENA_HEADER + alignment;
+        arena_block_t *nb = arena_new_block(
+            need > ARENA_BLOCK_SIZE ? need : ARENA_BLOCK_SIZE);
+        if (nb == NULL) return NULL;
+        if (b == NULL)
+            arena.head = nb;
+        else
+            b->next = nb;
+        arena.current = nb;
+    }
+}
+
+static void *arena_malloc(size_t size) { return arena_alloc(16, size); }
+
+static void *arena_calloc(size_t nmemb, size_t size) {
+    void *p = arena_alloc(16, nmemb * size);
+    if (p != NULL) memset(p, 0, nmemb * size);
+    return p;
+}
+
+static void *arena_realloc(void *ptr, size_t size) {
+    void *p = arena_alloc(16, size);
+    if (p == NULL || ptr == NULL) return p;
+    size_t old;
+    memcpy(&old, (char *)ptr - ARENA_HEADER, sizeof(old));
+    memcpy(p, ptr, old < size ? old : size);
+    return p;
+}
+
+static void *arena_aligned_malloc(size_t alignment, size_t size) {
+    return arena_alloc(alignment < 16 ? 16 : alignment, size);
+}
+
+static void arena_free(void *ptr) { (void)ptr; }
+
+static const roaring_memory_t arena_hook = {
+    .malloc = arena_malloc,
+    .realloc = arena_realloc,
+    .calloc = arena_calloc,
+    .free = arena_free,
+    .aligned_malloc = arena_aligned_malloc,
+    .aligned_free = arena_free,
+};
+
+/* drops everything allocated since the last reset, keeping the blocks */
+static void arena_reset(void) {
+    arena.current = arena.head;
+    if (arena.current != NULL) arena.current->used = 0;
+}
+
+static void arena_destroy(void) {
+    for (arena_block_t *b = arena.head; b != NULL;) {
+        arena_block_t *next = b->next;
+        free(b->data);
+        free(b);
+        b = next;
+    }
+    memset(&arena, 0, sizeof(arena));
+}
+
+/* (x_i | ... | x_{i+UNION_WIDTH-1}) & x_{i+UNION_WIDTH} */
+static uint64_t query(roaring_bitmap_t **bitmaps, size_t i) {
+    roaring_bitmap_t *u = roaring_bitmap_or_many(
+        UNION_WIDTH, (const roaring_bitmap_t **)bitmaps + i);
+    roaring_bitmap_t *a = roaring_bitmap_and(u, bitmaps[i + UNION_WIDTH]);
+    roaring_bitmap_t *o = roaring_bitmap_or(a, bitmaps[i]);
+    uint64_t card = roaring_bitmap_get_cardinality(a) +
+                    roaring_bitmap_get_cardinality(o);
+    if (!roaring_has_thread_memory_hook()) {
+        roaring_bitmap_free(u);
+        roaring_bitmap_free(a);
+        roaring_bitmap_free(o);
+    }
+    return card;
+}
+
+static uint64_t all_queries(roaring_bitmap_t **bitmaps, size_t count,
+                            bool use_arena) {
+    uint64_t total = 0;
+    if (use_arena) roaring_set_thread_memory_hook(&arena_hook);
+    for (size_t i = 0; i + UNION_WIDTH < count; ++i) {
+        total += query(bitmaps, i);
+        if (use_arena) arena_reset();  // the query's temporaries are gone
+    }
+    if (use_arena) roaring_set_thread_memory_hook(NULL);
+    return total;
+}
+
+static void printusage(char *command) {
+    printf(
+        " Try %s directory \n where directory could be "
+        "benchmarks/realdata/census1881\n",
+        command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    char *extension = ".txt";
+    while ((c = getopt(argc, argv, "e:h")) != -1) switch (c) {
+            case 'e':
+                extension = optarg;
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    if (optind >= argc) {
+        printusage(argv[0]);
+        return -1;
+    }
+    char *dirname = argv[optind];
+    size_t count;
+    size_t *howmany = NULL;
+    uint32_t **numbers =
+        read_all_integer_files(dirname, extension, &howmany, &count);
+    if (numbers == NULL) {
+        printf(
+            "I could not find or load any data file with extension %s in "
+            "directory %s.\n",
+            extension, dirname);
+        return -1;
+    }
+    if (count <= UNION_WIDTH) {
+        printf("Need more than %d files in %s.\n", UNION_WIDTH, dirname);
+        return -1;
+    }
+    // the inputs are allocated with the default allocator and must not share
+    // containers with the (arena allocated) results
+    roaring_bitmap_t **bitmaps = malloc(sizeof(roaring_bitmap_t *) * count);
+    for (size_t i = 0; i < count; i++) {
+        bitmaps[i] = roaring_bitmap_of_ptr(howmany[i], numbers[i]);
+        bitmaps[i]->copy_on_write = false;
+    }
+    printf("Loaded %zu bitmaps from directory %s \n", count, dirname);
+    const size_t nqueries = count - UNION_WIDTH;
+
+    uint64_t best[2] = {UINT64_MAX, UINT64_MAX};
+    uint64_t answer[2] = {0, 0};
+    uint64_t cycles_start = 0, cycles_final = 0;
+    for (int r = 0; r < 10; ++r) {
+        for (int use_arena = 0; use_arena <= 1; ++use_arena) {
+            RDTSC_START(cycles_start);
+            answer[use_arena] = all_queries(bitmaps, count, use_arena);
+            RDTSC_FINAL(cycles_final);
+            if (cycles_final - cycles_start < best[use_arena])
+                best[use_arena] = cycles_final - cycles_start;
+        }
+    }
+    if (answer[0] != answer[1]) {
+        printf("the arena changed the results\n");
+        return -1;
+    }
+    printf(" %zu queries, default allocator: %" PRIu64 " cycles (%.0f/query)\n",
+           nqueries, best[0], best[0] * 1.0 / nqueries);
+    printf(" %zu queries, per-query arena:   %" PRIu64 " cycles (%.0f/query)\n",
+           nqueries, best[1], best[1] * 1.0 / nqueries);
+    printf(" arena: %zu allocations per run\n", arena.allocations / 10);
+    arena_destroy();
+
+    for (size_t i = 0; i < count; ++i) {
+        free(numbers[i]);
+        roaring_bitmap_free(bitmaps[i]);
+    }
+    free(bitmaps);
+    free(howmany);
+    free(numbers);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * and_inplace_benchmark.c
+ *
+ * Times roaring_bitmap_and_inplace for each pair of container types and
+ * counts how many times it calls the allocator (the container pool is
+ * disabled so that every allocation is seen).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "containers/pool.h"
+#include "random.h"
+#include "roaring.h"
+
+enum { NUM_KEYS = 64, REPEAT = 20 };
+
+static uint64_t allocations;
+
+static void *counting_malloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+    allocations++;
+    return realloc(ptr, size);
+}
+
+static void *counting_calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return calloc(nmemb, size);
+}
+
+static void *counting_aligned_malloc(size_t alignment, size_t size) {
+    void *p;
+    allocations++;
+    if (posix_memalign(&p, alignment, size)) return NULL;
+    return p;
+}
+
+static const roaring_memory_t counting_hook = {
+    .malloc = counting_malloc,
+    .realloc = counting_realloc,
+    .calloc = counting_calloc,
+    .free = free,
+    .aligned_malloc = counting_aligned_malloc,
+    .aligned_free = free,
+};
+
+/* NUM_KEYS array containers of 500 random values */
+static roaring_bitmap_t *make_arrays(void) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t key = 0; key < NUM_KEYS; ++key)
+        for (int i = 0; i < 500; ++i)
+            roaring_bitmap_add(r, (key << 16) | ranged_random(1 << 16));
+    return r;
+}
+
+/* NUM_KEYS bitset containers, about half full */
+static roaring_bitmap_t *make_bitsets(void) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t key = 0; key < NUM_KEYS; ++key)
+        for (uint32_t x = 0; x < (1 << 16); ++x)
+            if (pcg32_random() & 1) roaring_bitmap_add(r, (key << 16) | x);
+    return r;
+}
+
+/* NUM_KEYS run containers: a run of width values every step values */
+static roaring_bitmap_t *make_runs(uint32_t step, uint32_t width) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t key = 0; key < NUM_KEYS; ++key)
+        for (uint32_t x = 0; x < (1 << 16); x += step)
+            for (uint32_t y = x; y < x + width && y < (1 << 16); ++y)
+                roaring_bitmap_add(r, (key << 16) | y);
+    roaring_bitmap_run_optimize(r);
+    return r;
+}
+
+static void and_inplace_test(const char *name, const roaring_bitmap_t *x1,
+                             const roaring_bitmap_t *x2) {
+    roaring_bitmap_t *expected = roaring_bitmap_and(x1, x2);
+    const uint64_t answer = roaring_bitmap_get_cardinality(expected);
+    roaring_bitmap_free(expected);
+    uint64_t best = UINT64_MAX, calls = 0;
+    bool wrong_answer = false;
+    for (int i = 0; i < REPEAT; ++i) {
+        roaring_bitmap_t *r = roaring_bitmap_copy(x1);
+        uint64_t cycles_start, cycles_final;
+        allocations = 0;
+        RDTSC_START(cycles_start);
+        roaring_bitmap_and_inplace(r, x2);
+        RDTSC_FINAL(cycles_final);
+        calls = allocations;
+        if (cycles_final - cycles_start < best)
+            best = cycles_final - cycles_start;
+        if (roaring_bitmap_get_cardinality(r) != answer) wrong_answer = true;
+        roaring_bitmap_free(r);
+    }
+    printf("%-16s %10.2f cycles per container %6.2f allocations per container",
+           name, best * 1.0 / NUM_KEYS, calls * 1.0 / NUM_KEYS);
+    if (wrong_answer) printf(" [ERROR]");
+    printf("\n");
+}
+
+int main() {
+    roaring_pool_set_enabled(false);
+    roaring_init_memory_hook(&counting_hook);
+    roaring_bitmap_t *arrays1 = make_arrays();
+    roaring_bitmap_t *arrays2 = make_arrays();
+    roaring_bitmap_t *bitsets = make_bitsets();
+    roaring_bitmap_t *runs1 = make_runs(200, 50);
+    roaring_bitmap_t *runs2 = make_runs(170, 30);
+
+    and_inplace_test("array &= array", arrays1, arrays2);
+    and_inplace_test("array &= bitset", arrays1, bitsets);
+    and_inplace_test("array &= run", arrays1, runs1);
+    and_inplace_test("run &= run", runs1, runs2);
+    and_inplace_test("bitset &= run", bitsets, runs1);
+    and_inplace_test("bitset &= array", bitsets, arrays1);
+    and_inplace_test("run &= array", runs1, arrays1);
+
+    roaring_bitmap_free(arrays1);
+    roaring_bitmap_free(arrays2);
+    roaring_bitmap_free(bitsets);
+    roaring_bitmap_free(runs1);
+    roaring_bitmap_free(runs2);
+    roaring_init_memory_hook(NULL);
+    return 0;
+}
@@ -66,6 +66,20 @@ int intersection_test(array_container_t* B1, array_container_t* B2,
     array_container_intersection(B1, B2, BO);
     return BO->cardinality;
 }
+int intersection_cardinality_test(array_container_t* B1,
+                                  array_container_t* B2) {
+    return array_container_intersection_cardinality(B1, B2);
+}
+
+int union_cardinality_test(array_container_t* B1, array_container_t* B2) {
+    return array_container_union_cardinality(B1, B2);
+}
+
+/* whether at least 10 values are shared, usually decided early */
+int intersection_at_least_test(array_container_t* B1, array_container_t* B2) {
+    return array_container_intersection_cardinality_at_least(B1, B2, 10);
+}
+
 int main() {
     int repeat = 500;
     int size = TESTSIZE;
@@ -131,6 +145,11 @@ int main() {
     answer = intersection_test(B1, B2, BO);
     printf("intersection cardinality = %d \n", answer);
     BEST_TIME(intersection_test(B1, B2, BO), answer, repeat, answer);
+    int union_answer = union_test(B1, B2, BO);
+    BEST_TIME(union_cardinality_test(B1, B2), union_answer, repeat, inputsize);
+    BEST_TIME(intersection_cardinality_test(B1, B2), answer, repeat, answer);
+    BEST_TIME(intersection_at_least_test(B1, B2), (answer >= 10), repeat,
+              answer);
     printf("==intersection and union test 2 \n");
     array_container_clear(B1);
     array_container_clear(B2);
@@ -149,6 +168,11 @@ int main() {
     answer = intersection_test(B1, B2, BO);
     printf("intersection cardinality = %d \n", answer);
     BEST_TIME(intersection_test(B1, B2, BO), answer, repeat, answer);
+    union_answer = union_test(B1, B2, BO);
+    BEST_TIME(union_cardinality_test(B1, B2), union_answer, repeat, inputsize);
+    BEST_TIME(intersection_cardinality_test(B1, B2), answer, repeat, answer);
+    BEST_TIME(intersection_at_least_test(B1, B2), (answer >= 10), repeat,
+              answer);
 
     array_container_free(B1);
     array_container_free(B2);
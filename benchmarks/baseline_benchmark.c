@@ -0,0 +1,364 @@
+/*
+ * baseline_benchmark.c
+ *
+ * Runs the same operations on the sets of realdata directories stored as
+ * flat bitsets (one bit per value up to the largest value of the dataset),
+ * as sorted uint32 arrays (with intersection_uint32 and union_uint32 from
+ * array_util.c) and as roaring bitmaps, with and without run containers:
+ *
+ *   baseline_benchmark [-f csv] [-r repeat] benchmarks/realdata/census1881
+ *
+ * "and" and "or" combine successive sets and write the result (a bitset,
+ * an array or a bitmap), "contains" looks up the values of the next set,
+ * "iterate" adds up the values. Times are in cycles per value, best of
+ * repeat; memory is in bits per value. The flat bitsets are skipped when
+ * they would take more than MAX_BITSET_BYTES.
+ */
+#define _GNU_SOURCE
+#include "array_util.h"
+#include "benchmark.h"
+#include "numbersfromtextfiles.h"
+#include "roaring.h"
+
+enum { NUM_STRUCTURES = 4, NUM_OPERATIONS = 5 };
+
+static const size_t MAX_BITSET_BYTES = (size_t)1 << 30;
+
+static const char *structure_names[NUM_STRUCTURES] = {
+    "bitset", "sorted array", "roaring", "roaring+runs"};
+static const char *operation_names[NUM_OPERATIONS] = {
+    "and", "or", "contains", "iterate", "memory (bits)"};
+
+typedef struct dataset_s {
+    size_t count;
+    size_t *howmany;
+    uint32_t **numbers;
+    uint64_t total;       // number of values
+    uint64_t pair_total;  // values in the successive pairs
+    size_t words;         // per flat bitset, 0 if skipped
+    uint64_t **bitsets;
+    roaring_bitmap_t **bitmaps;
+} dataset_t;
+
+static int repeat = 5;
+
+/* best of repeat, in cycles, of running body */
+#define BEST_CYCLES(best, body)                                     \
+    do {                                                            \
+        best = UINT64_MAX;                                          \
+        for (int r = 0; r < repeat; ++r) {                          \
+            uint64_t cycles_start, cycles_final;                    \
+            RDTSC_START(cycles_start);                              \
+            body;                                                   \
+            RDTSC_FINAL(cycles_final);                              \
+            if (cycles_final - cycles_start < best)                 \
+                best = cycles_final - cycles_start;                 \
+        }                                                           \
+    } while (0)
+
+static bool array_contains(const uint32_t *array, size_t n, uint32_t x) {
+    size_t low = 0, high = n;
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        if (array[middle] < x)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < n && array[low] == x;
+}
+
+static void sum_iterator(uint32_t value, void *param) {
+    *(uint64_t *)param += value;
+}
+
+/* times[operation] in cycles per value (memory in bits per value) for one
+ * structure, or -1 when not measured; checksums[operation] to compare */
+static void measure_bitset(const dataset_t *d, double *times,
+                           uint64_t *checksums) {
+    uint64_t best;
+    uint64_t *out = malloc(d->words * sizeof(uint64_t));
+    BEST_CYCLES(best, {
+        checksums[0] = 0;
+        for (size_t i = 0; i + 1 < d->count; ++i) {
+            for (size_t w = 0; w < d->words; ++w)
+                out[w] = d->bitsets[i][w] & d->bitsets[i + 1][w];
+            checksums[0] += out[d->words / 2];  // keep the loop
+        }
+    });
+    times[0] = best * 1.0 / d->pair_total;
+    BEST_CYCLES(best, {
+        checksums[1] = 0;
+        for (size_t i = 0; i + 1 < d->count; ++i) {
+            for (size_t w = 0; w < d->words; ++w)
+                out[w] = d->bitsets[i][w] | d->bitsets[i + 1][w];
+            checksums[1] += out[d->words / 2];
+        }
+    });
+    times[1] = best * 1.0 / d->pair_total;
+    free(out);
+    BEST_CYCLES(best, {
+        checksums[2] = 0;
+        for (size_t i = 0; i < d->count; ++i) {
+            const size_t j = (i + 1) % d->count;
+            for (size_t k = 0; k < d->howmany[j]; ++k) {
+                const uint32_t x = d->numbers[j][k];
+                checksums[2] += (d->bitsets[i][x >> 6] >> (x & 63)) & 1;
+            }
+        }
+    });
+    times[2] = best * 1.0 / d->total;
+    BEST_CYCLES(best, {
+        checksums[3] = 0;
+        for (size_t i = 0; i < d->count; ++i)
+            for (size_t w = 0; w < d->words; ++w)
+                for (uint64_t bits = d->bitsets[i][w]; bits != 0;
+                     bits &= bits - 1)
+                    checksums[3] += w * 64 + __builtin_ctzll(bits);
+    });
+    times[3] = best * 1.0 / d->total;
+    times[4] = d->count * d->words * 64.0 / d->total;
+}
+
+static void measure_array(const dataset_t *d, double *times,
+                          uint64_t *checksums) {
+    uint64_t best;
+    size_t largest = 0;
+    for (size_t i = 0; i < d->count; ++i)
+        if (d->howmany[i] > largest) largest = d->howmany[i];
+    uint32_t *out = malloc(2 * largest * sizeof(uint32_t) + 1);
+    BEST_CYCLES(best, {
+        checksums[0] = 0;
+        for (size_t i = 0; i + 1 < d->count; ++i)
+            checksums[0] +=
+                intersection_uint32(d->numbers[i], d->howmany[i],
+                                    d->numbers[i + 1], d->howmany[i + 1], out);
+    });
+    times[0] = best * 1.0 / d->pair_total;
+    BEST_CYCLES(best, {
+        checksums[1] = 0;
+        for (size_t i = 0; i + 1 < d->count; ++i)
+            checksums[1] += union_uint32(d->numbers[i], d->howmany[i],
+                                         d->numbers[i + 1], d->howmany[i + 1],
+                                         out);
+    });
+    times[1] = best * 1.0 / d->pair_total;
+    free(out);
+    BEST_CYCLES(best, {
+        checksums[2] = 0;
+        for (size_t i = 0; i < d->count; ++i) {
+            const size_t j = (i + 1) % d->count;
+            for (size_t k = 0; k < d->howmany[j]; ++k)
+                checksums[2] += array_contains(d->numbers[i], d->howmany[i],
+                                               d->numbers[j][k]);
+        }
+    });
+    times[2] = best * 1.0 / d->total;
+    BEST_CYCLES(best, {
+        checksums[3] = 0;
+        for (size_t i = 0; i < d->count; ++i)
+            for (size_t k = 0; k < d->howmany[i]; ++k)
+                checksums[3] += d->numbers[i][k];
+    });
+    times[3] = best * 1.0 / d->total;
+    times[4] = 32;
+}
+
+static void measure_roaring(const dataset_t *d, roaring_bitmap_t **bitmaps,
+                            double *times, uint64_t *checksums) {
+    uint64_t best;
+    roaring_bitmap_t **out = malloc(d->count * sizeof(roaring_bitmap_t *));
+    uint64_t cards[2] = {0, 0};
+    for (int op = 0; op < 2; ++op) {
+        best = UINT64_MAX;
+        for (int r = 0; r < repeat; ++r) {
+            uint64_t cycles_start, cycles_final;
+            RDTSC_START(cycles_start);
+            for (size_t i = 0; i + 1 < d->count; ++i)
+                out[i] = op == 0 ? roaring_bitmap_and(bitmaps[i], bitmaps[i + 1])
+                                 : roaring_bitmap_or(bitmaps[i], bitmaps[i + 1]);
+            RDTSC_FINAL(cycles_final);
+            if (cycles_final - cycles_start < best)
+                best = cycles_final - cycles_start;
+            cards[op] = 0;
+            for (size_t i = 0; i + 1 < d->count; ++i) {
+                cards[op] += roaring_bitmap_get_cardinality(out[i]);
+                roaring_bitmap_free(out[i]);
+            }
+        }
+        times[op] = best * 1.0 / d->pair_total;
+        checksums[op] = cards[op];
+    }
+    free(out);
+    BEST_CYCLES(best, {
+        checksums[2] = 0;
+        for (size_t i = 0; i < d->count; ++i) {
+            const size_t j = (i + 1) % d->count;
+            for (size_t k = 0; k < d->howmany[j]; ++k)
+                checksums[2] +=
+                    roaring_bitmap_contains(bitmaps[i], d->numbers[j][k]);
+        }
+    });
+    times[2] = best * 1.0 / d->total;
+    BEST_CYCLES(best, {
+        checksums[3] = 0;
+        for (size_t i = 0; i < d->count; ++i)
+            roaring_iterate(bitmaps[i], sum_iterator, &checksums[3]);
+    });
+    times[3] = best * 1.0 / d->total;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < d->count; ++i) {
+        roaring_statistics_t stats;
+        roaring_bitmap_statistics(bitmaps[i], &stats);
+        bytes += stats.n_bytes;
+    }
+    times[4] = bytes * 8.0 / d->total;
+}
+
+static void printusage(char *command) {
+    printf(" Try %s [-f csv] [-r repeat] directory... \n"
+           " where directory could be benchmarks/realdata/census1881\n",
+           command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    bool csv = false;
+    char *extension = ".txt";
+    while ((c = getopt(argc, argv, "e:f:r:h")) != -1) switch (c) {
+            case 'e':
+                extension = optarg;
+                break;
+            case 'f':
+                csv = strcmp(optarg, "csv") == 0;
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                if (repeat < 1) repeat = 1;
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    if (optind >= argc) {
+        printusage(argv[0]);
+        return -1;
+    }
+    if (csv) printf("dataset,operation,structure,value\n");
+    bool ok = true;
+    for (; optind < argc; ++optind) {
+        dataset_t d;
+        memset(&d, 0, sizeof(d));
+        d.numbers =
+            read_all_integer_files(argv[optind], extension, &d.howmany,
+                                   &d.count);
+        if (d.numbers == NULL || d.count < 2) {
+            fprintf(stderr,
+                    "I could not find or load two data files with extension "
+                    "%s in directory %s.\n",
+                    extension, argv[optind]);
+            for (size_t i = 0; d.numbers != NULL && i < d.count; ++i)
+                free(d.numbers[i]);
+            free(d.numbers);
+            free(d.howmany);
+            continue;
+        }
+        char name[256];
+        snprintf(name, sizeof(name), "%s", argv[optind]);
+        for (size_t len = strlen(name); len > 1 && name[len - 1] == '/';)
+            name[--len] = '\0';
+        const char *dataset =
+            strrchr(name, '/') == NULL ? name : strrchr(name, '/') + 1;
+
+        // the arrays must be sorted and without duplicates
+        uint32_t largest = 0;
+        d.bitmaps = malloc(d.count * sizeof(roaring_bitmap_t *));
+        for (size_t i = 0; i < d.count; ++i) {
+            d.bitmaps[i] = roaring_bitmap_of_ptr(d.howmany[i], d.numbers[i]);
+            free(d.numbers[i]);
+            uint32_t card;
+            d.numbers[i] = roaring_bitmap_to_uint32_array(d.bitmaps[i], &card);
+            d.howmany[i] = card;
+            d.total += card;
+            if (card > 0 && d.numbers[i][card - 1] > largest)
+                largest = d.numbers[i][card - 1];
+        }
+        for (size_t i = 0; i + 1 < d.count; ++i)
+            d.pair_total += d.howmany[i] + d.howmany[i + 1];
+        d.words = largest / 64 + 1;
+        if (d.count * d.words * sizeof(uint64_t) > MAX_BITSET_BYTES)
+            d.words = 0;
+        if (d.words > 0) {
+            d.bitsets = malloc(d.count * sizeof(uint64_t *));
+            for (size_t i = 0; i < d.count; ++i) {
+                d.bitsets[i] = calloc(d.words, sizeof(uint64_t));
+                for (size_t k = 0; k < d.howmany[i]; ++k)
+                    d.bitsets[i][d.numbers[i][k] >> 6] |=
+                        UINT64_C(1) << (d.numbers[i][k] & 63);
+            }
+        }
+
+        double times[NUM_STRUCTURES][NUM_OPERATIONS];
+        uint64_t checksums[NUM_STRUCTURES][NUM_OPERATIONS];
+        if (d.words > 0) measure_bitset(&d, times[0], checksums[0]);
+        measure_array(&d, times[1], checksums[1]);
+        measure_roaring(&d, d.bitmaps, times[2], checksums[2]);
+        for (size_t i = 0; i < d.count; ++i)
+            roaring_bitmap_run_optimize(d.bitmaps[i]);
+        measure_roaring(&d, d.bitmaps, times[3], checksums[3]);
+
+        // the arrays give the cardinalities of "and" and "or", the bitset
+        // checksums of those are words, not cardinalities
+        for (int s = 2; s < NUM_STRUCTURES; ++s)
+            for (int op = 0; op < 4; ++op)
+                if (checksums[s][op] != checksums[1][op]) {
+                    fprintf(stderr, "%s: %s disagrees on %s\n", dataset,
+                            structure_names[s], operation_names[op]);
+                    ok = false;
+                }
+        if (d.words > 0)
+            for (int op = 2; op < 4; ++op)
+                if (checksums[0][op] != checksums[1][op]) {
+                    fprintf(stderr, "%s: bitset disagrees on %s\n", dataset,
+                            operation_names[op]);
+                    ok = false;
+                }
+
+        if (!csv) {
+            printf("%s: %zu sets, %" PRIu64 " values, cycles per value\n",
+                   dataset, d.count, d.total);
+            printf("%-14s", "");
+            for (int s = 0; s < NUM_STRUCTURES; ++s)
+                printf(" %14s", structure_names[s]);
+            printf("\n");
+        }
+        for (int op = 0; op < NUM_OPERATIONS; ++op) {
+            if (!csv) printf("%-14s", operation_names[op]);
+            for (int s = 0; s < NUM_STRUCTURES; ++s) {
+                const bool skipped = s == 0 && d.words == 0;
+                if (csv && !skipped)
+                    printf("%s,%s,%s,%.3f\n", dataset, operation_names[op],
+                           structure_names[s], times[s][op]);
+                else if (!csv && skipped)
+                    printf(" %14s", "-");
+                else if (!csv)
+                    printf(" %14.3f", times[s][op]);
+            }
+            if (!csv) printf("\n");
+        }
+        if (!csv) printf("\n");
+
+        for (size_t i = 0; i < d.count; ++i) {
+            free(d.numbers[i]);
+            roaring_bitmap_free(d.bitmaps[i]);
+            if (d.words > 0) free(d.bitsets[i]);
+        }
+        free(d.bitsets);
+        free(d.bitmaps);
+        free(d.howmany);
+        free(d.numbers);
+    }
+    return ok ? 0 : -1;
+}
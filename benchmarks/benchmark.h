@@ -4,6 +4,121 @@
 #ifndef BENCHMARKS_INCLUDE_BENCHMARK_H_
 #define BENCHMARKS_INCLUDE_BENCHMARK_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Hardware counters (Linux perf_event_open) are read around every BEST_TIME
+ * measurement when the kernel lets us, define BENCHMARK_NO_PERF_EVENTS to
+ * keep to rdtsc only. */
+#if defined(__linux__) && !defined(BENCHMARK_NO_PERF_EVENTS)
+#define BENCHMARK_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+long syscall(long number, ...);  // hidden by -std=c11
+#endif
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_NUM_COUNTERS
+};
+
+/* UINT64_MAX for a counter that could not be opened */
+typedef struct perf_counters_s {
+    uint64_t values[PERF_NUM_COUNTERS];
+} perf_counters_t;
+
+static int perf_fds[PERF_NUM_COUNTERS];
+static int perf_state;  // 0: not tried yet, 1: some counters, -1: none
+
+/* Open the counters of this thread, once. Returns false if there are none,
+ * as in most containers and virtual machines. */
+static inline bool perf_counters_open(void) {
+    if (perf_state != 0) return perf_state > 0;
+    perf_state = -1;
+#ifdef BENCHMARK_PERF_EVENTS
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[PERF_NUM_COUNTERS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE,
+         PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}};
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // scaled by enabled/running time if the counters are multiplexed
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf_fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (perf_fds[i] >= 0) perf_state = 1;
+    }
+#endif
+    return perf_state > 0;
+}
+
+/* out of line, around the measured code rather than in it */
+static __attribute__((unused, noinline)) void perf_counters_start(void) {
+#ifdef BENCHMARK_PERF_EVENTS
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (perf_fds[i] < 0) continue;
+        ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static __attribute__((unused, noinline)) void perf_counters_stop(
+    perf_counters_t *c) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) c->values[i] = UINT64_MAX;
+#ifdef BENCHMARK_PERF_EVENTS
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i)
+        if (perf_fds[i] >= 0) ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    for (int i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        uint64_t data[3];  // value, time enabled, time running
+        if (perf_fds[i] < 0 ||
+            read(perf_fds[i], data, sizeof(data)) != sizeof(data))
+            continue;
+        c->values[i] = data[2] == 0 || data[2] == data[1]
+                           ? data[0]
+                           : (uint64_t)((double)data[0] * data[1] / data[2]);
+    }
+#endif
+}
+
+/* Prints the counters per operation, or nothing if there are none. */
+static inline void perf_counters_print(const perf_counters_t *c,
+                                       double size) {
+    static const char *names[PERF_NUM_COUNTERS] = {
+        NULL, "instructions", "branch misses", "L1D misses", "LLC misses"};
+    if (perf_state <= 0) return;
+    for (int i = 1; i < PERF_NUM_COUNTERS; ++i)
+        if (c->values[i] != UINT64_MAX)
+            printf(", %.2f %s", c->values[i] / size, names[i]);
+    if (c->values[PERF_CYCLES] != UINT64_MAX &&
+        c->values[PERF_INSTRUCTIONS] != UINT64_MAX &&
+        c->values[PERF_CYCLES] > 0)
+        printf(", %.2f IPC", (double)c->values[PERF_INSTRUCTIONS] /
+                                 c->values[PERF_CYCLES]);
+}
+
 #define RDTSC_START(cycles)                                                   \
     do {                                                                      \
         register unsigned cyc_high, cyc_low;                                  \
@@ -32,7 +147,8 @@
  * Prints the best number of operations per cycle where
  * test is the function call, answer is the expected answer generated by
  * test, repeat is the number of times we should repeat and size is the
- * number of operations represented by test.
+ * number of operations represented by test. The hardware counters, if any,
+ * are those of the best run.
  */
 #define BEST_TIME(test, answer, repeat, size)                         \
     do {                                                              \
@@ -41,17 +157,25 @@
         uint64_t cycles_start, cycles_final, cycles_diff;             \
         uint64_t min_diff = (uint64_t)-1;                             \
         int wrong_answer = 0;                                         \
+        const bool with_counters = perf_counters_open();              \
+        perf_counters_t counters = {{0}}, best_counters = {{0}};      \
         for (int i = 0; i < repeat; i++) {                            \
             __asm volatile("" ::: /* pretend to clobber */ "memory"); \
+            if (with_counters) perf_counters_start();                 \
             RDTSC_START(cycles_start);                                \
             if (test != answer) wrong_answer = 1;                     \
             RDTSC_FINAL(cycles_final);                                \
+            if (with_counters) perf_counters_stop(&counters);         \
             cycles_diff = (cycles_final - cycles_start);              \
-            if (cycles_diff < min_diff) min_diff = cycles_diff;       \
+            if (cycles_diff < min_diff) {                             \
+                min_diff = cycles_diff;                               \
+                best_counters = counters;                             \
+            }                                                         \
         }                                                             \
         uint64_t S = (uint64_t)size;                                  \
         float cycle_per_op = (min_diff) / (float)S;                   \
         printf(" %.2f cycles per operation", cycle_per_op);           \
+        if (with_counters) perf_counters_print(&best_counters, S);    \
         if (wrong_answer) printf(" [ERROR]");                         \
         printf("\n");                                                 \
         fflush(NULL);                                                 \
@@ -60,7 +184,8 @@
 /*
  * This is like BEST_TIME except that ... it runs functions "test" using the
  * first parameter "base" and various parameters from "testvalues" (there
- * are nbrtestvalues), calling pre on base between tests
+ * are nbrtestvalues), calling pre on base between tests. The hardware
+ * counters, if any, are averaged like the cycles.
  */
 #define BEST_TIME_PRE_ARRAY(base, test, pre, testvalues, nbrtestvalues) \
     do {                                                                \
@@ -68,18 +193,30 @@
         fflush(NULL);                                                   \
         uint64_t cycles_start, cycles_final, cycles_diff;               \
         int sum = 0;                                                    \
+        const bool with_counters = perf_counters_open();                \
+        perf_counters_t counters = {{0}}, total_counters;               \
+        memset(&total_counters, 0, sizeof(total_counters));             \
         for (size_t j = 0; j < nbrtestvalues; j++) {                    \
             pre(base);                                                  \
             __asm volatile("" ::: /* pretend to clobber */ "memory");   \
+            if (with_counters) perf_counters_start();                   \
             RDTSC_START(cycles_start);                                  \
             test(base, testvalues[j]);                                  \
             RDTSC_FINAL(cycles_final);                                  \
+            if (with_counters) perf_counters_stop(&counters);           \
             cycles_diff = (cycles_final - cycles_start);                \
             sum += cycles_diff;                                         \
+            for (int k = 0; with_counters && k < PERF_NUM_COUNTERS; k++) \
+                total_counters.values[k] =                              \
+                    counters.values[k] == UINT64_MAX ||                 \
+                            total_counters.values[k] == UINT64_MAX      \
+                        ? UINT64_MAX                                    \
+                        : total_counters.values[k] + counters.values[k]; \
         }                                                               \
         uint64_t S = (uint64_t)nbrtestvalues;                           \
         float cycle_per_op = sum / (float)S;                            \
         printf(" %.2f cycles per operation", cycle_per_op);             \
+        if (with_counters) perf_counters_print(&total_counters, S);     \
         printf("\n");                                                   \
         fflush(NULL);                                                   \
     } while (0)
@@ -0,0 +1,148 @@
+/*
+ * bsi_benchmark.c
+ *
+ * Builds a bit-sliced index over a synthetic integer column (10^8 rows by
+ * default, see -n) and times range queries, sums and top-k over a foundset
+ * against scanning the column. The scans only count or add up, they do not
+ * build a bitmap, so they are a lower bound for what a scan costs.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "roaring.h"
+#include "roaring_bsi.h"
+#include "random.h"
+
+enum { MAX_VALUE = 1000000, REPEAT = 3 };
+
+static uint32_t rows = 100000000;
+static uint32_t *column;
+
+typedef struct query_s {
+    uint64_t low;
+    uint64_t high;
+    const roaring_bitmap_t *foundset;
+} query_t;
+
+static void scan_sum_iterator(uint32_t value, void *param) {
+    *(uint64_t *)param += column[value];
+}
+
+static uint64_t scan_range(const query_t *q) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < rows; ++i)
+        count += column[i] >= q->low && column[i] <= q->high;
+    return count;
+}
+
+static uint64_t bsi_range(const roaring_bsi_t *b, const query_t *q) {
+    roaring_bitmap_t *r = roaring_bsi_range(b, q->low, q->high, q->foundset);
+    const uint64_t card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_free(r);
+    return card;
+}
+
+static uint64_t bsi_less(const roaring_bsi_t *b, const query_t *q) {
+    roaring_bitmap_t *r =
+        roaring_bsi_compare(b, ROARING_BSI_LT, q->high, q->foundset);
+    const uint64_t card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_free(r);
+    return card;
+}
+
+static uint64_t scan_less(const query_t *q) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < rows; ++i) count += column[i] < q->high;
+    return count;
+}
+
+static uint64_t scan_sum(const query_t *q) {
+    uint64_t sum = 0;
+    roaring_iterate((roaring_bitmap_t *)q->foundset, scan_sum_iterator, &sum);
+    return sum;
+}
+
+static uint64_t bsi_sum(const roaring_bsi_t *b, const query_t *q) {
+    return roaring_bsi_sum(b, q->foundset, NULL);
+}
+
+static uint64_t bsi_top(const roaring_bsi_t *b, const query_t *q) {
+    roaring_bitmap_t *r = roaring_bsi_top_k(b, 10, q->foundset);
+    const uint64_t card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_free(r);
+    return card;
+}
+
+/* best of REPEAT, in cycles per row */
+#define TIME_QUERY(name, expression)                                   \
+    do {                                                               \
+        uint64_t best = UINT64_MAX, answer = 0, start, final;          \
+        for (int r = 0; r < REPEAT; ++r) {                             \
+            RDTSC_START(start);                                        \
+            answer = expression;                                       \
+            RDTSC_FINAL(final);                                        \
+            if (final - start < best) best = final - start;            \
+        }                                                              \
+        printf("%-34s %10.3f cycles per row (answer %llu)\n", name,    \
+               best * 1.0 / rows, (unsigned long long)answer);         \
+    } while (0)
+
+static void printusage(char *command) {
+    printf(" Try %s -n rows \n", command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "n:h")) != -1) switch (c) {
+            case 'n':
+                rows = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    column = malloc((size_t)rows * sizeof(uint32_t));
+    uint64_t *chunk = malloc((1 << 16) * sizeof(uint64_t));
+    roaring_bsi_t *b = roaring_bsi_create();
+    roaring_bitmap_t *foundset = roaring_bitmap_create();
+    for (uint64_t start = 0; start < rows; start += 1 << 16) {
+        const uint32_t n = rows - start < (1 << 16) ? rows - start : 1 << 16;
+        for (uint32_t j = 0; j < n; ++j) {
+            column[start + j] = ranged_random(MAX_VALUE);
+            chunk[j] = column[start + j];
+        }
+        roaring_bsi_append(b, (uint32_t)start, chunk, n);
+    }
+    // a foundset of about 10% of the rows: runs of 1000 and scattered rows
+    for (uint32_t row = 0; row < rows; ++row)
+        if ((row / 1000) % 20 == 0 || ranged_random(20) == 0)
+            roaring_bitmap_add(foundset, row);
+    roaring_bitmap_run_optimize(foundset);
+    roaring_statistics_t stats;
+    roaring_bitmap_statistics(b->ebm, &stats);
+    printf("%u rows, %d slices, %zu bytes in the existence bitmap\n", rows,
+           b->bit_depth, stats.n_bytes);
+
+    const query_t narrow = {400000, 410000, NULL};
+    const query_t filtered = {400000, 410000, foundset};
+    TIME_QUERY("BETWEEN 1% scan", scan_range(&narrow));
+    TIME_QUERY("BETWEEN 1% bsi", bsi_range(b, &narrow));
+    TIME_QUERY("BETWEEN 1% of foundset bsi", bsi_range(b, &filtered));
+    const query_t half = {0, MAX_VALUE / 2, NULL};
+    TIME_QUERY("< 50% scan", scan_less(&half));
+    TIME_QUERY("< 50% bsi", bsi_less(b, &half));
+    TIME_QUERY("sum of foundset scan", scan_sum(&filtered));
+    TIME_QUERY("sum of foundset bsi", bsi_sum(b, &filtered));
+    TIME_QUERY("top 10 of foundset bsi", bsi_top(b, &filtered));
+
+    roaring_bitmap_free(foundset);
+    roaring_bsi_free(b);
+    free(chunk);
+    free(column);
+    return 0;
+}
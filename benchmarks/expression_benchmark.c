@@ -0,0 +1,138 @@
+/*
+ * expression_benchmark.c
+ *
+ * Evaluates (A | B | C) & ~D & (E | F) over consecutive bitmaps of a
+ * directory of real data, first with one bitmap operation per node (each
+ * building an intermediate bitmap, ~D is a flip over the range of the data),
+ * then with a roaring_expression_t evaluated key by key.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "benchmark.h"
+#include "numbersfromtextfiles.h"
+#include "roaring.h"
+#include "roaring_expression.h"
+
+enum { OPERANDS = 6 };
+
+static uint64_t query_with_operations(roaring_bitmap_t **x, uint64_t range) {
+    roaring_bitmap_t *answer =
+        roaring_bitmap_or_many(3, (const roaring_bitmap_t **)x);
+    roaring_bitmap_t *notd = roaring_bitmap_flip(x[3], 0, range);
+    roaring_bitmap_and_inplace(answer, notd);
+    roaring_bitmap_t *ef = roaring_bitmap_or(x[4], x[5]);
+    roaring_bitmap_and_inplace(answer, ef);
+    const uint64_t card = roaring_bitmap_get_cardinality(answer);
+    roaring_bitmap_free(answer);
+    roaring_bitmap_free(notd);
+    roaring_bitmap_free(ef);
+    return card;
+}
+
+static uint64_t query_with_expression(roaring_bitmap_t **x) {
+    roaring_expression_t *e = roaring_expression_create();
+    for (int i = 0; i < OPERANDS; ++i) roaring_expression_bitmap(e, x[i]);
+    const int32_t abc =
+        roaring_expression_or(e, roaring_expression_or(e, 0, 1), 2);
+    const int32_t ef = roaring_expression_or(e, 4, 5);
+    const int32_t root =
+        roaring_expression_andnot(e, roaring_expression_and(e, abc, ef), 3);
+    roaring_bitmap_t *answer = roaring_expression_evaluate(e, root);
+    const uint64_t card = roaring_bitmap_get_cardinality(answer);
+    roaring_bitmap_free(answer);
+    roaring_expression_free(e);
+    return card;
+}
+
+static uint64_t all_queries(roaring_bitmap_t **bitmaps, size_t count,
+                            uint64_t range, bool use_expression) {
+    uint64_t total = 0;
+    for (size_t i = 0; i + OPERANDS <= count; ++i)
+        total += use_expression ? query_with_expression(bitmaps + i)
+                                : query_with_operations(bitmaps + i, range);
+    return total;
+}
+
+static void printusage(char *command) {
+    printf(
+        " Try %s directory \n where directory could be "
+        "benchmarks/realdata/census1881\n",
+        command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    char *extension = ".txt";
+    while ((c = getopt(argc, argv, "e:h")) != -1) switch (c) {
+            case 'e':
+                extension = optarg;
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    if (optind >= argc) {
+        printusage(argv[0]);
+        return -1;
+    }
+    char *dirname = argv[optind];
+    size_t count;
+    size_t *howmany = NULL;
+    uint32_t **numbers =
+        read_all_integer_files(dirname, extension, &howmany, &count);
+    if (numbers == NULL) {
+        printf(
+            "I could not find or load any data file with extension %s in "
+            "directory %s.\n",
+            extension, dirname);
+        return -1;
+    }
+    if (count < OPERANDS) {
+        printf("Need at least %d files in %s.\n", OPERANDS, dirname);
+        return -1;
+    }
+    roaring_bitmap_t **bitmaps = malloc(sizeof(roaring_bitmap_t *) * count);
+    uint64_t range = 0;
+    for (size_t i = 0; i < count; i++) {
+        bitmaps[i] = roaring_bitmap_of_ptr(howmany[i], numbers[i]);
+        roaring_bitmap_run_optimize(bitmaps[i]);
+        for (size_t j = 0; j < howmany[i]; ++j)
+            if (numbers[i][j] >= range) range = numbers[i][j] + UINT64_C(1);
+    }
+    printf("Loaded %zu bitmaps from directory %s \n", count, dirname);
+    const size_t nqueries = count - OPERANDS + 1;
+
+    uint64_t best[2] = {UINT64_MAX, UINT64_MAX};
+    uint64_t answer[2] = {0, 0};
+    uint64_t cycles_start = 0, cycles_final = 0;
+    for (int r = 0; r < 10; ++r) {
+        for (int use_expression = 0; use_expression <= 1; ++use_expression) {
+            RDTSC_START(cycles_start);
+            answer[use_expression] =
+                all_queries(bitmaps, count, range, use_expression);
+            RDTSC_FINAL(cycles_final);
+            if (cycles_final - cycles_start < best[use_expression])
+                best[use_expression] = cycles_final - cycles_start;
+        }
+    }
+    if (answer[0] != answer[1]) {
+        printf("the expression changed the results\n");
+        return -1;
+    }
+    printf(" %zu queries, one operation per node: %.0f cycles/query\n",
+           nqueries, best[0] * 1.0 / nqueries);
+    printf(" %zu queries, expression:             %.0f cycles/query\n",
+           nqueries, best[1] * 1.0 / nqueries);
+
+    for (size_t i = 0; i < count; ++i) {
+        free(numbers[i]);
+        roaring_bitmap_free(bitmaps[i]);
+    }
+    free(bitmaps);
+    free(howmany);
+    free(numbers);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * index_build_benchmark.c
+ *
+ * Times roaring_bitmap_index_build on a low-cardinality column against
+ * building the same bitmaps with one roaring_bitmap_add per row, for rows in
+ * order and for rows in random order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "roaring.h"
+#include "random.h"
+
+enum { ROWS = 10000000, NUMBER_OF_VALUES = 16, REPEAT = 3 };
+
+static void free_index(roaring_bitmap_t **bitmaps) {
+    for (uint32_t v = 0; v < NUMBER_OF_VALUES; ++v)
+        roaring_bitmap_free(bitmaps[v]);
+    free(bitmaps);
+}
+
+static roaring_bitmap_t **add_one_by_one(const uint32_t *values,
+                                         const uint32_t *rows) {
+    roaring_bitmap_t **bitmaps =
+        malloc(NUMBER_OF_VALUES * sizeof(roaring_bitmap_t *));
+    for (uint32_t v = 0; v < NUMBER_OF_VALUES; ++v)
+        bitmaps[v] = roaring_bitmap_create();
+    for (uint32_t i = 0; i < ROWS; ++i)
+        roaring_bitmap_add(bitmaps[values[i]], rows == NULL ? i : rows[i]);
+    return bitmaps;
+}
+
+static void index_build_test(const uint32_t *values, const uint32_t *rows) {
+    uint64_t best_add = UINT64_MAX, best_equal = UINT64_MAX,
+             best_range = UINT64_MAX;
+    for (int r = 0; r < REPEAT; ++r) {
+        uint64_t cycles_start, cycles_final;
+        RDTSC_START(cycles_start);
+        roaring_bitmap_t **bitmaps = add_one_by_one(values, rows);
+        RDTSC_FINAL(cycles_final);
+        if (cycles_final - cycles_start < best_add)
+            best_add = cycles_final - cycles_start;
+        free_index(bitmaps);
+        RDTSC_START(cycles_start);
+        bitmaps = roaring_bitmap_index_build(values, rows, ROWS,
+                                             NUMBER_OF_VALUES, false);
+        RDTSC_FINAL(cycles_final);
+        if (cycles_final - cycles_start < best_equal)
+            best_equal = cycles_final - cycles_start;
+        free_index(bitmaps);
+        RDTSC_START(cycles_start);
+        bitmaps = roaring_bitmap_index_build(values, rows, ROWS,
+                                             NUMBER_OF_VALUES, true);
+        RDTSC_FINAL(cycles_final);
+        if (cycles_final - cycles_start < best_range)
+            best_range = cycles_final - cycles_start;
+        free_index(bitmaps);
+    }
+    printf("rows %-9s: roaring_bitmap_add %6.2f, index_build %6.2f, "
+           "range-encoded %6.2f cycles per row\n",
+           rows == NULL ? "in order" : "shuffled", best_add * 1.0 / ROWS,
+           best_equal * 1.0 / ROWS, best_range * 1.0 / ROWS);
+}
+
+int main() {
+    uint32_t *values = malloc(ROWS * sizeof(uint32_t));
+    uint32_t *rows = malloc(ROWS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < ROWS; ++i) {
+        values[i] = ranged_random(NUMBER_OF_VALUES);
+        rows[i] = i;
+    }
+    index_build_test(values, NULL);
+    shuffle_uint32(rows, ROWS);
+    index_build_test(values, rows);
+    free(values);
+    free(rows);
+    return 0;
+}
@@ -1,51 +1,375 @@
+/*
+ * real_bitmaps_benchmark.c
+ *
+ * Times the main operations on the bitmaps of one or more realdata
+ * directories, eg
+ *
+ *   real_bitmaps_benchmark -f csv benchmarks/realdata/census1881 ...
+ *
+ * Every operation is repeated (-r) and reported as the best and the median
+ * number of cycles per value, a value being one integer of the dataset
+ * (contains makes one query per value). Memory is reported in bits per
+ * value, before and after run optimization. The output is a table (the
+ * default), CSV (-f csv) or a JSON array (-f json), one record per dataset
+ * and operation.
+ */
 #define _GNU_SOURCE
 #include "benchmark.h"
 #include "numbersfromtextfiles.h"
 #include "roaring.h"
 
-/**
- * Once you have collected all the integers, build the bitmaps.
- */
-static roaring_bitmap_t **create_all_bitmaps(size_t *howmany,
-                                             uint32_t **numbers, size_t count, bool copy_on_write) {
-    if (numbers == NULL) return NULL;
-    printf("Constructing %d  bitmaps.\n", (int)count);
-    roaring_bitmap_t **answer = malloc(sizeof(roaring_bitmap_t *) * count);
-    for (size_t i = 0; i < count; i++) {
-        printf(".");
-        fflush(stdout);
-        answer[i] = roaring_bitmap_of_ptr(howmany[i], numbers[i]);
-        answer[i]->copy_on_write = copy_on_write;
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON } output_format_t;
+
+typedef struct dataset_s {
+    const char *name;
+    size_t count;
+    size_t *howmany;
+    uint32_t **numbers;
+    uint32_t *maximums;
+    uint64_t total;  // number of values, in all bitmaps
+    roaring_bitmap_t **bitmaps;
+    roaring_bitmap_t **scratch;  // results, or copies for in-place operations
+    void **buffers;              // serialized bitmaps, arrays
+    uint64_t and_cardinality;    // of the results of "and" and "or"
+    uint64_t or_cardinality;
+} dataset_t;
+
+typedef struct benchmark_case_s {
+    const char *name;
+    void (*prepare)(dataset_t *d);  // not timed, may be NULL
+    uint64_t (*run)(dataset_t *d);  // timed, returns a checksum
+    void (*cleanup)(dataset_t *d);  // not timed, may be NULL
+} benchmark_case_t;
+
+static output_format_t format = FORMAT_TEXT;
+static int repeat = 5;
+static int records = 0;
+
+static void print_record(const dataset_t *d, const char *operation,
+                         const char *unit, double best, double median) {
+    switch (format) {
+        case FORMAT_CSV:
+            if (records == 0)
+                printf("dataset,operation,unit,values,best,median\n");
+            printf("%s,%s,%s,%" PRIu64 ",%.3f,%.3f\n", d->name, operation,
+                   unit, d->total, best, median);
+            break;
+        case FORMAT_JSON:
+            printf("%s\n  {\"dataset\": \"%s\", \"operation\": \"%s\", "
+                   "\"unit\": \"%s\", \"values\": %" PRIu64
+                   ", \"best\": %.3f, \"median\": %.3f}",
+                   records == 0 ? "[" : ",", d->name, operation, unit,
+                   d->total, best, median);
+            break;
+        default:
+            printf("%-28s %-26s %10.3f %10.3f %s\n", d->name, operation, best,
+                   median, unit);
+    }
+    records++;
+}
+
+static int compare_uint64(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Runs the case repeat times and prints the best and median cycles per
+ * value. Returns false if the checksum changes from one run to the next. */
+static bool run_case(dataset_t *d, const benchmark_case_t *b,
+                     uint64_t *checksum) {
+    uint64_t *samples = malloc(repeat * sizeof(uint64_t));
+    bool consistent = true;
+    for (int r = 0; r < repeat; ++r) {
+        if (b->prepare != NULL) b->prepare(d);
+        uint64_t cycles_start, cycles_final;
+        RDTSC_START(cycles_start);
+        const uint64_t sum = b->run(d);
+        RDTSC_FINAL(cycles_final);
+        samples[r] = cycles_final - cycles_start;
+        if (b->cleanup != NULL) b->cleanup(d);
+        if (r > 0 && sum != *checksum) consistent = false;
+        *checksum = sum;
+    }
+    qsort(samples, repeat, sizeof(uint64_t), compare_uint64);
+    print_record(d, b->name, "cycles per value", samples[0] * 1.0 / d->total,
+                 samples[repeat / 2] * 1.0 / d->total);
+    free(samples);
+    return consistent;
+}
+
+static void free_scratch(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i) {
+        if (d->scratch[i] != NULL) roaring_bitmap_free(d->scratch[i]);
+        d->scratch[i] = NULL;
+    }
+}
+
+static void free_buffers(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i) {
+        free(d->buffers[i]);
+        d->buffers[i] = NULL;
+    }
+}
+
+static void free_all(dataset_t *d) {
+    free_scratch(d);
+    free_buffers(d);
+}
+
+static void copy_all(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i)
+        d->scratch[i] = roaring_bitmap_copy(d->bitmaps[i]);
+}
+
+static void serialize_all(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i) {
+        d->buffers[i] =
+            malloc(roaring_bitmap_portable_size_in_bytes(d->bitmaps[i]));
+        roaring_bitmap_portable_serialize(d->bitmaps[i], d->buffers[i]);
+    }
+}
+
+static void allocate_buffers(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i)
+        d->buffers[i] =
+            malloc(roaring_bitmap_portable_size_in_bytes(d->bitmaps[i]));
+}
+
+static uint64_t scratch_cardinality(const dataset_t *d) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < d->count; ++i)
+        if (d->scratch[i] != NULL)
+            sum += roaring_bitmap_get_cardinality(d->scratch[i]);
+    return sum;
+}
+
+static void and_cleanup(dataset_t *d) {
+    d->and_cardinality = scratch_cardinality(d);
+    free_scratch(d);
+}
+
+static void or_cleanup(dataset_t *d) {
+    d->or_cardinality = scratch_cardinality(d);
+    free_scratch(d);
+}
+
+static uint64_t run_create(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i)
+        d->scratch[i] = roaring_bitmap_of_ptr(d->howmany[i], d->numbers[i]);
+    return d->scratch[0]->high_low_container->size;
+}
+
+static uint64_t run_copy(dataset_t *d) {
+    copy_all(d);
+    return d->scratch[0]->high_low_container->size;
+}
+
+static uint64_t run_contains(dataset_t *d) {
+    uint64_t hits = 0;
+    for (size_t i = 0; i < d->count; ++i) {
+        // the values of the next bitmap: hits and misses
+        const size_t j = (i + 1) % d->count;
+        for (size_t k = 0; k < d->howmany[j]; ++k)
+            hits += roaring_bitmap_contains(d->bitmaps[i], d->numbers[j][k]);
+    }
+    return hits;
+}
+
+static void sum_iterator(uint32_t value, void *param) {
+    *(uint64_t *)param += value;
+}
+
+static uint64_t run_iterate(dataset_t *d) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < d->count; ++i)
+        roaring_iterate(d->bitmaps[i], sum_iterator, &sum);
+    return sum;
+}
+
+static uint64_t run_to_uint32_array(dataset_t *d) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < d->count; ++i) {
+        uint32_t card;
+        d->buffers[i] = roaring_bitmap_to_uint32_array(d->bitmaps[i], &card);
+        sum += card;
+    }
+    return sum;
+}
+
+static uint64_t run_flip(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i)
+        d->scratch[i] =
+            roaring_bitmap_flip(d->bitmaps[i], 0, (uint64_t)d->maximums[i] + 1);
+    return d->scratch[0]->high_low_container->size;
+}
+
+static uint64_t run_and(dataset_t *d) {
+    for (size_t i = 0; i + 1 < d->count; ++i)
+        d->scratch[i] = roaring_bitmap_and(d->bitmaps[i], d->bitmaps[i + 1]);
+    return 0;
+}
+
+static uint64_t run_or(dataset_t *d) {
+    for (size_t i = 0; i + 1 < d->count; ++i)
+        d->scratch[i] = roaring_bitmap_or(d->bitmaps[i], d->bitmaps[i + 1]);
+    return 0;
+}
+
+static uint64_t run_and_inplace(dataset_t *d) {
+    for (size_t i = 0; i + 1 < d->count; ++i)
+        roaring_bitmap_and_inplace(d->scratch[i], d->bitmaps[i + 1]);
+    return 0;
+}
+
+static uint64_t run_or_inplace(dataset_t *d) {
+    for (size_t i = 0; i + 1 < d->count; ++i)
+        roaring_bitmap_or_inplace(d->scratch[i], d->bitmaps[i + 1]);
+    return 0;
+}
+
+static uint64_t run_lazy_or(dataset_t *d) {
+    roaring_bitmap_t *u = roaring_bitmap_lazy_or(d->bitmaps[0], d->bitmaps[1]);
+    for (size_t i = 2; i < d->count; ++i)
+        roaring_bitmap_lazy_or_inplace(u, d->bitmaps[i]);
+    roaring_bitmap_repair_after_lazy(u);
+    d->scratch[0] = u;
+    return roaring_bitmap_get_cardinality(u);
+}
+
+static uint64_t run_or_many(dataset_t *d) {
+    d->scratch[0] =
+        roaring_bitmap_or_many(d->count, (const roaring_bitmap_t **)d->bitmaps);
+    return roaring_bitmap_get_cardinality(d->scratch[0]);
+}
+
+static uint64_t run_or_many_heap(dataset_t *d) {
+    d->scratch[0] = roaring_bitmap_or_many_heap(
+        d->count, (const roaring_bitmap_t **)d->bitmaps);
+    return roaring_bitmap_get_cardinality(d->scratch[0]);
+}
+
+static uint64_t run_run_optimize(dataset_t *d) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < d->count; ++i)
+        changed += roaring_bitmap_run_optimize(d->scratch[i]);
+    return changed;
+}
+
+static uint64_t run_serialize(dataset_t *d) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < d->count; ++i)
+        bytes += roaring_bitmap_portable_serialize(d->bitmaps[i], d->buffers[i]);
+    return bytes;
+}
+
+static uint64_t run_deserialize(dataset_t *d) {
+    for (size_t i = 0; i < d->count; ++i)
+        d->scratch[i] = roaring_bitmap_portable_deserialize(d->buffers[i]);
+    return d->scratch[0]->high_low_container->size;
+}
+
+static void pool_on(dataset_t *d) {
+    (void)d;
+    roaring_pool_set_enabled(true);
+}
+
+static void pool_off_cleanup(dataset_t *d) {
+    free_scratch(d);
+    roaring_pool_set_enabled(false);
+}
+
+static const benchmark_case_t cases[] = {
+    {"create", NULL, run_create, free_scratch},
+    {"copy", NULL, run_copy, free_scratch},
+    {"contains", NULL, run_contains, NULL},
+    {"iterate", NULL, run_iterate, NULL},
+    {"to_uint32_array", NULL, run_to_uint32_array, free_buffers},
+    {"flip", NULL, run_flip, free_scratch},
+    {"and", NULL, run_and, and_cleanup},
+    {"or", NULL, run_or, or_cleanup},
+    {"and_inplace", copy_all, run_and_inplace, free_scratch},
+    {"or_inplace", copy_all, run_or_inplace, free_scratch},
+    {"lazy_or", NULL, run_lazy_or, free_scratch},
+    {"or_many", NULL, run_or_many, free_scratch},
+    {"or_many_heap", NULL, run_or_many_heap, free_scratch},
+    {"or_many (pool)", pool_on, run_or_many, pool_off_cleanup},
+    {"or_many_heap (pool)", pool_on, run_or_many_heap, pool_off_cleanup},
+    {"run_optimize", copy_all, run_run_optimize, free_scratch},
+    {"portable_serialize", allocate_buffers, run_serialize, free_buffers},
+    {"portable_deserialize", serialize_all, run_deserialize, free_all},
+};
+
+static uint64_t bytes_in_memory(const dataset_t *d, roaring_bitmap_t **r) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < d->count; ++i) {
+        roaring_statistics_t stats;
+        roaring_bitmap_statistics(r[i], &stats);
+        bytes += stats.n_bytes;
+    }
+    return bytes;
+}
+
+static bool benchmark_dataset(dataset_t *d) {
+    const size_t ncases = sizeof(cases) / sizeof(cases[0]);
+    uint64_t unions[sizeof(cases) / sizeof(cases[0])];
+    size_t nunions = 0;
+    bool ok = true;
+    for (size_t c = 0; c < ncases; ++c) {
+        uint64_t checksum = 0;
+        ok = run_case(d, &cases[c], &checksum) && ok;
+        if (strncmp(cases[c].name, "lazy_or", 7) == 0 ||
+            strncmp(cases[c].name, "or_many", 7) == 0)
+            unions[nunions++] = checksum;
+    }
+    // |A| + |B| = |A and B| + |A or B|, and all the unions agree
+    uint64_t pairs = 0;
+    for (size_t i = 0; i + 1 < d->count; ++i)
+        pairs += d->howmany[i] + d->howmany[i + 1];
+    if (d->and_cardinality + d->or_cardinality != pairs) {
+        fprintf(stderr, "%s: and/or cardinalities are wrong\n", d->name);
+        ok = false;
     }
-    printf("\n");
-    return answer;
+    for (size_t u = 1; u < nunions; ++u)
+        if (unions[u] != unions[0]) {
+            fprintf(stderr, "%s: the unions disagree\n", d->name);
+            ok = false;
+        }
+    copy_all(d);
+    const double before = bytes_in_memory(d, d->scratch) * 8.0 / d->total;
+    for (size_t i = 0; i < d->count; ++i)
+        roaring_bitmap_run_optimize(d->scratch[i]);
+    const double after = bytes_in_memory(d, d->scratch) * 8.0 / d->total;
+    free_scratch(d);
+    print_record(d, "memory", "bits per value", before, before);
+    print_record(d, "memory (run_optimize)", "bits per value", after, after);
+    return ok;
 }
 
 static void printusage(char *command) {
     printf(
-        " Try %s directory \n where directory could be "
-        "benchmarks/realdata/census1881\n",
+        " Try %s [-f text|csv|json] [-r repeat] [-e extension] directory... \n"
+        " where directory could be benchmarks/realdata/census1881\n",
         command);
     ;
 }
 
-#define KNRM "\x1B[0m"
-#define KRED "\x1B[31m"
-#define KGRN "\x1B[32m"
-#define KYEL "\x1B[33m"
-#define KBLU "\x1B[34m"
-#define KMAG "\x1B[35m"
-#define KCYN "\x1B[36m"
-#define KWHT "\x1B[37m"
-
 int main(int argc, char **argv) {
     int c;
     char *extension = ".txt";
-    bool copy_on_write = false;
-    while ((c = getopt(argc, argv, "e:h")) != -1) switch (c) {
+    while ((c = getopt(argc, argv, "e:f:r:h")) != -1) switch (c) {
             case 'e':
                 extension = optarg;
                 break;
+            case 'f':
+                format = strcmp(optarg, "csv") == 0
+                             ? FORMAT_CSV
+                             : strcmp(optarg, "json") == 0 ? FORMAT_JSON
+                                                           : FORMAT_TEXT;
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                if (repeat < 1) repeat = 1;
+                break;
             case 'h':
                 printusage(argv[0]);
                 return 0;
@@ -56,110 +380,58 @@ int main(int argc, char **argv) {
         printusage(argv[0]);
         return -1;
     }
-    char *dirname = argv[optind];
-    size_t count;
-
-    size_t *howmany = NULL;
-    uint32_t **numbers =
-        read_all_integer_files(dirname, extension, &howmany, &count);
-    if (numbers == NULL) {
-        printf(
-            "I could not find or load any data file with extension %s in "
-            "directory %s.\n",
-            extension, dirname);
-        return -1;
-    }
-
-    uint64_t cycles_start = 0, cycles_final = 0;
-
-    RDTSC_START(cycles_start);
-    roaring_bitmap_t **bitmaps = create_all_bitmaps(howmany, numbers, count, copy_on_write);
-    RDTSC_FINAL(cycles_final);
-    if (bitmaps == NULL) return -1;
-    printf("Loaded %d bitmaps from directory %s \n", (int)count, dirname);
-
-    printf("Creating %zu bitmaps took %" PRIu64 " cycles\n", count,
-           cycles_final - cycles_start);
-
-    RDTSC_START(cycles_start);
-    for (int i = 0; i < (int)count; i += 2) {
-        roaring_bitmap_t *CI = roaring_bitmap_copy(
-            bitmaps[i]);  // to test the inplace version we create a copy
-        roaring_bitmap_free(CI);
-    }
-    RDTSC_FINAL(cycles_final);
-    printf("Copying and freeing %zu bitmaps took %" PRIu64 " cycles\n", count,
-           cycles_final - cycles_start);
-
-    uint64_t successive_and = 0;
-    uint64_t successive_or = 0;
-    // try ANDing and ORing together consecutive pairs
-    for (int i = 0; i < (int)count - 1; ++i) {
-        uint32_t c1 = roaring_bitmap_get_cardinality(bitmaps[i]);
-        uint32_t c2 = roaring_bitmap_get_cardinality(bitmaps[i + 1]);
-        RDTSC_START(cycles_start);
-        roaring_bitmap_t *tempand =
-            roaring_bitmap_and(bitmaps[i], bitmaps[i + 1]);
-        RDTSC_FINAL(cycles_final);
-        successive_and += cycles_final - cycles_start;
-
-        uint32_t ci = roaring_bitmap_get_cardinality(tempand);
-        roaring_bitmap_free(tempand);
-        RDTSC_START(cycles_start);
-        roaring_bitmap_t *tempor =
-            roaring_bitmap_or(bitmaps[i], bitmaps[i + 1]);
-        RDTSC_FINAL(cycles_final);
-        successive_or += cycles_final - cycles_start;
-
-        uint32_t co = roaring_bitmap_get_cardinality(tempor);
-        roaring_bitmap_free(tempor);
-
-        if (c1 + c2 != co + ci) {
-            printf(KRED "cardinalities are wrong somehow\n");
-            printf("c1 = %d, c2 = %d, co = %d, ci = %d\n", c1, c2, co, ci);
-            return -1;
+    if (format == FORMAT_TEXT)
+        printf("%-28s %-26s %10s %10s (of %d)\n", "dataset", "operation",
+               "best", "median", repeat);
+    bool ok = true;
+    for (; optind < argc; ++optind) {
+        dataset_t d;
+        memset(&d, 0, sizeof(d));
+        d.name = argv[optind];
+        d.numbers =
+            read_all_integer_files(d.name, extension, &d.howmany, &d.count);
+        if (d.numbers == NULL || d.count < 2) {
+            // skip it, so that benchmarks/realdata/* can be given
+            fprintf(stderr,
+                    "I could not find or load two data files with extension "
+                    "%s in directory %s.\n",
+                    extension, d.name);
+            for (size_t i = 0; d.numbers != NULL && i < d.count; ++i)
+                free(d.numbers[i]);
+            free(d.numbers);
+            free(d.howmany);
+            continue;
         }
+        // report the last component of the directory
+        char name[256];
+        snprintf(name, sizeof(name), "%s", argv[optind]);
+        for (size_t len = strlen(name); len > 1 && name[len - 1] == '/';)
+            name[--len] = '\0';
+        d.name = strrchr(name, '/') == NULL ? name : strrchr(name, '/') + 1;
+        d.maximums = calloc(d.count, sizeof(uint32_t));
+        d.bitmaps = malloc(d.count * sizeof(roaring_bitmap_t *));
+        d.scratch = calloc(d.count, sizeof(roaring_bitmap_t *));
+        d.buffers = calloc(d.count, sizeof(void *));
+        for (size_t i = 0; i < d.count; ++i) {
+            d.bitmaps[i] = roaring_bitmap_of_ptr(d.howmany[i], d.numbers[i]);
+            d.total += d.howmany[i];
+            for (size_t k = 0; k < d.howmany[i]; ++k)
+                if (d.numbers[i][k] > d.maximums[i])
+                    d.maximums[i] = d.numbers[i][k];
+        }
+        ok = benchmark_dataset(&d) && ok;
+        for (size_t i = 0; i < d.count; ++i) {
+            free(d.numbers[i]);
+            roaring_bitmap_free(d.bitmaps[i]);
+        }
+        free(d.buffers);
+        free(d.scratch);
+        free(d.bitmaps);
+        free(d.maximums);
+        free(d.howmany);
+        free(d.numbers);
     }
-    printf(" %zu successive bitmaps intersections took %" PRIu64 " cycles\n",
-           count - 1, successive_and);
-    printf(" %zu successive bitmaps unions took %" PRIu64 " cycles\n",
-           count - 1, successive_or);
-
-    roaring_bitmap_t **copyofr = malloc(sizeof(roaring_bitmap_t *) * count);
-    for (int i = 0; i < (int)count; i++) {
-        copyofr[i] = roaring_bitmap_copy(bitmaps[i]);
-    }
-    RDTSC_START(cycles_start);
-    for (int i = 0; i < (int)count - 1; i++) {
-        roaring_bitmap_and_inplace(copyofr[i], bitmaps[i + 1]);
-    }
-    RDTSC_FINAL(cycles_final);
-    printf(" %zu successive in-place bitmaps intersections took %" PRIu64
-           " cycles\n",
-           count - 1, cycles_final - cycles_start);
-
-    free(copyofr);
-    copyofr = malloc(sizeof(roaring_bitmap_t *) * count);
-    for (int i = 0; i < (int)count; i++) {
-        copyofr[i] = roaring_bitmap_copy(bitmaps[i]);
-    }
-    RDTSC_START(cycles_start);
-    for (int i = 0; i < (int)count - 1; i++) {
-        roaring_bitmap_or_inplace(copyofr[i], bitmaps[i + 1]);
-    }
-    RDTSC_FINAL(cycles_final);
-    printf(" %zu successive in-place bitmaps unions took %" PRIu64 " cycles\n",
-           count - 1, cycles_final - cycles_start);
-
-    for (int i = 0; i < (int)count; ++i) {
-        free(numbers[i]);
-        numbers[i] = NULL;  // paranoid
-        roaring_bitmap_free(bitmaps[i]);
-        bitmaps[i] = NULL;  // paranoid
-    }
-    free(bitmaps);
-    free(howmany);
-    free(numbers);
-
-    return 0;
+    if (format == FORMAT_JSON) printf("%s]\n", records == 0 ? "[" : "\n");
+    if (!ok) fprintf(stderr, "some checks failed\n");
+    return ok ? 0 : -1;
 }
@@ -0,0 +1,107 @@
+/*
+ * roaring_array_benchmark.c
+ *
+ * Exercises the key directory of roaring_array_t (the keys / containers /
+ * typecodes arrays) rather than the containers themselves: lookups in bitmaps
+ * having many containers, creation/copy/free of many small bitmaps and random
+ * key insertions.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "misc/configreport.h"
+#include "random.h"
+#include "roaring.h"
+
+enum { NUMBER_OF_LOOKUPS = 1 << 16, NUMBER_OF_SMALL_BITMAPS = 1024 };
+
+/* one value in each of the first "howmany" chunks */
+static roaring_bitmap_t *make_wide_bitmap(uint32_t howmany) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t k = 0; k < howmany; ++k) {
+        roaring_bitmap_add(r, (k << 16) | (k & 0xFFFF));
+    }
+    return r;
+}
+
+static int contains_test(const roaring_bitmap_t *r, const uint32_t *values,
+                         size_t n) {
+    int card = 0;
+    for (size_t i = 0; i < n; ++i) {
+        card += roaring_bitmap_contains(r, values[i]);
+    }
+    return card;
+}
+
+static int copy_free_test(roaring_bitmap_t **bitmaps, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        roaring_bitmap_t *c = roaring_bitmap_copy(bitmaps[i]);
+        roaring_bitmap_free(c);
+    }
+    return 0;
+}
+
+static int create_free_test(const uint32_t *values, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        roaring_bitmap_t *r = roaring_bitmap_of_ptr(4, values + 4 * i);
+        roaring_bitmap_free(r);
+    }
+    return 0;
+}
+
+/* adds one value per chunk, visiting the chunks in random order */
+static uint32_t random_insert_test(const uint32_t *values, size_t n) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (size_t i = 0; i < n; ++i) roaring_bitmap_add(r, values[i]);
+    uint32_t card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_free(r);
+    return card;
+}
+
+int main() {
+    int repeat = 50;
+    tellmeall();
+    printf("roaring array (key directory) benchmarks\n");
+
+    uint32_t *lookups = malloc(NUMBER_OF_LOOKUPS * sizeof(uint32_t));
+    for (uint32_t howmany = 16; howmany <= (1 << 16); howmany *= 16) {
+        roaring_bitmap_t *r = make_wide_bitmap(howmany);
+        for (size_t i = 0; i < NUMBER_OF_LOOKUPS; ++i) {
+            uint32_t k = ranged_random(howmany);
+            lookups[i] = (k << 16) | (k & 0xFFFF);
+        }
+        printf("\n number of containers = %u\n", howmany);
+        BEST_TIME(contains_test(r, lookups, NUMBER_OF_LOOKUPS),
+                  NUMBER_OF_LOOKUPS, repeat, NUMBER_OF_LOOKUPS);
+        roaring_bitmap_free(r);
+
+        uint32_t *keys = malloc(howmany * sizeof(uint32_t));
+        for (uint32_t k = 0; k < howmany; ++k) keys[k] = k << 16;
+        shuffle_uint32(keys, howmany);
+        BEST_TIME(random_insert_test(keys, howmany), howmany, repeat,
+                  howmany);
+        free(keys);
+    }
+    free(lookups);
+    printf("\n");
+
+    roaring_bitmap_t **smalls =
+        malloc(NUMBER_OF_SMALL_BITMAPS * sizeof(roaring_bitmap_t *));
+    uint32_t *smallvalues = malloc(4 * NUMBER_OF_SMALL_BITMAPS * sizeof(uint32_t));
+    for (size_t i = 0; i < NUMBER_OF_SMALL_BITMAPS; ++i) {
+        for (size_t j = 0; j < 4; ++j)
+            smallvalues[4 * i + j] = (uint32_t)(j << 16) + pcg32_random() % 1000;
+        smalls[i] = roaring_bitmap_of_ptr(4, smallvalues + 4 * i);
+    }
+    BEST_TIME(create_free_test(smallvalues, NUMBER_OF_SMALL_BITMAPS), 0,
+              repeat, NUMBER_OF_SMALL_BITMAPS);
+    BEST_TIME(copy_free_test(smalls, NUMBER_OF_SMALL_BITMAPS), 0, repeat,
+              NUMBER_OF_SMALL_BITMAPS);
+    for (size_t i = 0; i < NUMBER_OF_SMALL_BITMAPS; ++i)
+        roaring_bitmap_free(smalls[i]);
+    free(smalls);
+    free(smallvalues);
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 
 #include "benchmark.h"
+#include "containers/mixed_intersection.h"
+#include "containers/mixed_union.h"
 #include "containers/run.h"
 #include "misc/configreport.h"
 #include "random.h"
@@ -67,6 +69,87 @@ int intersection_test(run_container_t* B1, run_container_t* B2,
     return run_container_cardinality(BO);
 }
 
+/* runs of length 8 starting every "stride" values */
+static run_container_t* strided_runs(int stride, int offset) {
+    run_container_t* R = run_container_create();
+    for (int x = offset; x + 8 <= (1 << 16); x += stride)
+        for (int y = 0; y < 8; ++y) run_container_add(R, (uint16_t)(x + y));
+    return R;
+}
+
+int union_runs_test(run_container_t* B1, run_container_t* B2,
+                    run_container_t* BO) {
+    run_container_union(B1, B2, BO);
+    return BO->n_runs;
+}
+
+int intersection_runs_test(run_container_t* B1, run_container_t* B2,
+                           run_container_t* BO) {
+    run_container_intersection(B1, B2, BO);
+    return BO->n_runs;
+}
+
+int array_run_union_test(array_container_t* A, run_container_t* B,
+                         run_container_t* BO) {
+    BO->n_runs = 0;
+    array_run_container_union(A, B, BO);
+    return BO->n_runs;
+}
+
+int array_run_intersection_test(array_container_t* A, run_container_t* B,
+                                array_container_t* AO) {
+    array_run_container_intersection(A, B, AO);
+    return AO->cardinality;
+}
+
+/* one input has 4096 runs, the other "ratio" times fewer runs (or values) */
+static void skewed_tests(int repeat) {
+    printf("\nSkewed inputs (times in cycles per input run or value)\n");
+    run_container_t* large = strided_runs(16, 0);
+    run_container_t* BO = run_container_create();
+    array_container_t* AO = array_container_create();
+    for (int ratio = 1; ratio <= 1024; ratio *= 4) {
+        run_container_t* small = strided_runs(16 * ratio, 4);
+        array_container_t* A = array_container_create();
+        for (int x = 5; x < (1 << 16); x += 16 * ratio)
+            array_container_add(A, (uint16_t)x);
+        printf("== large: %d runs, small: %d runs / %d values (ratio %d)\n",
+               large->n_runs, small->n_runs, A->cardinality, ratio);
+        const int32_t inputsize = large->n_runs + small->n_runs;
+        int answer = union_runs_test(large, small, BO);
+        BEST_TIME(union_runs_test(large, small, BO), answer, repeat, inputsize);
+        answer = intersection_runs_test(large, small, BO);
+        BEST_TIME(intersection_runs_test(large, small, BO), answer, repeat,
+                  inputsize);
+        const int32_t mixedsize = large->n_runs + A->cardinality;
+        answer = array_run_union_test(A, large, BO);
+        BEST_TIME(array_run_union_test(A, large, BO), answer, repeat,
+                  mixedsize);
+        answer = array_run_intersection_test(A, large, AO);
+        BEST_TIME(array_run_intersection_test(A, large, AO), answer, repeat,
+                  mixedsize);
+        run_container_free(small);
+        array_container_free(A);
+    }
+    // many values against few runs
+    array_container_t* dense = array_container_create();
+    for (int x = 0; x < (1 << 16); x += 3) array_container_add(dense, (uint16_t)x);
+    for (int stride = 64; stride <= (1 << 14); stride *= 16) {
+        run_container_t* few = strided_runs(stride, 0);
+        printf("== array: %d values, runs: %d\n", dense->cardinality,
+               few->n_runs);
+        const int32_t mixedsize = dense->cardinality + few->n_runs;
+        int answer = array_run_intersection_test(dense, few, AO);
+        BEST_TIME(array_run_intersection_test(dense, few, AO), answer, repeat,
+                  mixedsize);
+        run_container_free(few);
+    }
+    array_container_free(dense);
+    array_container_free(AO);
+    run_container_free(BO);
+    run_container_free(large);
+}
+
 int main() {
     int repeat = 500;
     int size = TESTSIZE;
@@ -162,5 +245,7 @@ int main() {
     run_container_free(B1);
     run_container_free(B2);
     run_container_free(BO);
+
+    skewed_tests(repeat);
     return 0;
 }
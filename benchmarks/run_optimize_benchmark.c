@@ -0,0 +1,81 @@
+/*
+ * run_optimize_benchmark.c
+ *
+ * Times roaring_bitmap_run_optimize_parallel and
+ * roaring_bitmap_remove_run_compression_parallel over a bitmap with many
+ * containers, for 1 to 8 threads, on private copies and on copy-on-write
+ * copies (whose containers are all shared).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "roaring.h"
+#include "random.h"
+
+enum { NUM_KEYS = 1 << 16, REPEAT = 5 };
+
+/* a third of the containers are runs in disguise, the others are sparse
+ * arrays or bitsets that stay as they are */
+static roaring_bitmap_t *make_bitmap(void) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t key = 0; key < NUM_KEYS; ++key) {
+        const uint32_t base = key << 16;
+        switch (key % 3) {
+            case 0:
+                for (uint32_t x = 0; x < 3000; ++x)
+                    roaring_bitmap_add(r, base + 1000 + x);
+                break;
+            case 1:
+                for (int i = 0; i < 40; ++i)
+                    roaring_bitmap_add(r, base + ranged_random(1 << 16));
+                break;
+            default:
+                if (key % 64 == 2)  // a few bitsets
+                    for (uint32_t x = 0; x < (1 << 16); x += 3)
+                        roaring_bitmap_add(r, base + x);
+                else
+                    roaring_bitmap_add(r, base + key % 1000);
+        }
+    }
+    return r;
+}
+
+static void run_optimize_test(const roaring_bitmap_t *source,
+                              bool copy_on_write, int threads) {
+    roaring_bitmap_t original = *source;
+    original.copy_on_write = copy_on_write;
+    uint64_t best_optimize = UINT64_MAX, best_remove = UINT64_MAX;
+    roaring_conversion_stats_t optimized = {0, 0}, removed = {0, 0};
+    for (int i = 0; i < REPEAT; ++i) {
+        roaring_bitmap_t *r = roaring_bitmap_copy(&original);
+        uint64_t cycles_start, cycles_final;
+        RDTSC_START(cycles_start);
+        roaring_bitmap_run_optimize_parallel(r, threads, &optimized);
+        RDTSC_FINAL(cycles_final);
+        if (cycles_final - cycles_start < best_optimize)
+            best_optimize = cycles_final - cycles_start;
+        RDTSC_START(cycles_start);
+        roaring_bitmap_remove_run_compression_parallel(r, threads, &removed);
+        RDTSC_FINAL(cycles_final);
+        if (cycles_final - cycles_start < best_remove)
+            best_remove = cycles_final - cycles_start;
+        roaring_bitmap_free(r);
+    }
+    printf("%-9s %d threads: run_optimize %8.1f cycles per container "
+           "(%u converted, %lld bytes saved), remove_run_compression %8.1f "
+           "cycles per container (%u converted)\n",
+           copy_on_write ? "shared" : "private", threads,
+           best_optimize * 1.0 / NUM_KEYS, optimized.n_containers_converted,
+           (long long)optimized.n_bytes_saved, best_remove * 1.0 / NUM_KEYS,
+           removed.n_containers_converted);
+}
+
+int main() {
+    roaring_bitmap_t *r = make_bitmap();
+    for (int copy_on_write = 0; copy_on_write <= 1; ++copy_on_write)
+        for (int threads = 1; threads <= 8; threads *= 2)
+            run_optimize_test(r, copy_on_write, threads);
+    roaring_bitmap_free(r);
+    return 0;
+}
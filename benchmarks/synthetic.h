@@ -0,0 +1,149 @@
+/*
+ * synthetic.h
+ *
+ * Bitmaps with a chosen density in every 2^16 chunk, for benchmarks that
+ * need to cross the thresholds of perfparameters.h (DEFAULT_MAX_SIZE values
+ * per array container, run containers being smaller). Include roaring.h
+ * first.
+ */
+
+#ifndef BENCHMARKS_SYNTHETIC_H_
+#define BENCHMARKS_SYNTHETIC_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "random.h"
+
+typedef enum {
+    SYNTHETIC_UNIFORM,    // density * 2^16 values anywhere
+    SYNTHETIC_ZIPF,       // value v with probability ~ 1 / (v + 1)
+    SYNTHETIC_CLUSTERED,  // runs of exactly run_length values
+    SYNTHETIC_MARKOV,     // runs of run_length values on average
+    SYNTHETIC_NUM_KINDS
+} synthetic_kind_t;
+
+static const char *synthetic_kind_names[SYNTHETIC_NUM_KINDS] = {
+    "uniform", "zipf", "clustered", "markov"};
+
+enum { SYNTHETIC_WORDS = (1 << 16) / 64 };
+
+static inline double synthetic_random01(void) {
+    return pcg32_random() / 4294967296.0;
+}
+
+static inline void synthetic_set(uint64_t *words, uint32_t v) {
+    words[v >> 6] |= UINT64_C(1) << (v & 63);
+}
+
+static inline bool synthetic_get(const uint64_t *words, uint32_t v) {
+    return (words[v >> 6] >> (v & 63)) & 1;
+}
+
+/* exactly target values, all positions equally likely */
+static inline void synthetic_uniform_chunk(uint64_t *words, uint32_t target) {
+    const bool dense = target > (1 << 15);  // pick the values to leave out
+    for (uint32_t picked = dense ? (1 << 16) - target : target; picked > 0;) {
+        const uint32_t v = ranged_random(1 << 16);
+        if (synthetic_get(words, v)) continue;
+        synthetic_set(words, v);
+        picked--;
+    }
+    if (dense)
+        for (int i = 0; i < SYNTHETIC_WORDS; ++i) words[i] = ~words[i];
+}
+
+/* c such that about target values are expected when value v is picked with
+ * probability min(1, c / (v + 1)) */
+static inline double synthetic_zipf_constant(uint32_t target) {
+    double low = 0, high = 1 << 16;
+    for (int iteration = 0; iteration < 40; ++iteration) {
+        const double c = (low + high) / 2;
+        double expected = 0;
+        for (uint32_t v = 0; v < (1 << 16); ++v)
+            expected += c < v + 1 ? c / (v + 1) : 1;
+        if (expected < target)
+            low = c;
+        else
+            high = c;
+    }
+    return high;
+}
+
+/* a dense head and a sparse tail */
+static inline void synthetic_zipf_chunk(uint64_t *words, double c) {
+    for (uint32_t v = 0; v < (1 << 16); ++v)
+        if (synthetic_random01() < c / (v + 1)) synthetic_set(words, v);
+}
+
+/* target / run_length runs (rounded up) of run_length values, one at a
+ * random offset in each of as many equal slots */
+static inline void synthetic_clustered_chunk(uint64_t *words, uint32_t target,
+                                             uint32_t run_length) {
+    const uint32_t runs = (target + run_length - 1) / run_length;
+    if (runs == 0) return;
+    const uint32_t slot = (1 << 16) / runs;
+    for (uint32_t r = 0; r < runs; ++r) {
+        const uint32_t length = run_length < slot ? run_length : slot;
+        const uint32_t start = r * slot + ranged_random(slot - length + 1);
+        for (uint32_t v = start; v < start + length; ++v)
+            synthetic_set(words, v);
+    }
+}
+
+/* a two-state chain that leaves a run with probability 1 / run_length and
+ * starts one at the rate that gives the density */
+static inline void synthetic_markov_chunk(uint64_t *words, double density,
+                                          uint32_t run_length) {
+    if (density >= 1) {
+        memset(words, 0xFF, SYNTHETIC_WORDS * sizeof(uint64_t));
+        return;
+    }
+    const double leave = 1.0 / run_length;
+    const double enter = leave * density / (1 - density);
+    bool in = synthetic_random01() < density;
+    for (uint32_t v = 0; v < (1 << 16); ++v) {
+        if (in) synthetic_set(words, v);
+        in = synthetic_random01() < (in ? 1 - leave : enter);
+    }
+}
+
+/* A bitmap of chunks containers whose chunks have the given density (0 to
+ * 1); run_length only matters to the clustered and Markov kinds. The
+ * containers are arrays and bitsets, call roaring_bitmap_run_optimize for
+ * runs. */
+static roaring_bitmap_t *synthetic_bitmap(synthetic_kind_t kind,
+                                          uint32_t chunks, double density,
+                                          uint32_t run_length) {
+    const uint32_t target = (uint32_t)(density * (1 << 16) + 0.5);
+    uint64_t *words = malloc(SYNTHETIC_WORDS * sizeof(uint64_t));
+    uint32_t *values = malloc((((size_t)chunks << 16) + 1) * sizeof(uint32_t));
+    const double zipf =
+        kind == SYNTHETIC_ZIPF ? synthetic_zipf_constant(target) : 0;
+    size_t n = 0;
+    for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+        memset(words, 0, SYNTHETIC_WORDS * sizeof(uint64_t));
+        switch (kind) {
+            case SYNTHETIC_UNIFORM:
+                synthetic_uniform_chunk(words, target);
+                break;
+            case SYNTHETIC_ZIPF:
+                synthetic_zipf_chunk(words, zipf);
+                break;
+            case SYNTHETIC_CLUSTERED:
+                synthetic_clustered_chunk(words, target, run_length);
+                break;
+            default:
+                synthetic_markov_chunk(words, density, run_length);
+        }
+        for (uint32_t i = 0; i < SYNTHETIC_WORDS; ++i)
+            for (uint64_t w = words[i]; w != 0; w &= w - 1)
+                values[n++] = (chunk << 16) | (i * 64 + __builtin_ctzll(w));
+    }
+    roaring_bitmap_t *r = roaring_bitmap_of_ptr(n, values);
+    free(values);
+    free(words);
+    return r;
+}
+
+#endif /* BENCHMARKS_SYNTHETIC_H_ */
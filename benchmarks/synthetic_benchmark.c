@@ -0,0 +1,152 @@
+/*
+ * synthetic_benchmark.c
+ *
+ * Times and, or, xor and contains on pairs of synthetic bitmaps (see
+ * synthetic.h) while the density of their chunks sweeps across
+ * DEFAULT_MAX_SIZE and the length of their runs across the point where run
+ * containers become smaller. Every configuration is measured as built
+ * (arrays and bitsets) and after roaring_bitmap_run_optimize. Operations are
+ * in cycles per pair of containers, contains in cycles per query, best of
+ * REPEAT. There is no roaring_bitmap_xor: xor goes through a
+ * roaring_expression_t, which works on one bitset per key, so it is not
+ * comparable with and/or on sparse containers. Use -f csv for CSV and -n
+ * to change the number of containers.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "roaring.h"
+#include "roaring_expression.h"
+#include "synthetic.h"
+
+enum { REPEAT = 5, QUERIES = 1 << 16 };
+
+static uint32_t chunks = 64;
+static bool csv = false;
+
+/* "a/b/r", the number of array, bitset and run containers */
+static void describe(const roaring_bitmap_t *r, char *out, size_t size) {
+    roaring_statistics_t stats;
+    roaring_bitmap_statistics(r, &stats);
+    snprintf(out, size, "%u/%u/%u", stats.n_array_containers,
+             stats.n_bitset_containers, stats.n_run_containers);
+}
+
+static roaring_bitmap_t *xor_of(const roaring_expression_t *e) {
+    return roaring_expression_evaluate(e, 2);
+}
+
+#define BEST_OF(best, expression)                                  \
+    do {                                                           \
+        uint64_t cycles_start, cycles_final;                       \
+        best = UINT64_MAX;                                         \
+        for (int r = 0; r < REPEAT; ++r) {                         \
+            RDTSC_START(cycles_start);                             \
+            roaring_bitmap_t *result = expression;                 \
+            RDTSC_FINAL(cycles_final);                             \
+            roaring_bitmap_free(result);                           \
+            if (cycles_final - cycles_start < best)                \
+                best = cycles_final - cycles_start;                \
+        }                                                          \
+    } while (0)
+
+static void measure(synthetic_kind_t kind, double density,
+                    uint32_t run_length) {
+    roaring_bitmap_t *x1 = synthetic_bitmap(kind, chunks, density, run_length);
+    roaring_bitmap_t *x2 = synthetic_bitmap(kind, chunks, density, run_length);
+    uint32_t *queries = malloc(QUERIES * sizeof(uint32_t));
+    for (int i = 0; i < QUERIES; ++i) queries[i] = ranged_random(chunks << 16);
+    for (int optimized = 0; optimized <= 1; ++optimized) {
+        if (optimized) {
+            roaring_bitmap_run_optimize(x1);
+            roaring_bitmap_run_optimize(x2);
+        }
+        roaring_expression_t *e = roaring_expression_create();
+        roaring_expression_xor(e, roaring_expression_bitmap(e, x1),
+                               roaring_expression_bitmap(e, x2));  // node 2
+        uint64_t best_and, best_or, best_xor, best_contains = UINT64_MAX;
+        BEST_OF(best_and, roaring_bitmap_and(x1, x2));
+        BEST_OF(best_or, roaring_bitmap_or(x1, x2));
+        BEST_OF(best_xor, xor_of(e));
+        volatile uint32_t hits = 0;
+        for (int r = 0; r < REPEAT; ++r) {
+            uint64_t cycles_start, cycles_final;
+            RDTSC_START(cycles_start);
+            for (int i = 0; i < QUERIES; ++i)
+                hits += roaring_bitmap_contains(x1, queries[i]);
+            RDTSC_FINAL(cycles_final);
+            if (cycles_final - cycles_start < best_contains)
+                best_contains = cycles_final - cycles_start;
+        }
+        roaring_expression_free(e);
+        char types[64], run_text[16];
+        describe(x1, types, sizeof(types));
+        if (kind == SYNTHETIC_CLUSTERED || kind == SYNTHETIC_MARKOV)
+            snprintf(run_text, sizeof(run_text), "%u", run_length);
+        else
+            snprintf(run_text, sizeof(run_text), "-");
+        printf(csv ? "%s,%.4f,%s,%s,%s,%.1f,%.1f,%.1f,%.2f\n"
+                   : "%-10s %8.4f %6s %-4s %-12s %10.1f %10.1f %10.1f "
+                     "%8.2f\n",
+               synthetic_kind_names[kind], density, run_text,
+               optimized ? "yes" : "no", types, best_and * 1.0 / chunks,
+               best_or * 1.0 / chunks, best_xor * 1.0 / chunks,
+               best_contains * 1.0 / QUERIES);
+    }
+    free(queries);
+    roaring_bitmap_free(x1);
+    roaring_bitmap_free(x2);
+}
+
+static void printusage(char *command) {
+    printf(" Try %s [-f csv] [-n containers] \n", command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "f:n:h")) != -1) switch (c) {
+            case 'f':
+                csv = strcmp(optarg, "csv") == 0;
+                break;
+            case 'n':
+                chunks = (uint32_t)atoi(optarg);
+                if (chunks < 1) chunks = 1;
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    printf(csv ? "kind,density,run_length,run_optimized,array/bitset/run,"
+                 "and,or,xor_expression,contains\n"
+               : "%-10s %8s %6s %-4s %-12s %10s %10s %10s %8s\n",
+           "kind", "density", "run", "opt", "arr/bit/run", "and", "or", "xor(expr)",
+           "contains");
+    // across DEFAULT_MAX_SIZE
+    const double threshold = DEFAULT_MAX_SIZE / 65536.0;
+    const double densities[] = {0.001,           0.01,
+                                0.03,            threshold * 0.8,
+                                threshold * 0.95, threshold,
+                                threshold * 1.05, threshold * 1.25,
+                                0.2,             0.5,
+                                0.9};
+    const size_t ndensities = sizeof(densities) / sizeof(densities[0]);
+    for (int kind = SYNTHETIC_UNIFORM; kind <= SYNTHETIC_ZIPF; ++kind)
+        for (size_t d = 0; d < ndensities; ++d)
+            measure(kind, densities[d], 1);
+    // across the run threshold: a run container beats an array once runs
+    // are longer than 2 values, and a bitset below 2047 runs
+    const double run_densities[] = {0.01, threshold, 0.5};
+    const uint32_t run_lengths[] = {1, 2, 3, 4, 8, 16, 64, 256};
+    for (int kind = SYNTHETIC_CLUSTERED; kind <= SYNTHETIC_MARKOV; ++kind)
+        for (size_t d = 0; d < 3; ++d)
+            for (size_t l = 0; l < sizeof(run_lengths) / sizeof(uint32_t);
+                 ++l)
+                measure(kind, run_densities[d], run_lengths[l]);
+    return 0;
+}
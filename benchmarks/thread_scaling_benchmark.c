@@ -0,0 +1,228 @@
+/*
+ * thread_scaling_benchmark.c
+ *
+ * Runs the pairwise "and" and "or" of the bitmaps of a realdata directory
+ * (x_i & x_{i+1}, x_i | x_{i+1}, each result counted and freed) in 1, 2, 4,
+ * ... up to max_threads threads at once. The inputs are shared and only
+ * read; every thread does the same work, so that with linear scaling the
+ * throughput per thread stays constant:
+ *
+ *   thread_scaling_benchmark [-f csv] [-t max_threads] [-n rounds]
+ *                            [-r repeat] benchmarks/realdata/census1881
+ *
+ * Each thread count is run with the container pool of pool.h disabled
+ * ("malloc": every container goes through roaring_malloc) and enabled
+ * ("pool"), to see how much of a slowdown is allocator contention.
+ * Throughput is in operations per second, best of repeat; efficiency is
+ * the throughput per thread relative to one thread.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <time.h>
+
+#include "benchmark.h"
+#include "numbersfromtextfiles.h"
+#include "roaring.h"
+
+enum { NUM_ALLOCATORS = 2, MAX_THREADS = 256 };
+
+static const char *allocator_names[NUM_ALLOCATORS] = {"malloc", "pool"};
+
+typedef struct workload_s {
+    roaring_bitmap_t **bitmaps;
+    size_t count;
+    int rounds;
+    bool pool;
+    pthread_barrier_t start;
+} workload_t;
+
+typedef struct worker_s {
+    pthread_t thread;
+    workload_t *work;
+    uint64_t answer;
+    double start;   // seconds_now() when the worker passed the barrier
+    double finish;  // and when it was done
+} worker_t;
+
+static double seconds_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void *worker_run(void *arg) {
+    worker_t *w = arg;
+    const workload_t *work = w->work;
+    roaring_pool_set_enabled(work->pool);
+    pthread_barrier_wait(&w->work->start);
+    w->start = seconds_now();
+    uint64_t answer = 0;
+    for (int r = 0; r < work->rounds; ++r)
+        for (size_t i = 0; i + 1 < work->count; ++i) {
+            roaring_bitmap_t *a =
+                roaring_bitmap_and(work->bitmaps[i], work->bitmaps[i + 1]);
+            roaring_bitmap_t *o =
+                roaring_bitmap_or(work->bitmaps[i], work->bitmaps[i + 1]);
+            answer += roaring_bitmap_get_cardinality(a) +
+                      roaring_bitmap_get_cardinality(o);
+            roaring_bitmap_free(a);
+            roaring_bitmap_free(o);
+        }
+    w->finish = seconds_now();
+    w->answer = answer;  // the pool releases its cache when the thread exits
+    return NULL;
+}
+
+/* seconds for threads workers to do work, 0 on failure; *answer is the
+ * checksum of the first worker, the others must agree with it. The workers
+ * time themselves: the main thread may not run again before they are done. */
+static double run_threads(workload_t *work, int threads, uint64_t *answer) {
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&work->start, NULL, threads + 1);
+    int started = 0;
+    for (; started < threads; ++started) {
+        workers[started].work = work;
+        if (pthread_create(&workers[started].thread, NULL, worker_run,
+                           &workers[started]) != 0)
+            break;
+    }
+    if (started < threads) {  // the started ones are waiting on the barrier
+        fprintf(stderr, "could not start %d threads\n", threads);
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_wait(&work->start);
+    for (int t = 0; t < threads; ++t) pthread_join(workers[t].thread, NULL);
+    pthread_barrier_destroy(&work->start);
+    double start = workers[0].start, finish = workers[0].finish;
+    *answer = workers[0].answer;
+    for (int t = 1; t < threads; ++t) {
+        if (workers[t].answer != *answer) return 0;
+        if (workers[t].start < start) start = workers[t].start;
+        if (workers[t].finish > finish) finish = workers[t].finish;
+    }
+    return finish - start;
+}
+
+static void printusage(char *command) {
+    printf(" Try %s [-f csv] [-t max_threads] [-n rounds] [-r repeat] "
+           "directory... \n"
+           " where directory could be benchmarks/realdata/census1881\n",
+           command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    bool csv = false;
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int rounds = 4, repeat = 3;
+    char *extension = ".txt";
+    while ((c = getopt(argc, argv, "e:f:t:n:r:h")) != -1) switch (c) {
+            case 'e':
+                extension = optarg;
+                break;
+            case 'f':
+                csv = strcmp(optarg, "csv") == 0;
+                break;
+            case 't':
+                max_threads = atol(optarg);
+                break;
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    if (optind >= argc) {
+        printusage(argv[0]);
+        return -1;
+    }
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+    if (csv)
+        printf("dataset,allocator,threads,ops_per_second,"
+               "ops_per_second_per_thread,efficiency\n");
+    bool ok = true;
+    for (; optind < argc; ++optind) {
+        size_t count;
+        size_t *howmany = NULL;
+        uint32_t **numbers =
+            read_all_integer_files(argv[optind], extension, &howmany, &count);
+        if (numbers == NULL || count < 2) {
+            fprintf(stderr,
+                    "I could not find or load two data files with extension "
+                    "%s in directory %s.\n",
+                    extension, argv[optind]);
+            for (size_t i = 0; numbers != NULL && i < count; ++i)
+                free(numbers[i]);
+            free(numbers);
+            free(howmany);
+            continue;
+        }
+        char name[256];
+        snprintf(name, sizeof(name), "%s", argv[optind]);
+        for (size_t len = strlen(name); len > 1 && name[len - 1] == '/';)
+            name[--len] = '\0';
+        const char *dataset =
+            strrchr(name, '/') == NULL ? name : strrchr(name, '/') + 1;
+
+        workload_t work;
+        work.bitmaps = malloc(count * sizeof(roaring_bitmap_t *));
+        work.count = count;
+        work.rounds = rounds;
+        for (size_t i = 0; i < count; ++i) {
+            work.bitmaps[i] = roaring_bitmap_of_ptr(howmany[i], numbers[i]);
+            free(numbers[i]);
+        }
+        free(numbers);
+        free(howmany);
+        const double ops = 2.0 * (count - 1) * rounds;  // per thread
+
+        if (!csv)
+            printf("%s: %zu bitmaps, %.0f operations per thread\n"
+                   "%-10s %8s %14s %14s %10s\n",
+                   dataset, count, ops, "allocator", "threads", "ops/s",
+                   "ops/s/thread", "efficiency");
+        for (int a = 0; a < NUM_ALLOCATORS; ++a) {
+            work.pool = a == 1;
+            double single = 0;
+            uint64_t expected = 0;
+            for (long threads = 1;; threads *= 2) {  // 1, 2, 4, ..., max
+                if (threads > max_threads) threads = max_threads;
+                double best = 0;
+                for (int r = 0; r < repeat; ++r) {
+                    uint64_t answer;
+                    const double elapsed =
+                        run_threads(&work, (int)threads, &answer);
+                    if (elapsed == 0 || (expected != 0 && answer != expected)) {
+                        fprintf(stderr, "%s: the threads disagree\n", dataset);
+                        ok = false;
+                    }
+                    expected = answer;
+                    if (best == 0 || elapsed < best) best = elapsed;
+                }
+                const double per_thread = ops / best;
+                if (threads == 1) single = per_thread;
+                if (csv)
+                    printf("%s,%s,%ld,%.0f,%.0f,%.3f\n", dataset,
+                           allocator_names[a], threads, per_thread * threads,
+                           per_thread, per_thread / single);
+                else
+                    printf("%-10s %8ld %14.0f %14.0f %10.3f\n",
+                           allocator_names[a], threads, per_thread * threads,
+                           per_thread, per_thread / single);
+                if (threads == max_threads) break;
+            }
+        }
+        if (!csv) printf("\n");
+
+        for (size_t i = 0; i < count; ++i) roaring_bitmap_free(work.bitmaps[i]);
+        free(work.bitmaps);
+    }
+    return ok ? 0 : -1;
+}
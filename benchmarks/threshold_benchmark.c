@@ -0,0 +1,106 @@
+/*
+ * threshold_benchmark.c
+ *
+ * Computes the values found in at least T of the bitmaps of a directory of
+ * real data, with roaring_bitmap_threshold and with pairwise operations:
+ * after bitmap i, level[j] holds the values found in at least j of the
+ * first i bitmaps, and level[j] |= level[j - 1] & bitmap i.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "benchmark.h"
+#include "numbersfromtextfiles.h"
+#include "roaring.h"
+
+static uint64_t threshold_pairwise(size_t count, roaring_bitmap_t **bitmaps,
+                                   uint32_t t) {
+    roaring_bitmap_t **level = calloc(t + 1, sizeof(roaring_bitmap_t *));
+    for (uint32_t j = 1; j <= t; ++j) level[j] = roaring_bitmap_create();
+    for (size_t i = 0; i < count; ++i) {
+        for (uint32_t j = (i + 1 < t ? i + 1 : t); j >= 2; --j) {
+            roaring_bitmap_t *both = roaring_bitmap_and(level[j - 1], bitmaps[i]);
+            roaring_bitmap_or_inplace(level[j], both);
+            roaring_bitmap_free(both);
+        }
+        roaring_bitmap_or_inplace(level[1], bitmaps[i]);
+    }
+    const uint64_t card = roaring_bitmap_get_cardinality(level[t]);
+    for (uint32_t j = 1; j <= t; ++j) roaring_bitmap_free(level[j]);
+    free(level);
+    return card;
+}
+
+static uint64_t threshold(size_t count, roaring_bitmap_t **bitmaps,
+                          uint32_t t) {
+    roaring_bitmap_t *r =
+        roaring_bitmap_threshold(count, (const roaring_bitmap_t **)bitmaps, t);
+    const uint64_t card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_free(r);
+    return card;
+}
+
+static void printusage(char *command) {
+    printf(
+        " Try %s directory \n where directory could be "
+        "benchmarks/realdata/census1881\n",
+        command);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    char *extension = ".txt";
+    while ((c = getopt(argc, argv, "e:h")) != -1) switch (c) {
+            case 'e':
+                extension = optarg;
+                break;
+            case 'h':
+                printusage(argv[0]);
+                return 0;
+            default:
+                abort();
+        }
+    if (optind >= argc) {
+        printusage(argv[0]);
+        return -1;
+    }
+    char *dirname = argv[optind];
+    size_t count;
+    size_t *howmany = NULL;
+    uint32_t **numbers =
+        read_all_integer_files(dirname, extension, &howmany, &count);
+    if (numbers == NULL) {
+        printf(
+            "I could not find or load any data file with extension %s in "
+            "directory %s.\n",
+            extension, dirname);
+        return -1;
+    }
+    roaring_bitmap_t **bitmaps = malloc(sizeof(roaring_bitmap_t *) * count);
+    uint64_t totalcard = 0;
+    for (size_t i = 0; i < count; i++) {
+        bitmaps[i] = roaring_bitmap_of_ptr(howmany[i], numbers[i]);
+        roaring_bitmap_run_optimize(bitmaps[i]);
+        totalcard += howmany[i];
+    }
+    printf("Loaded %zu bitmaps (%" PRIu64 " values) from directory %s \n",
+           count, totalcard, dirname);
+    const uint32_t thresholds[] = {1, 2, 3, 5, 10};
+    for (size_t k = 0; k < sizeof(thresholds) / sizeof(thresholds[0]); ++k) {
+        const uint32_t t = thresholds[k];
+        const uint64_t expected = threshold_pairwise(count, bitmaps, t);
+        printf("T = %2u (%" PRIu64 " values)\n", t, expected);
+        BEST_TIME(threshold_pairwise(count, bitmaps, t), expected, 3,
+                  totalcard);
+        BEST_TIME(threshold(count, bitmaps, t), expected, 3, totalcard);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        free(numbers[i]);
+        roaring_bitmap_free(bitmaps[i]);
+    }
+    free(bitmaps);
+    free(howmany);
+    free(numbers);
+    return 0;
+}
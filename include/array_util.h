@@ -1,6 +1,7 @@
 #ifndef ARRAY_UTIL_H
 #define ARRAY_UTIL_H
 
+#include <stdbool.h>
 #include <stddef.h>  // for size_t
 #include <stdint.h>
 
@@ -18,12 +19,34 @@ int32_t advanceUntil(const uint16_t *array, int32_t pos, int32_t length,
 int32_t intersect_vector16(const uint16_t *A, size_t s_a, const uint16_t *B,
                            size_t s_b, uint16_t *C);
 
+/**
+ * Number of values in the intersection of two sorted sets of distinct values,
+ * without writing it out.
+ */
+int32_t intersect_vector16_cardinality(const uint16_t *A, size_t s_a,
+                                       const uint16_t *B, size_t s_b);
+
+/**
+ * Whether the intersection of two sorted sets of distinct values has at least
+ * k values. Stops as soon as the answer is known.
+ */
+bool intersect_vector16_cardinality_at_least(const uint16_t *A, size_t s_a,
+                                             const uint16_t *B, size_t s_b,
+                                             size_t k);
+
 /* Computes the intersection between one small and one large set of uint16_t.
  * Stores the result into buffer and return the number of elements. */
 int32_t intersect_skewed_uint16(const uint16_t *small, size_t size_s,
                                 const uint16_t *large, size_t size_l,
                                 uint16_t *buffer);
 
+/* Number of values in the intersection between one small and one large set
+ * of uint16_t. */
+int32_t intersect_skewed_uint16_cardinality(const uint16_t *small,
+                                            size_t size_s,
+                                            const uint16_t *large,
+                                            size_t size_l);
+
 /**
  * Generic intersection function. Passes unit tests.
  */
@@ -1,6 +1,7 @@
 #ifndef BITSET_UTIL_H
 #define BITSET_UTIL_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /*
@@ -18,6 +19,18 @@ void bitset_flip_range(uint64_t *bitmap, uint32_t start, uint32_t end);
  */
 void bitset_reset_range(uint64_t *bitmap, uint32_t start, uint32_t end);
 
+/*
+ * Whether all the bits in indexes [start,end) are set (true when empty).
+ */
+bool bitset_range_all_set(const uint64_t *bitmap, uint32_t start,
+                          uint32_t end);
+
+/*
+ * Whether none of the bits in indexes [start,end) is set.
+ */
+bool bitset_range_none_set(const uint64_t *bitmap, uint32_t start,
+                           uint32_t end);
+
 /*
  * Given a bitset containing "length" 64-bit words, write out the position
  * of all the set bits to "out", values start at "base".
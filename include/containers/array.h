@@ -70,6 +70,18 @@ static inline bool array_container_nonzero_cardinality(
     return array->cardinality > 0;
 }
 
+/* Smallest and largest values, the container must not be empty. */
+static inline uint16_t array_container_minimum(const array_container_t *array) {
+    return array->array[0];
+}
+
+static inline uint16_t array_container_maximum(const array_container_t *array) {
+    return array->array[array->cardinality - 1];
+}
+
+/* Number of values smaller than or equal to x. */
+int array_container_rank(const array_container_t *array, uint16_t x);
+
 /* Copy one container into another. We assume that they are distinct. */
 void array_container_copy(const array_container_t *src, array_container_t *dst);
 
@@ -109,6 +121,23 @@ void array_container_intersection(const array_container_t *src_1,
 void array_container_intersection_inplace(array_container_t *src_1,
                                           const array_container_t *src_2);
 
+/* Compute the size of the intersection of src_1 and src_2 without writing
+ * it out. */
+int array_container_intersection_cardinality(const array_container_t *src_1,
+                                             const array_container_t *src_2);
+
+/* Check whether src_1 and src_2 have at least k values in common, stopping as
+ * soon as the answer is known. */
+bool array_container_intersection_cardinality_at_least(
+    const array_container_t *src_1, const array_container_t *src_2, int k);
+
+/* Compute the size of the union of src_1 and src_2 without writing it out. */
+static inline int array_container_union_cardinality(
+    const array_container_t *src_1, const array_container_t *src_2) {
+    return src_1->cardinality + src_2->cardinality -
+           array_container_intersection_cardinality(src_1, src_2);
+}
+
 /* computes the negation of an array container src, writing to dst,
  *  assumed distinct from src
  *  moved to mixed_negation  TODO: clean me up here
@@ -133,6 +162,17 @@ int array_container_to_uint32_array(uint32_t *out,
                                     const array_container_t *cont,
                                     uint32_t base);
 
+/*
+ * Write out the values of rank offset, offset + 1, ... of the container (the
+ * smallest value has rank 0), at most limit of them, as 32-bit integers
+ * starting at base. Returns the number of values written, never more than
+ * limit: out needs no room beyond that.
+ */
+int array_container_range_to_uint32_array(uint32_t *out,
+                                          const array_container_t *cont,
+                                          uint32_t base, int32_t offset,
+                                          int32_t limit);
+
 /* Compute the number of runs */
 int32_t array_container_number_of_runs(const array_container_t *a);
 
@@ -166,6 +206,10 @@ static inline int32_t array_container_serialized_size_in_bytes(int32_t card) {
 void array_container_grow(array_container_t *container, int32_t min,
                           int32_t max, bool preserve);
 
+/* Reduce the capacity to the cardinality (non-empty containers only). Return
+ * the number of bytes released. */
+int32_t array_container_shrink_to_fit(array_container_t *container);
+
 void array_container_iterate(const array_container_t *cont, uint32_t base,
                              roaring_iterator iterator, void *ptr);
 
@@ -207,4 +251,10 @@ static inline int32_t array_container_size_in_bytes(
 bool array_container_equals(array_container_t *container1,
                             array_container_t *container2);
 
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool array_container_is_subset(const array_container_t *container1,
+                               const array_container_t *container2);
+
 #endif /* INCLUDE_CONTAINERS_ARRAY_H_ */
@@ -202,6 +202,13 @@ static inline bool bitset_container_nonzero_cardinality(
     return bitset->cardinality > 0;
 }
 
+/* Smallest and largest values, the container must not be empty. */
+uint16_t bitset_container_minimum(const bitset_container_t *bitset);
+uint16_t bitset_container_maximum(const bitset_container_t *bitset);
+
+/* Number of values smaller than or equal to x. */
+int bitset_container_rank(const bitset_container_t *bitset, uint16_t x);
+
 /* Copy one container into another. We assume that they are distinct. */
 void bitset_container_copy(const bitset_container_t *source,
                            bitset_container_t *dest);
@@ -319,6 +326,17 @@ int bitset_container_to_uint32_array(uint32_t *out,
                                      const bitset_container_t *cont,
                                      uint32_t base);
 
+/*
+ * Write out the values of rank offset, offset + 1, ... of the container (the
+ * smallest value has rank 0), at most limit of them, as 32-bit integers
+ * starting at base. Returns the number of values written, never more than
+ * limit: out needs no room beyond that.
+ */
+int bitset_container_range_to_uint32_array(uint32_t *out,
+                                           const bitset_container_t *cont,
+                                           uint32_t base, int32_t offset,
+                                           int32_t limit);
+
 /*
  * Print this container using printf (useful for debugging).
  */
@@ -341,7 +359,7 @@ static inline int32_t bitset_container_serialized_size_in_bytes(void) {
 /**
  * Return the the number of runs.
  */
-int bitset_container_number_of_runs(bitset_container_t *b);
+int bitset_container_number_of_runs(const bitset_container_t *b);
 
 void bitset_container_iterate(const bitset_container_t *cont, uint32_t base,
                               roaring_iterator iterator, void *ptr);
@@ -383,4 +401,10 @@ static inline int32_t bitset_container_size_in_bytes(
 bool bitset_container_equals(bitset_container_t *container1,
                              bitset_container_t *container2);
 
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool bitset_container_is_subset(const bitset_container_t *container1,
+                                const bitset_container_t *container2);
+
 #endif /* INCLUDE_CONTAINERS_BITSET_H_ */
@@ -11,8 +11,12 @@
 #include "mixed_equal.h"
 #include "mixed_intersection.h"
 #include "mixed_negation.h"
+#include "mixed_subset.h"
 #include "mixed_union.h"
+#include "pool.h"
 #include "run.h"
+#include "roaring_memory.h"
+#include "roaring_trace.h"
 
 // would enum be possible or better?
 
@@ -93,6 +97,7 @@ void *container_clone(const void *container, uint8_t typecode);
 /* access to container underneath, cloning it if needed */
 static inline void * get_writable_copy_if_shared(void *candidate_shared_container, uint8_t * type) {
 	if(*type == SHARED_CONTAINER_TYPE_CODE) {
+                 ROARING_TRACE_UNSHARE();
                  return shared_container_extract_copy(candidate_shared_container,type);
 	} else {
 		return candidate_shared_container;
@@ -291,6 +296,114 @@ static inline int32_t container_size_in_bytes(const void *container,
     return 0;  // unreached
 }
 
+/**
+ * Get the number of heap bytes held by the container, including unused
+ * capacity and the shared wrapper if any, requires a typecode
+ */
+static inline size_t container_memory_size_in_bytes(const void *container,
+                                                    uint8_t typecode) {
+    size_t wrapper = 0;
+    if (typecode == SHARED_CONTAINER_TYPE_CODE)
+        wrapper = sizeof(shared_container_t);
+    container = container_unwrap_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return wrapper + sizeof(bitset_container_t) +
+                   BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t);
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return wrapper + sizeof(array_container_t) +
+                   ((const array_container_t *)container)->capacity *
+                       sizeof(uint16_t);
+        case RUN_CONTAINER_TYPE_CODE:
+            return wrapper + sizeof(run_container_t) +
+                   ((const run_container_t *)container)->capacity *
+                       sizeof(rle16_t);
+    }
+    assert(false);
+    __builtin_unreachable();
+    return 0;  // unreached
+}
+
+/**
+ * Release the unused capacity of the container, requires a typecode. Shared
+ * containers are left alone. Return the number of bytes released.
+ */
+static inline int32_t container_shrink_to_fit(void *container,
+                                              uint8_t typecode) {
+    switch (typecode) {
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return array_container_shrink_to_fit(
+                (array_container_t *)container);
+        case RUN_CONTAINER_TYPE_CODE:
+            return run_container_shrink_to_fit((run_container_t *)container);
+    }
+    return 0;  // bitsets have a fixed size
+}
+
+/**
+ * Get the smallest value in a non-empty container, requires a typecode
+ */
+static inline uint16_t container_minimum(const void *container,
+                                         uint8_t typecode) {
+    container = container_unwrap_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return bitset_container_minimum(
+                (const bitset_container_t *)container);
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return array_container_minimum(
+                (const array_container_t *)container);
+        case RUN_CONTAINER_TYPE_CODE:
+            return run_container_minimum((const run_container_t *)container);
+    }
+    assert(false);
+    __builtin_unreachable();
+    return 0;  // unreached
+}
+
+/**
+ * Get the largest value in a non-empty container, requires a typecode
+ */
+static inline uint16_t container_maximum(const void *container,
+                                         uint8_t typecode) {
+    container = container_unwrap_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return bitset_container_maximum(
+                (const bitset_container_t *)container);
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return array_container_maximum(
+                (const array_container_t *)container);
+        case RUN_CONTAINER_TYPE_CODE:
+            return run_container_maximum((const run_container_t *)container);
+    }
+    assert(false);
+    __builtin_unreachable();
+    return 0;  // unreached
+}
+
+/**
+ * Get the number of values smaller than or equal to x in a container,
+ * requires a typecode
+ */
+static inline int container_rank(const void *container, uint8_t typecode,
+                                 uint16_t x) {
+    container = container_unwrap_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return bitset_container_rank((const bitset_container_t *)container,
+                                         x);
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return array_container_rank((const array_container_t *)container,
+                                        x);
+        case RUN_CONTAINER_TYPE_CODE:
+            return run_container_rank((const run_container_t *)container, x);
+    }
+    assert(false);
+    __builtin_unreachable();
+    return 0;  // unreached
+}
+
 /**
  * print the container (useful for debugging), requires a  typecode
  */
@@ -373,6 +486,33 @@ static inline int container_to_uint32_array(uint32_t *output,
     return 0;  // unreached
 }
 
+/**
+ * Write out the values of rank offset, offset + 1, ... of a container, at
+ * most limit of them, as 32-bit integers starting at base. Returns the number
+ * of values written: output needs room for limit values and no more.
+ */
+static inline int container_range_to_uint32_array(uint32_t *output,
+                                                  const void *container,
+                                                  uint8_t typecode,
+                                                  uint32_t base, int32_t offset,
+                                                  int32_t limit) {
+    container = container_unwrap_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return bitset_container_range_to_uint32_array(
+                output, (bitset_container_t *)container, base, offset, limit);
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return array_container_range_to_uint32_array(
+                output, (array_container_t *)container, base, offset, limit);
+        case RUN_CONTAINER_TYPE_CODE:
+            return run_container_range_to_uint32_array(
+                output, (run_container_t *)container, base, offset, limit);
+    }
+    assert(false);
+    __builtin_unreachable();
+    return 0;  // unreached
+}
+
 /**
  * Add a value to a container, requires a  typecode, fills in new_typecode and
  * return (possibly different) container.
@@ -410,6 +550,42 @@ static inline void *container_add(void *container, uint16_t val,
     }
 }
 
+/**
+ * Remove a value from a container, requires a  typecode, fills in new_typecode
+ * and return (possibly different) container.
+ * This function may allocate a new container, and caller is responsible for
+ * memory deallocation
+ */
+static inline void *container_remove(void *container, uint16_t val,
+                                     uint8_t typecode, uint8_t *new_typecode) {
+    container = get_writable_copy_if_shared(container, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE: {
+            bitset_container_t *bc = (bitset_container_t *)container;
+            if (bitset_container_remove(bc, val) &&
+                bc->cardinality <= DEFAULT_MAX_SIZE) {
+                *new_typecode = ARRAY_CONTAINER_TYPE_CODE;
+                return array_container_from_bitset(bc);
+            }
+            *new_typecode = BITSET_CONTAINER_TYPE_CODE;
+            return container;
+        }
+        case ARRAY_CONTAINER_TYPE_CODE:
+            array_container_remove((array_container_t *)container, val);
+            *new_typecode = ARRAY_CONTAINER_TYPE_CODE;
+            return container;
+        case RUN_CONTAINER_TYPE_CODE:
+            // as for container_add, no container type adjustments are done
+            run_container_remove((run_container_t *)container, val);
+            *new_typecode = RUN_CONTAINER_TYPE_CODE;
+            return container;
+        default:
+            assert(false);
+            __builtin_unreachable();
+            return NULL;
+    }
+}
+
 /**
  * Check whether a value is in a container, requires a  typecode
  */
@@ -452,6 +628,7 @@ static inline bool container_equals(const void *c1, uint8_t type1,
                                     const void *c2, uint8_t type2) {
 	c1 = container_unwrap_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
+    ROARING_TRACE_KERNEL(ROARING_TRACE_EQUALS, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -507,6 +684,7 @@ static inline void *container_and(const void *c1, uint8_t type1, const void *c2,
 	c1 = container_unwrap_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
 	void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_AND, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -600,6 +778,7 @@ static inline void *container_iand(void *c1, uint8_t type1, const void *c2,
 	c1 = get_writable_copy_if_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
     void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_IAND, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -616,14 +795,11 @@ static inline void *container_iand(void *c1, uint8_t type1, const void *c2,
             *result_type = ARRAY_CONTAINER_TYPE_CODE;
             return c1;
         case CONTAINER_PAIR(RUN_CONTAINER_TYPE_CODE, RUN_CONTAINER_TYPE_CODE):
-            result = run_container_create();
-            run_container_intersection((const run_container_t *)c1,
-                                       (const run_container_t *)c2,
-                                       (run_container_t *)result);
-            // as of January 2016, Java code used non-in-place intersection for
-            // two runcontainers
-            return convert_run_to_efficient_container_and_free(
-                (run_container_t *)result, result_type);
+            run_container_intersection_inplace((run_container_t *)c1,
+                                               (const run_container_t *)c2);
+            // the caller frees c1 if it gets converted
+            return convert_run_to_efficient_container((run_container_t *)c1,
+                                                      result_type);
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             ARRAY_CONTAINER_TYPE_CODE):
             // c1 is a bitmap so no inplace possible
@@ -659,12 +835,11 @@ static inline void *container_iand(void *c1, uint8_t type1, const void *c2,
                                : ARRAY_CONTAINER_TYPE_CODE;
             return result;
         case CONTAINER_PAIR(ARRAY_CONTAINER_TYPE_CODE, RUN_CONTAINER_TYPE_CODE):
-            result = array_container_create();
             *result_type = ARRAY_CONTAINER_TYPE_CODE;  // never bitset
             array_run_container_intersection((const array_container_t *)c1,
                                              (const run_container_t *)c2,
-                                             (array_container_t *)result);
-            return result;
+                                             (array_container_t *)c1);  // allowed
+            return c1;
 
         case CONTAINER_PAIR(RUN_CONTAINER_TYPE_CODE, ARRAY_CONTAINER_TYPE_CODE):
             result = array_container_create();
@@ -690,6 +865,7 @@ static inline void *container_or(const void *c1, uint8_t type1, const void *c2,
 	c1 = container_unwrap_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
 	void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_OR, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -800,6 +976,7 @@ static inline void *container_lazy_or(const void *c1, uint8_t type1,
 	c1 = container_unwrap_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
 	void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_LAZY_OR, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -912,6 +1089,7 @@ static inline void *container_ior(void *c1, uint8_t type1, const void *c2,
 	c1 = get_writable_copy_if_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
     void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_IOR, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -1016,6 +1194,7 @@ static inline void *container_lazy_ior(void *c1, uint8_t type1, const void *c2,
 	//c1 = get_writable_copy_if_shared(c1,&type1);
 	c2 = container_unwrap_shared(c2,&type2);
     void *result = NULL;
+    ROARING_TRACE_KERNEL(ROARING_TRACE_LAZY_IOR, type1, type2);
     switch (CONTAINER_PAIR(type1, type2)) {
         case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
                             BITSET_CONTAINER_TYPE_CODE):
@@ -38,6 +38,12 @@ void *convert_to_bitset_or_array_container(run_container_t *r, int32_t card,
 void *convert_run_optimize(void *c, uint8_t typecode_original,
                            uint8_t *typecode_after);
 
+/* Same as convert_run_optimize, but the container is neither freed nor
+ * modified: it is returned as is when no conversion is needed, otherwise a
+ * new container is returned. */
+void *convert_run_optimize_copy(const void *c, uint8_t typecode_original,
+                                uint8_t *typecode_after);
+
 /* converts a run container to either an array or a bitset, IF it saves space.
  */
 /* If a conversion occurs, the caller is responsible to free the original
@@ -0,0 +1,56 @@
+/*
+ * mixed_subset.h
+ *
+ */
+
+#ifndef CONTAINERS_MIXED_SUBSET_H_
+#define CONTAINERS_MIXED_SUBSET_H_
+
+#include "array.h"
+#include "bitset.h"
+#include "run.h"
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool array_container_is_subset_bitset(const array_container_t* container1,
+                                      const bitset_container_t* container2);
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool array_container_is_subset_run(const array_container_t* container1,
+                                   const run_container_t* container2);
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool bitset_container_is_subset_array(const bitset_container_t* container1,
+                                      const array_container_t* container2);
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool bitset_container_is_subset_run(const bitset_container_t* container1,
+                                    const run_container_t* container2);
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool run_container_is_subset_array(const run_container_t* container1,
+                                   const array_container_t* container2);
+
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool run_container_is_subset_bitset(const run_container_t* container1,
+                                    const bitset_container_t* container2);
+
+/**
+ * Return true if all the values of c1 are in c2, whatever the two types
+ * (typecodes of containers/containers.h, shared containers included).
+ */
+bool container_is_subset(const void* c1, uint8_t type1, const void* c2,
+                         uint8_t type2);
+
+#endif /* CONTAINERS_MIXED_SUBSET_H_ */
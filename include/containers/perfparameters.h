@@ -13,6 +13,14 @@ because
 huge run containers are implemented less efficiently. Note that
 RUN_OPTI_MINIMAL_GAIN = 1 means that this optimization is disabled.
 
+When intersecting or merging run containers (or an array container with a run
+container), we gallop through the larger input instead of visiting all of its
+runs (or values) once it is RUN_GALLOP_RATIO times larger than the other.
+
 */
-enum { ARRAY_LAZY_LOWERBOUND = 1024, RUN_OPTI_MINIMAL_GAIN = 1 };
+enum {
+    ARRAY_LAZY_LOWERBOUND = 1024,
+    RUN_OPTI_MINIMAL_GAIN = 1,
+    RUN_GALLOP_RATIO = 8
+};
 #endif
@@ -0,0 +1,59 @@
+/*
+ * pool.h
+ *
+ */
+
+#ifndef INCLUDE_CONTAINERS_POOL_H_
+#define INCLUDE_CONTAINERS_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Each thread keeps a small free list of recently released container
+ * payloads: the 8KB word arrays of bitset containers and the arrays of small
+ * array containers (capacities 16, 32 and 64, the first sizes produced by
+ * array_container_grow). Payloads released by one thread may be reused by
+ * another, they are ordinary heap blocks. */
+
+/* Return a 32-byte aligned, uninitialized array of
+ * BITSET_CONTAINER_SIZE_IN_WORDS words. Return NULL in case of failure. */
+uint64_t *pool_bitset_words_get(void);
+
+/* Give back an array obtained from pool_bitset_words_get (NULL is ignored). */
+void pool_bitset_words_put(uint64_t *words);
+
+/* Return an uninitialized array of (at least) capacity 16-bit values.
+ * Return NULL in case of failure. */
+uint16_t *pool_array_payload_get(int32_t capacity);
+
+/* Give back an array holding capacity 16-bit values, obtained from
+ * pool_array_payload_get or from roaring_malloc/roaring_realloc (NULL is
+ * ignored). */
+void pool_array_payload_put(uint16_t *array, int32_t capacity);
+
+/* Pool statistics for the calling thread (hits are allocations served from
+ * the free lists). */
+typedef struct roaring_pool_stats_s {
+    uint64_t bitset_hits;
+    uint64_t bitset_misses;
+    uint64_t array_hits;
+    uint64_t array_misses;
+    uint32_t cached_bitsets;
+    uint32_t cached_arrays;
+    size_t cached_bytes;
+} roaring_pool_stats_t;
+
+/* Fill in the statistics of the calling thread's pool. */
+void roaring_pool_get_stats(roaring_pool_stats_t *stats);
+
+/* Release cached payloads of the calling thread until at most max_cached_bytes
+ * remain cached (use 0 to empty the pool). Returns the number of bytes
+ * released. */
+size_t roaring_pool_trim(size_t max_cached_bytes);
+
+/* Enable (default) or disable pooling for the calling thread. Disabling
+ * releases everything currently cached. */
+void roaring_pool_set_enabled(bool enabled);
+
+#endif /* INCLUDE_CONTAINERS_POOL_H_ */
@@ -8,6 +8,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "portability.h"
 #include "roaring_types.h"
@@ -80,6 +81,19 @@ static inline bool run_container_nonzero_cardinality(
     return run->n_runs > 0;  // runs never empty
 }
 
+/* Smallest and largest values, the container must not be empty. */
+static inline uint16_t run_container_minimum(const run_container_t *run) {
+    return run->runs[0].value;
+}
+
+static inline uint16_t run_container_maximum(const run_container_t *run) {
+    const rle16_t last = run->runs[run->n_runs - 1];
+    return last.value + last.length;
+}
+
+/* Number of values smaller than or equal to x. */
+int run_container_rank(const run_container_t *run, uint16_t x);
+
 /* Copy one container into another. We assume that they are distinct. */
 void run_container_copy(const run_container_t *src, run_container_t *dst);
 
@@ -161,6 +175,59 @@ static inline rle16_t run_container_append_value_first(run_container_t *run,
     return newrle;
 }
 
+/**
+ * Append the n runs to the run container, merging the first ones with
+ * previousrl when they overlap or touch it; the others are copied as a block.
+ * The runs must be sorted, disjoint and must not start before previousrl,
+ * and the container must not be empty. The caller is responsible for
+ * checking memory capacity.
+ */
+static inline void run_container_append_runs(run_container_t *run,
+                                             const rle16_t *runs, int32_t n,
+                                             rle16_t *previousrl) {
+    int32_t i = 0;
+    while (i < n && (uint32_t)runs[i].value <=
+                        (uint32_t)previousrl->value + previousrl->length + 1) {
+        run_container_append(run, runs[i], previousrl);
+        ++i;
+    }
+    if (i < n) {
+        memcpy(run->runs + run->n_runs, runs + i, (n - i) * sizeof(rle16_t));
+        run->n_runs += n - i;
+        *previousrl = runs[n - 1];
+    }
+}
+
+/**
+ * Galloping search over sorted runs: return the smallest index greater than
+ * pos such that runs[index] ends at or after min, or length if there is none.
+ */
+static inline int32_t rle16_advance_until(const rle16_t *runs, int32_t pos,
+                                          int32_t length, uint16_t min) {
+    int32_t lower = pos + 1;
+    if ((lower >= length) || (runs[lower].value + runs[lower].length >= min)) {
+        return lower;
+    }
+    int32_t spansize = 1;
+    while ((lower + spansize < length) &&
+           (runs[lower + spansize].value + runs[lower + spansize].length <
+            min)) {
+        spansize <<= 1;
+    }
+    int32_t upper = (lower + spansize < length) ? lower + spansize : length - 1;
+    if (runs[upper].value + runs[upper].length < min) return length;
+    // runs[lower] ends before min, runs[upper] does not
+    lower += (spansize >> 1);
+    while (lower + 1 != upper) {
+        const int32_t mid = (lower + upper) >> 1;
+        if (runs[mid].value + runs[mid].length < min)
+            lower = mid;
+        else
+            upper = mid;
+    }
+    return upper;
+}
+
 /**
  * increase capacity to at least min. Whether the
  * existing data needs to be copied over depends on copy. If "copy" is false,
@@ -168,6 +235,10 @@ static inline rle16_t run_container_append_value_first(run_container_t *run,
  */
 void run_container_grow(run_container_t *run, int32_t min, bool copy);
 
+/* Reduce the capacity to the number of runs (non-empty containers only).
+ * Return the number of bytes released. */
+int32_t run_container_shrink_to_fit(run_container_t *run);
+
 /* Check whether the container spans the whole chunk (cardinality = 1<<16).
  * This check can be done in constant time (inexpensive). */
 static inline bool run_container_is_full(const run_container_t *run) {
@@ -190,6 +261,12 @@ void run_container_intersection(const run_container_t *src_1,
                                 const run_container_t *src_2,
                                 run_container_t *dst);
 
+/* Compute the intersection of src_1 and src_2 and write the result to
+ * src_1, reusing its storage (it grows only if it has room for fewer than
+ * src_1->n_runs + src_2->n_runs runs). */
+void run_container_intersection_inplace(run_container_t *src_1,
+                                        const run_container_t *src_2);
+
 /*
  * Write out the 16-bit integers contained in this container as a list of 32-bit
  * integers using base
@@ -201,6 +278,17 @@ void run_container_intersection(const run_container_t *src_1,
 int run_container_to_uint32_array(uint32_t *out, const run_container_t *cont,
                                   uint32_t base);
 
+/*
+ * Write out the values of rank offset, offset + 1, ... of the container (the
+ * smallest value has rank 0), at most limit of them, as 32-bit integers
+ * starting at base. Returns the number of values written, never more than
+ * limit: out needs no room beyond that.
+ */
+int run_container_range_to_uint32_array(uint32_t *out,
+                                        const run_container_t *cont,
+                                        uint32_t base, int32_t offset,
+                                        int32_t limit);
+
 /*
  * Print this container using printf (useful for debugging).
  */
@@ -258,6 +346,12 @@ static inline int32_t run_container_size_in_bytes(const run_container_t *contain
 bool run_container_equals(run_container_t *container1,
                           run_container_t *container2);
 
+/**
+ * Return true if all the values of container1 are in container2.
+ */
+bool run_container_is_subset(const run_container_t *container1,
+                             const run_container_t *container2);
+
 /**
  * Used in a start-finish scan that appends segments, for XOR and NOT
  */
@@ -43,6 +43,59 @@ roaring_bitmap_t *roaring_bitmap_of_ptr(size_t n_args, const uint32_t *vals);
  */
 void roaring_bitmap_printf_describe(const roaring_bitmap_t *ra);
 
+/**
+ * Shape and memory usage of a bitmap, see roaring_bitmap_statistics.
+ * Shared containers (copy-on-write) are counted under the type of the
+ * container they wrap, and their memory is counted by every bitmap that
+ * refers to them.
+ */
+typedef struct roaring_statistics_s {
+    uint32_t n_containers;
+    uint32_t n_array_containers;
+    uint32_t n_run_containers;
+    uint32_t n_bitset_containers;
+    uint32_t n_shared_containers;
+
+    uint64_t cardinality;
+    uint64_t n_values_array_containers;
+    uint64_t n_values_run_containers;
+    uint64_t n_values_bitset_containers;
+
+    /* heap bytes, including unused capacity */
+    size_t n_bytes_array_containers;
+    size_t n_bytes_run_containers;
+    size_t n_bytes_bitset_containers;
+    size_t n_bytes_directory;  // roaring_bitmap_t, roaring_array_t and keys
+    size_t n_bytes;            // total of the above
+
+    size_t portable_size_in_bytes;  // see roaring_bitmap_portable_serialize
+
+    uint32_t min_value;  // min_value > max_value when the bitmap is empty
+    uint32_t max_value;
+} roaring_statistics_t;
+
+/**
+ * Reallocate the containers and the key directory to their exact sizes,
+ * releasing the capacity left over by incremental construction. Useful once a
+ * long-lived bitmap has been loaded. Returns the number of bytes released.
+ */
+size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r);
+
+/**
+ * Same as roaring_bitmap_shrink_to_fit, splitting the containers among up to
+ * number_of_threads threads. The work is done in the calling thread when it
+ * has its own allocator installed (see roaring_set_thread_memory_hook).
+ */
+size_t roaring_bitmap_shrink_to_fit_parallel(roaring_bitmap_t *r,
+                                             int number_of_threads);
+
+/**
+ * Fill in the statistics of the bitmap. This takes time proportional to the
+ * number of containers (plus the number of runs), not to the cardinality.
+ */
+void roaring_bitmap_statistics(const roaring_bitmap_t *ra,
+                               roaring_statistics_t *stat);
+
 /**
  * Creates a new bitmap from a list of uint32_t integers
  */
@@ -109,6 +162,32 @@ roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
 roaring_bitmap_t *roaring_bitmap_or_many_heap(uint32_t number,
                                               const roaring_bitmap_t **x);
 
+/**
+ * Compute the values found in at least 'threshold' of the 'number' bitmaps
+ * (1 gives the union, 'number' the intersection, 0 is taken as 1). Keys
+ * present in fewer than 'threshold' key directories are skipped. Caller is
+ * responsible for freeing the result. Returns NULL in case of failure.
+ */
+roaring_bitmap_t *roaring_bitmap_threshold(size_t number,
+                                           const roaring_bitmap_t **x,
+                                           uint32_t threshold);
+
+/**
+ * Build a bitmap index over a column in one pass: returns an array of
+ * 'number_of_values' bitmaps where the bitmap of value v holds the rows i
+ * with values[i] == v, or with values[i] <= v if 'range_encoded'. Row i is
+ * rows[i], or i if rows is NULL; rows need not be sorted. The rows are
+ * bucketed by value and key so that every container is built from sorted
+ * input. Caller frees the bitmaps (roaring_bitmap_free) and free()s the
+ * array, which comes from malloc as for roaring_bitmap_to_uint32_array.
+ * Returns NULL if a value is not below 'number_of_values' or in case of
+ * failure.
+ */
+roaring_bitmap_t **roaring_bitmap_index_build(const uint32_t *values,
+                                              const uint32_t *rows, uint32_t n,
+                                              uint32_t number_of_values,
+                                              bool range_encoded);
+
 
 /**
  * Frees the memory.
@@ -117,11 +196,14 @@ void roaring_bitmap_free(roaring_bitmap_t *r);
 
 /**
  * Add value x
- *
- * TODO: add a way to remove values
  */
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t x);
 
+/**
+ * Remove value x
+ */
+void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t x);
+
 /**
  * Check if value x is present
  */
@@ -132,13 +214,55 @@ bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t x);
  */
 uint64_t roaring_bitmap_get_cardinality(const roaring_bitmap_t *ra);
 
+/**
+ * Get the number of values in [range_start, range_end). Only the containers
+ * holding range_start and range_end - 1 are looked into, the others count
+ * whole.
+ */
+uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *ra,
+                                          uint64_t range_start,
+                                          uint64_t range_end);
+
+/**
+ * Get the smallest value in the bitmap, UINT32_MAX if it is empty. Only the
+ * first container is read.
+ */
+uint32_t roaring_bitmap_minimum(const roaring_bitmap_t *ra);
+
+/**
+ * Get the largest value in the bitmap, 0 if it is empty. Only the last
+ * container is read.
+ */
+uint32_t roaring_bitmap_maximum(const roaring_bitmap_t *ra);
+
 /**
  * Convert the bitmap to an array. Array is allocated and caller is responsible
  * for eventually freeing it.
  */
 uint32_t *roaring_bitmap_to_uint32_array(const roaring_bitmap_t *ra,
                                          uint32_t *cardinality);
-#endif
+
+/**
+ * Write the values of rank offset, offset + 1, ... of the bitmap (the
+ * smallest value has rank 0) to ans, at most limit of them, and return how
+ * many were written: ans needs room for limit values and no more. Containers
+ * before offset are skipped whole and only the needed part of the others is
+ * decoded, so that one page of a large bitmap costs about the size of the
+ * page.
+ */
+size_t roaring_bitmap_range_uint32_array(const roaring_bitmap_t *ra,
+                                         size_t offset, size_t limit,
+                                         uint32_t *ans);
+
+/**
+ * Write the values of the bitmap in [range_start, range_end) to ans, in
+ * increasing order and at most limit of them, and return how many were
+ * written. The next page of a range starts after the last value written.
+ */
+size_t roaring_bitmap_range_values_uint32_array(const roaring_bitmap_t *ra,
+                                                uint64_t range_start,
+                                                uint64_t range_end,
+                                                size_t limit, uint32_t *ans);
 
 /**
  *  Remove run-length encoding even when it is more space efficient
@@ -153,6 +277,30 @@ bool roaring_bitmap_remove_run_compression(roaring_bitmap_t *r);
 */
 bool roaring_bitmap_run_optimize(roaring_bitmap_t *r);
 
+/* What a conversion pass did to the containers of a bitmap. */
+typedef struct roaring_conversion_stats_s {
+    uint32_t n_containers_converted;
+    /* change in the serialized size of the containers (the header of
+     * roaring_bitmap_portable_serialize is not counted), negative when the
+     * bitmap grows */
+    int64_t n_bytes_saved;
+} roaring_conversion_stats_t;
+
+/**
+ * Same as roaring_bitmap_run_optimize (resp.
+ * roaring_bitmap_remove_run_compression), splitting the containers among up
+ * to number_of_threads threads as roaring_bitmap_shrink_to_fit_parallel does.
+ * A shared container (see copy_on_write) is only replaced when it is
+ * converted; the conversion reads it without cloning it first. If stats is
+ * not NULL, it is filled in.
+ */
+bool roaring_bitmap_run_optimize_parallel(roaring_bitmap_t *r,
+                                          int number_of_threads,
+                                          roaring_conversion_stats_t *stats);
+bool roaring_bitmap_remove_run_compression_parallel(
+    roaring_bitmap_t *r, int number_of_threads,
+    roaring_conversion_stats_t *stats);
+
 // see roaring_bitmap_portable_serialize if you want a format that's compatible
 // with Java and Go implementations
 char *roaring_bitmap_serialize(roaring_bitmap_t *ra, uint32_t *serialize_len);
@@ -197,6 +345,20 @@ void roaring_iterate(roaring_bitmap_t *ra, roaring_iterator iterator,
  */
 bool roaring_bitmap_equals(roaring_bitmap_t *ra1, roaring_bitmap_t *ra2);
 
+/**
+ * Return true if all the elements of ra1 are also in ra2. Stops at the first
+ * element of ra1 missing from ra2, without computing the intersection.
+ */
+bool roaring_bitmap_is_subset(const roaring_bitmap_t *ra1,
+                              const roaring_bitmap_t *ra2);
+
+/**
+ * Return true if all the elements of ra1 are also in ra2, and ra2 has
+ * elements that ra1 does not have.
+ */
+bool roaring_bitmap_is_strict_subset(const roaring_bitmap_t *ra1,
+                                     const roaring_bitmap_t *ra2);
+
 /**
  * (For expert users who seek high performance.)
  *
@@ -245,3 +407,5 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
 
 void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
                                  uint64_t range_end);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * roaring64.h
+ *
+ */
+
+#ifndef INCLUDE_ROARING64_H_
+#define INCLUDE_ROARING64_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "roaring.h"
+
+/* A bitmap of 64-bit values. The values sharing their 32 most significant
+ * bits form a bucket, stored as a roaring_bitmap_t of their 32 least
+ * significant bits. Buckets are sorted by their high bits and never empty. */
+typedef struct roaring64_bitmap_s {
+    uint32_t *high;
+    roaring_bitmap_t **bitmaps;
+    int32_t size;
+    int32_t capacity;
+    bool copy_on_write; /* passed on to the buckets when they are created,
+                           so it should be set before adding values (see
+                           roaring_bitmap_t). */
+} roaring64_bitmap_t;
+
+typedef void (*roaring64_iterator)(uint64_t value, void *param);
+
+/**
+ * Creates a new bitmap (initially empty)
+ */
+roaring64_bitmap_t *roaring64_bitmap_create(void);
+
+/**
+ * Creates a new bitmap from a pointer of uint64_t integers
+ */
+roaring64_bitmap_t *roaring64_bitmap_of_ptr(size_t n_args,
+                                            const uint64_t *vals);
+
+/**
+ * Copies a bitmap. This does memory allocation. The caller is responsible for
+ * memory management.
+ */
+roaring64_bitmap_t *roaring64_bitmap_copy(const roaring64_bitmap_t *r);
+
+void roaring64_bitmap_free(roaring64_bitmap_t *r);
+
+/**
+ * Add value x
+ */
+void roaring64_bitmap_add(roaring64_bitmap_t *r, uint64_t x);
+
+/**
+ * Remove value x
+ */
+void roaring64_bitmap_remove(roaring64_bitmap_t *r, uint64_t x);
+
+/**
+ * Check if value x is present
+ */
+bool roaring64_bitmap_contains(const roaring64_bitmap_t *r, uint64_t x);
+
+/**
+ * Get the cardinality of the bitmap (number elements).
+ */
+uint64_t roaring64_bitmap_get_cardinality(const roaring64_bitmap_t *r);
+
+/**
+ * Computes the intersection (resp. union, symmetric difference, difference
+ * x1 & ~x2) between two bitmaps and returns new bitmap. The caller is
+ * responsible for memory management. Return NULL in case of failure.
+ */
+roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *x1,
+                                         const roaring64_bitmap_t *x2);
+roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *x1,
+                                        const roaring64_bitmap_t *x2);
+roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *x1,
+                                         const roaring64_bitmap_t *x2);
+roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *x1,
+                                            const roaring64_bitmap_t *x2);
+
+/**
+ * Inplace versions of roaring64_bitmap_and and roaring64_bitmap_or, modify
+ * x1. roaring64_bitmap_or_inplace returns false, x1 being then left
+ * unmodified, when it cannot copy the buckets that x1 lacks. The buckets of
+ * x1 that x2 shares are merged with roaring_bitmap_or_inplace, which (as the
+ * rest of the 32-bit API) does not report allocation failures.
+ */
+void roaring64_bitmap_and_inplace(roaring64_bitmap_t *x1,
+                                  const roaring64_bitmap_t *x2);
+bool roaring64_bitmap_or_inplace(roaring64_bitmap_t *x1,
+                                 const roaring64_bitmap_t *x2);
+
+/**
+ * Compute the union of 'number' bitmaps: the buckets sharing their high bits
+ * are merged with roaring_bitmap_or_many. Return NULL in case of failure.
+ */
+roaring64_bitmap_t *roaring64_bitmap_or_many(size_t number,
+                                             const roaring64_bitmap_t **x);
+
+/**
+ * Iterate over the bitmap elements, in increasing order. The function
+ * iterator is called once for all the values with ptr (can be NULL) as the
+ * second parameter of each call.
+ */
+void roaring64_iterate(const roaring64_bitmap_t *r,
+                       roaring64_iterator iterator, void *ptr);
+
+/**
+ * Convert the bitmap to an array. Array is allocated with malloc and caller is
+ * responsible for eventually freeing it.
+ */
+uint64_t *roaring64_bitmap_to_uint64_array(const roaring64_bitmap_t *r,
+                                           uint64_t *cardinality);
+
+/**
+ * Return true if the two bitmaps contain the same elements.
+ */
+bool roaring64_bitmap_equals(const roaring64_bitmap_t *r1,
+                             const roaring64_bitmap_t *r2);
+
+/**
+ * Run roaring_bitmap_run_optimize on every bucket. Returns true if the result
+ * has at least one run container.
+ */
+bool roaring64_bitmap_run_optimize(roaring64_bitmap_t *r);
+
+/**
+ * The portable format is the one of the Java (Roaring64NavigableMap) and Go
+ * (roaring64) versions: the number of buckets as a little-endian uint64, then
+ * for each bucket, by increasing high bits, the high bits as a little-endian
+ * uint32 followed by the bucket in the 32-bit portable format.
+ */
+
+/**
+ * How many bytes are required to serialize this bitmap in the portable format
+ */
+size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r);
+
+/**
+ * Write a bitmap to a char buffer in the portable format. Returns how many
+ * bytes were written which should be
+ * roaring64_bitmap_portable_size_in_bytes(r).
+ */
+size_t roaring64_bitmap_portable_serialize(const roaring64_bitmap_t *r,
+                                           char *buf);
+
+/**
+ * Read a bitmap from the portable format. Return NULL if the buffer does not
+ * hold a bitmap or in case of failure.
+ */
+roaring64_bitmap_t *roaring64_bitmap_portable_deserialize(const char *buf);
+
+/* A frozen bitmap is a read-only view of a bitmap in the portable format:
+ * only the directory of the buckets and containers is parsed and allocated,
+ * the containers are read in place. The buffer must outlive the view. Use
+ * roaring64_bitmap_portable_deserialize to get a bitmap that can be
+ * modified. */
+typedef struct roaring64_frozen_s roaring64_frozen_t;
+
+/* Return NULL if the buffer does not hold a bitmap or in case of failure. */
+roaring64_frozen_t *roaring64_frozen_view(const char *buf);
+
+void roaring64_frozen_free(roaring64_frozen_t *f);
+
+bool roaring64_frozen_contains(const roaring64_frozen_t *f, uint64_t x);
+
+uint64_t roaring64_frozen_get_cardinality(const roaring64_frozen_t *f);
+
+/* Number of bytes of the buffer that hold the bitmap. */
+size_t roaring64_frozen_size_in_bytes(const roaring64_frozen_t *f);
+
+void roaring64_frozen_iterate(const roaring64_frozen_t *f,
+                              roaring64_iterator iterator, void *ptr);
+
+#endif /* INCLUDE_ROARING64_H_ */
@@ -18,23 +18,33 @@ enum {
     NO_OFFSET_THRESHOLD = 4
 };
 
+/* Arrays with at least KEY_INDEX_THRESHOLD containers maintain a rank
+ * directory over their keys so that ra_get_index is O(1) rather than a binary
+ * search (the directory uses about 10KB). */
+enum { KEY_INDEX_THRESHOLD = 256 };
+
+typedef struct ra_key_index_s ra_key_index_t;
+
 /**
  * Roaring arrays are array-based key-value pairs having containers as values
  * and 16-bit integer keys. A roaring bitmap  might be implemented as such.
  */
 
 // parallel arrays.  Element sizes quite different.
-// Alternative is array
-// of structs.  Which would have better
-// cache performance through binary searches?
+// An array of structs {key, typecode, container} would stretch each key to
+// 16 bytes and spread binary searches over 8x as many cache lines, so the
+// keys stay dense. The three arrays are however carved out of a single
+// allocation (containers first, then keys, then typecodes): creating,
+// copying and freeing a roaring array costs one malloc/free instead of
+// three, and the arrays stay close together in memory.
 
 typedef struct roaring_array_s {
     int32_t size;
     int32_t allocation_size;
-    uint16_t *keys;
-    void **containers;
-    uint8_t *typecodes;
-    uint8_t *shared; /* for COW, used as a bitset*/
+    uint16_t *keys;       // points inside the block owned by containers
+    void **containers;    // start of the single allocation
+    uint8_t *typecodes;   // points inside the block owned by containers
+    ra_key_index_t *key_index;  // NULL unless size >= KEY_INDEX_THRESHOLD
 } roaring_array_t;
 
 /**
@@ -187,6 +197,18 @@ roaring_array_t *ra_portable_deserialize(const char *buf);
  */
 size_t ra_portable_size_in_bytes(roaring_array_t *ra);
 
+/**
+ * Heap bytes held by the array itself (the struct, the key directory
+ * including unused capacity and the key index), not counting the containers.
+ */
+size_t ra_memory_size_in_bytes(const roaring_array_t *ra);
+
+/**
+ * Reallocate the key directory to its exact size (the containers are left
+ * alone). Return the number of bytes released.
+ */
+size_t ra_shrink_to_fit(roaring_array_t *ra);
+
 /**
  * return true if it contains at least one run container.
  */
@@ -0,0 +1,77 @@
+/*
+ * roaring_bsi.h
+ *
+ */
+
+#ifndef INCLUDE_ROARING_BSI_H_
+#define INCLUDE_ROARING_BSI_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "roaring.h"
+
+/* A bit-sliced index maps columns (uint32_t) to unsigned integer values.
+ * The existence bitmap holds the columns that have a value and slice i holds
+ * the columns whose value has bit i set, so that a comparison with a
+ * constant is a few bitmap operations per bit (O'Neil and Quass). Queries
+ * are evaluated as a roaring_expression_t, one key at a time. */
+typedef struct roaring_bsi_s {
+    roaring_bitmap_t *ebm;
+    roaring_bitmap_t *slices[64];
+    int32_t bit_depth;  // slices[0 .. bit_depth - 1] are allocated
+} roaring_bsi_t;
+
+typedef enum {
+    ROARING_BSI_LT,
+    ROARING_BSI_LE,
+    ROARING_BSI_EQ,
+    ROARING_BSI_GE,
+    ROARING_BSI_GT
+} roaring_bsi_operation_t;
+
+/* Create an empty index. Return NULL in case of failure. */
+roaring_bsi_t *roaring_bsi_create(void);
+
+void roaring_bsi_free(roaring_bsi_t *b);
+
+/* Set the value of a column, replacing its previous value if any. */
+void roaring_bsi_set_value(roaring_bsi_t *b, uint32_t column, uint64_t value);
+
+/* Return false if the column has no value. */
+bool roaring_bsi_get_value(const roaring_bsi_t *b, uint32_t column,
+                           uint64_t *value);
+
+/* Set the values of the columns first_column to first_column + count - 1,
+ * one container at a time, which is much faster than roaring_bsi_set_value.
+ * first_column must be a multiple of 65536 and no column from first_column
+ * on may have a value. Return false otherwise or in case of failure. */
+bool roaring_bsi_append(roaring_bsi_t *b, uint32_t first_column,
+                        const uint64_t *values, uint32_t count);
+
+/* The columns of foundset (all the columns with a value if foundset is NULL)
+ * whose value compares to value as op, eg ROARING_BSI_LT for value[column] <
+ * value. Return NULL in case of failure. */
+roaring_bitmap_t *roaring_bsi_compare(const roaring_bsi_t *b,
+                                      roaring_bsi_operation_t op,
+                                      uint64_t value,
+                                      const roaring_bitmap_t *foundset);
+
+/* The columns of foundset (or all) whose value is between low and high,
+ * inclusive. Return NULL in case of failure. */
+roaring_bitmap_t *roaring_bsi_range(const roaring_bsi_t *b, uint64_t low,
+                                    uint64_t high,
+                                    const roaring_bitmap_t *foundset);
+
+/* The sum (modulo 2^64) of the values of the columns of foundset (or all),
+ * and in *count (if not NULL) how many of them have a value. */
+uint64_t roaring_bsi_sum(const roaring_bsi_t *b,
+                         const roaring_bitmap_t *foundset, uint64_t *count);
+
+/* The k columns of foundset (or all) with the largest values; ties are
+ * broken in favour of the smallest columns. Return NULL in case of failure.
+ */
+roaring_bitmap_t *roaring_bsi_top_k(const roaring_bsi_t *b, uint64_t k,
+                                    const roaring_bitmap_t *foundset);
+
+#endif /* INCLUDE_ROARING_BSI_H_ */
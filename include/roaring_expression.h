@@ -0,0 +1,50 @@
+/*
+ * roaring_expression.h
+ *
+ */
+
+#ifndef INCLUDE_ROARING_EXPRESSION_H_
+#define INCLUDE_ROARING_EXPRESSION_H_
+
+#include <stdint.h>
+
+#include "roaring.h"
+
+/* An expression is a DAG of bitmap operands combined with and, or, xor and
+ * andnot nodes, eg (A | B | C) & ~D & (E | F) is
+ *   andnot(and(or(or(A, B), C), or(E, F)), D).
+ * It is evaluated one 16-bit key at a time: only the containers of that key
+ * are fetched, combined into a few reusable scratch bitsets and the result
+ * container is appended to the answer. No intermediate bitmap is built.
+ *
+ * Nodes are referred to by the index returned when they are added. The
+ * operands of a node must already be in the expression and a node may be
+ * the operand of several others. The bitmaps are not copied: they must
+ * outlive the expression and must not be modified while it is evaluated. */
+typedef struct roaring_expression_s roaring_expression_t;
+
+/* Create an empty expression. Return NULL in case of failure. */
+roaring_expression_t *roaring_expression_create(void);
+
+void roaring_expression_free(roaring_expression_t *e);
+
+/* Add a node and return its index, or -1 in case of failure (allocation
+ * failure, NULL bitmap or unknown operand). */
+int32_t roaring_expression_bitmap(roaring_expression_t *e,
+                                  const roaring_bitmap_t *r);
+int32_t roaring_expression_and(roaring_expression_t *e, int32_t left,
+                               int32_t right);
+int32_t roaring_expression_or(roaring_expression_t *e, int32_t left,
+                              int32_t right);
+int32_t roaring_expression_xor(roaring_expression_t *e, int32_t left,
+                               int32_t right);
+/* left & ~right */
+int32_t roaring_expression_andnot(roaring_expression_t *e, int32_t left,
+                                  int32_t right);
+
+/* Compute the value of the given node as a new bitmap. Return NULL in case
+ * of failure. */
+roaring_bitmap_t *roaring_expression_evaluate(const roaring_expression_t *e,
+                                              int32_t node);
+
+#endif /* INCLUDE_ROARING_EXPRESSION_H_ */
@@ -0,0 +1,49 @@
+/*
+ * roaring_memory.h
+ *
+ */
+
+#ifndef INCLUDE_ROARING_MEMORY_H_
+#define INCLUDE_ROARING_MEMORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Allocation functions used for all the memory the library owns (bitmaps,
+ * key directories, containers and temporaries). Buffers handed over to the
+ * caller (roaring_bitmap_to_uint32_array, roaring_bitmap_serialize) are
+ * still obtained from malloc and must be released with free. */
+typedef struct roaring_memory_s {
+    void *(*malloc)(size_t size);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*calloc)(size_t nmemb, size_t size);
+    void (*free)(void *ptr);
+    void *(*aligned_malloc)(size_t alignment, size_t size);
+    void (*aligned_free)(void *ptr);
+} roaring_memory_t;
+
+/* Install the allocator used by every thread (all fields are required). This
+ * should be done before anything is allocated: memory obtained from the
+ * previous allocator would be released with the new one. The free functions
+ * must accept NULL. Passing NULL restores the C library allocator. */
+void roaring_init_memory_hook(const roaring_memory_t *memory_hook);
+
+/* Install an allocator for the calling thread only, taking precedence over
+ * the global one (eg, a per-query arena). Everything allocated while it is
+ * installed must be released while it is still installed, or not at all (an
+ * arena can drop everything at once). Passing NULL uninstalls it. The
+ * container pool is bypassed while a thread allocator is installed. */
+void roaring_set_thread_memory_hook(const roaring_memory_t *memory_hook);
+
+/* Whether the calling thread has its own allocator installed. */
+bool roaring_has_thread_memory_hook(void);
+
+void *roaring_malloc(size_t size);
+void *roaring_realloc(void *ptr, size_t size);
+void *roaring_calloc(size_t nmemb, size_t size);
+void roaring_free(void *ptr);
+/* alignment must be a power of two, at least sizeof(void *) */
+void *roaring_aligned_malloc(size_t alignment, size_t size);
+void roaring_aligned_free(void *ptr);
+
+#endif /* INCLUDE_ROARING_MEMORY_H_ */
@@ -0,0 +1,109 @@
+/*
+ * roaring_trace.h
+ *
+ */
+
+#ifndef INCLUDE_ROARING_TRACE_H_
+#define INCLUDE_ROARING_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Optional instrumentation, compiled in with -DROARING_TRACE (cmake
+ * -DROARING_TRACE=ON). Each thread counts what the container layer does on
+ * its behalf: the binary kernels it dispatches to, the conversions from one
+ * container type to another, the containers it allocates and frees and the
+ * shared containers it makes writable. Without ROARING_TRACE the hooks below
+ * expand to nothing and the functions of this header are stubs. */
+
+/* the binary container dispatchers of containers/containers.h */
+typedef enum {
+    ROARING_TRACE_AND,       // container_and
+    ROARING_TRACE_IAND,      // container_iand
+    ROARING_TRACE_OR,        // container_or
+    ROARING_TRACE_IOR,       // container_ior
+    ROARING_TRACE_LAZY_OR,   // container_lazy_or
+    ROARING_TRACE_LAZY_IOR,  // container_lazy_ior
+    ROARING_TRACE_EQUALS,    // container_equals
+    ROARING_TRACE_IS_SUBSET, // container_is_subset
+    ROARING_TRACE_NUM_KERNELS
+} roaring_trace_kernel_t;
+
+/* Typecodes index the arrays: 1 for arrays, 2 for runs and 3 for bitsets
+ * (see containers/containers.h), kernel_calls being indexed by
+ * CONTAINER_PAIR(type1, type2) = 4 * type1 + type2. */
+typedef struct roaring_trace_counters_s {
+    uint64_t kernel_calls[ROARING_TRACE_NUM_KERNELS][16];
+    uint64_t conversions[4][4];  // [from][to]
+    uint64_t allocations[4];
+    uint64_t frees[4];
+    uint64_t unshares;  // shared containers made writable (copy on write)
+} roaring_trace_counters_t;
+
+/* Called when a top-level operation (roaring_bitmap_and, ...) returns, with
+ * its name and the time it took. Operations called by another one are not
+ * reported. */
+typedef void (*roaring_trace_callback_t)(const char *operation,
+                                         uint64_t nanoseconds, void *param);
+
+/* Whether the library was compiled with ROARING_TRACE. */
+bool roaring_trace_enabled(void);
+
+/* Copy the counters of the calling thread (all zero without ROARING_TRACE). */
+void roaring_trace_get_counters(roaring_trace_counters_t *counters);
+
+/* Reset the counters of the calling thread. */
+void roaring_trace_reset_counters(void);
+
+/* Install (or, with NULL, remove) the callback for all threads. Not
+ * synchronized with running operations: set it before starting them. Does
+ * nothing without ROARING_TRACE. */
+void roaring_trace_set_callback(roaring_trace_callback_t callback,
+                                void *param);
+
+#ifdef ROARING_TRACE
+
+/* Exported: the hooks are also expanded by the static inline dispatchers of
+ * containers/containers.h, which may be compiled outside of the library. */
+extern _Thread_local roaring_trace_counters_t roaring_trace_thread_counters;
+
+#define ROARING_TRACE_KERNEL(kernel, type1, type2) \
+    (roaring_trace_thread_counters.kernel_calls[kernel][4 * (type1) + (type2)]++)
+#define ROARING_TRACE_CONVERSION(from, to) \
+    (roaring_trace_thread_counters.conversions[from][to]++)
+#define ROARING_TRACE_ALLOCATION(typecode) \
+    (roaring_trace_thread_counters.allocations[typecode]++)
+#define ROARING_TRACE_FREE(typecode) \
+    (roaring_trace_thread_counters.frees[typecode]++)
+#define ROARING_TRACE_UNSHARE() (roaring_trace_thread_counters.unshares++)
+
+typedef struct roaring_trace_timer_s {
+    const char *operation;
+    uint64_t start;  // in nanoseconds, 0 when not reported
+} roaring_trace_timer_t;
+
+void roaring_trace_timer_start(roaring_trace_timer_t *timer,
+                               const char *operation)
+    __attribute__((visibility("hidden")));
+void roaring_trace_timer_stop(roaring_trace_timer_t *timer)
+    __attribute__((visibility("hidden")));
+
+/* First statement of a top-level operation: the callback is invoked when the
+ * enclosing scope is left, whatever the return statement. */
+#define ROARING_TRACE_OPERATION(name)                                   \
+    roaring_trace_timer_t roaring_trace_timer                           \
+        __attribute__((cleanup(roaring_trace_timer_stop)));             \
+    roaring_trace_timer_start(&roaring_trace_timer, name)
+
+#else
+
+#define ROARING_TRACE_KERNEL(kernel, type1, type2) ((void)0)
+#define ROARING_TRACE_CONVERSION(from, to) ((void)0)
+#define ROARING_TRACE_ALLOCATION(typecode) ((void)0)
+#define ROARING_TRACE_FREE(typecode) ((void)0)
+#define ROARING_TRACE_UNSHARE() ((void)0)
+#define ROARING_TRACE_OPERATION(name) ((void)0)
+
+#endif /* ROARING_TRACE */
+
+#endif /* INCLUDE_ROARING_TRACE_H_ */
@@ -372,6 +372,96 @@ int32_t intersect_vector16(const uint16_t *A, size_t s_a, const uint16_t *B,
     return count;
 }
 
+/* Moves to the next block of A and/or B after they were compared. Returns
+ * false once either array has no full block left. */
+static inline bool intersect_vector16_next_block(const uint16_t *A,
+                                                 size_t *i_a, size_t st_a,
+                                                 __m128i *v_a,
+                                                 const uint16_t *B,
+                                                 size_t *i_b, size_t st_b,
+                                                 __m128i *v_b) {
+    const int vectorlength = sizeof(__m128i) / sizeof(uint16_t);
+    const uint16_t a_max = A[*i_a + vectorlength - 1];
+    const uint16_t b_max = B[*i_b + vectorlength - 1];
+    if (a_max <= b_max) {
+        *i_a += vectorlength;
+        if (*i_a == st_a) return false;
+        *v_a = _mm_lddqu_si128((__m128i *)&A[*i_a]);
+    }
+    if (b_max <= a_max) {
+        *i_b += vectorlength;
+        if (*i_b == st_b) return false;
+        *v_b = _mm_lddqu_si128((__m128i *)&B[*i_b]);
+    }
+    return true;
+}
+
+/* Number of values in the intersection of A and B, without writing it out.
+ * When "bounded" is set, stops as soon as k values were found or once fewer
+ * than k can still be found (the count returned is then only meaningful when
+ * compared with k). Same block structure as intersect_vector16. */
+static inline size_t intersect_vector16_count(const uint16_t *A, size_t s_a,
+                                              const uint16_t *B, size_t s_b,
+                                              bool bounded, size_t k) {
+    size_t count = 0;
+    size_t i_a = 0, i_b = 0;
+    const int vectorlength = sizeof(__m128i) / sizeof(uint16_t);
+    const size_t st_a = (s_a / vectorlength) * vectorlength;
+    const size_t st_b = (s_b / vectorlength) * vectorlength;
+    __m128i v_a, v_b;
+    if ((i_a < st_a) && (i_b < st_b)) {
+        v_a = _mm_lddqu_si128((__m128i *)&A[i_a]);
+        v_b = _mm_lddqu_si128((__m128i *)&B[i_b]);
+        bool more = true;
+        // explicit lengths while a block starts with 0
+        while ((A[i_a] == 0) || (B[i_b] == 0)) {
+            const __m128i res_v = _mm_cmpestrm(
+                v_b, vectorlength, v_a, vectorlength,
+                _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+            count += _mm_popcnt_u32(_mm_extract_epi32(res_v, 0));
+            if (bounded && count >= k) return count;
+            more = intersect_vector16_next_block(A, &i_a, st_a, &v_a, B, &i_b,
+                                                 st_b, &v_b);
+            if (!more) break;
+        }
+        while (more) {
+            const __m128i res_v = _mm_cmpistrm(
+                v_b, v_a,
+                _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+            count += _mm_popcnt_u32(_mm_extract_epi32(res_v, 0));
+            if (bounded && count >= k) return count;
+            more = intersect_vector16_next_block(A, &i_a, st_a, &v_a, B, &i_b,
+                                                 st_b, &v_b);
+            // not enough values left on one side to reach k
+            if (bounded && (count + (s_a - i_a) < k || count + (s_b - i_b) < k))
+                return count;
+        }
+    }
+    // intersect the tail using scalar intersection
+    while (i_a < s_a && i_b < s_b) {
+        const uint16_t a = A[i_a], b = B[i_b];
+        if (a == b) {
+            ++count;
+            if (bounded && count >= k) return count;
+        }
+        i_a += (a <= b);
+        i_b += (b <= a);
+    }
+    return count;
+}
+
+int32_t intersect_vector16_cardinality(const uint16_t *A, size_t s_a,
+                                       const uint16_t *B, size_t s_b) {
+    return intersect_vector16_count(A, s_a, B, s_b, false, 0);
+}
+
+bool intersect_vector16_cardinality_at_least(const uint16_t *A, size_t s_a,
+                                             const uint16_t *B, size_t s_b,
+                                             size_t k) {
+    if (s_a < k || s_b < k) return false;
+    return intersect_vector16_count(A, s_a, B, s_b, true, k) >= k;
+}
+
 /* Computes the intersection between one small and one large set of uint16_t.
  * Stores the result into buffer and return the number of elements. */
 int32_t intersect_skewed_uint16(const uint16_t *small, size_t size_s,
@@ -408,6 +498,20 @@ int32_t intersect_skewed_uint16(const uint16_t *small, size_t size_s,
     return pos;
 }
 
+int32_t intersect_skewed_uint16_cardinality(const uint16_t *small,
+                                            size_t size_s,
+                                            const uint16_t *large,
+                                            size_t size_l) {
+    int32_t pos = 0;
+    int32_t idx_l = 0;
+    for (size_t idx_s = 0; idx_s < size_s; ++idx_s) {
+        idx_l = advanceUntil(large, idx_l - 1, size_l, small[idx_s]);
+        if (idx_l == (int32_t)size_l) break;
+        pos += (large[idx_l] == small[idx_s]);
+    }
+    return pos;
+}
+
 /**
  * Generic intersection function. Passes unit tests.
  */
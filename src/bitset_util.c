@@ -889,3 +889,33 @@ void bitset_reset_range(uint64_t *bitmap, uint32_t start, uint32_t end) {
     for (uint32_t i = firstword + 1; i < endword; i++) bitmap[i] = UINT64_C(0);
     bitmap[endword] &= ~((~UINT64_C(0)) >> ((-end) % 64));
 }
+
+bool bitset_range_all_set(const uint64_t *bitmap, uint32_t start,
+                          uint32_t end) {
+    if (start == end) return true;
+    uint32_t firstword = start / 64;
+    uint32_t endword = (end - 1) / 64;
+    const uint64_t firstmask = (~UINT64_C(0)) << (start % 64);
+    const uint64_t endmask = (~UINT64_C(0)) >> ((-end) % 64);
+    if (firstword == endword)
+        return (~bitmap[firstword] & firstmask & endmask) == 0;
+    if ((~bitmap[firstword] & firstmask) != 0) return false;
+    for (uint32_t i = firstword + 1; i < endword; i++)
+        if (bitmap[i] != ~UINT64_C(0)) return false;
+    return (~bitmap[endword] & endmask) == 0;
+}
+
+bool bitset_range_none_set(const uint64_t *bitmap, uint32_t start,
+                           uint32_t end) {
+    if (start == end) return true;
+    uint32_t firstword = start / 64;
+    uint32_t endword = (end - 1) / 64;
+    const uint64_t firstmask = (~UINT64_C(0)) << (start % 64);
+    const uint64_t endmask = (~UINT64_C(0)) >> ((-end) % 64);
+    if (firstword == endword)
+        return (bitmap[firstword] & firstmask & endmask) == 0;
+    if ((bitmap[firstword] & firstmask) != 0) return false;
+    for (uint32_t i = firstword + 1; i < endword; i++)
+        if (bitmap[i] != 0) return false;
+    return (bitmap[endword] & endmask) == 0;
+}
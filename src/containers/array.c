@@ -11,8 +11,11 @@
 
 #include "array_util.h"
 #include "containers/array.h"
+#include "containers/containers.h"
+#include "containers/pool.h"
+#include "roaring_memory.h"
 
-enum { DEFAULT_INIT_SIZE = 16 };
+enum { ARRAY_DEFAULT_INIT_SIZE = 16 };
 
 extern int array_container_cardinality(const array_container_t *array);
 extern bool array_container_nonzero_cardinality(const array_container_t *array);
@@ -25,24 +28,25 @@ extern bool array_container_full(const array_container_t *array);
 array_container_t *array_container_create_given_capacity(int32_t size) {
     array_container_t *container;
 
-    if ((container = malloc(sizeof(array_container_t))) == NULL) {
+    if ((container = roaring_malloc(sizeof(array_container_t))) == NULL) {
         return NULL;
     }
 
-    if ((container->array = malloc(sizeof(uint16_t) * size)) == NULL) {
-        free(container);
+    if ((container->array = pool_array_payload_get(size)) == NULL) {
+        roaring_free(container);
         return NULL;
     }
 
     container->capacity = size;
     container->cardinality = 0;
+    ROARING_TRACE_ALLOCATION(ARRAY_CONTAINER_TYPE_CODE);
 
     return container;
 }
 
 /* Create a new array. Return NULL in case of failure. */
 array_container_t *array_container_create() {
-    return array_container_create_given_capacity(DEFAULT_INIT_SIZE);
+    return array_container_create_given_capacity(ARRAY_DEFAULT_INIT_SIZE);
 }
 
 /* Duplicate container */
@@ -60,13 +64,14 @@ array_container_t *array_container_clone(const array_container_t *src) {
 
 /* Free memory. */
 void array_container_free(array_container_t *arr) {
-    free(arr->array);
+    ROARING_TRACE_FREE(ARRAY_CONTAINER_TYPE_CODE);
+    pool_array_payload_put(arr->array, arr->capacity);
     arr->array = NULL;
-    free(arr);
+    roaring_free(arr);
 }
 
 static inline int32_t grow_capacity(int32_t capacity) {
-    return (capacity <= 0) ? DEFAULT_INIT_SIZE
+    return (capacity <= 0) ? ARRAY_DEFAULT_INIT_SIZE
                            : capacity < 64 ? capacity * 2
                                            : capacity < 1024 ? capacity * 3 / 2
                                                              : capacity * 5 / 4;
@@ -92,21 +97,35 @@ void array_container_grow(array_container_t *container, int32_t min,
     // if we are within 1/16th of the max, go to max
     if (new_capacity > max - max / 16) new_capacity = max;
 
+    const int32_t old_capacity = container->capacity;
     container->capacity = new_capacity;
     uint16_t *array = container->array;
 
     if (preserve) {
-        container->array = realloc(array, new_capacity * sizeof(uint16_t));
-        if (container->array == NULL) free(array);
+        container->array = roaring_realloc(array, new_capacity * sizeof(uint16_t));
+        if (container->array == NULL) roaring_free(array);
     } else {
-        free(array);
-        container->array = malloc(new_capacity * sizeof(uint16_t));
+        pool_array_payload_put(array, old_capacity);
+        container->array = pool_array_payload_get(new_capacity);
     }
 
     // TODO: handle the case where realloc fails
     assert(container->array != NULL);
 }
 
+int32_t array_container_shrink_to_fit(array_container_t *container) {
+    const int32_t cardinality = container->cardinality;
+    if (cardinality == 0 || cardinality == container->capacity) return 0;
+    uint16_t *array =
+        roaring_realloc(container->array, cardinality * sizeof(uint16_t));
+    if (array == NULL) return 0;  // the original allocation is still valid
+    const int32_t saved =
+        (container->capacity - cardinality) * (int32_t)sizeof(uint16_t);
+    container->array = array;
+    container->capacity = cardinality;
+    return saved;
+}
+
 /* Copy one container into another. We assume that they are distinct. */
 void array_container_copy(const array_container_t *src,
                           array_container_t *dst) {
@@ -169,7 +188,7 @@ bool array_container_remove(array_container_t *arr, uint16_t pos) {
     const bool is_present = idx >= 0;
     if (is_present) {
         memmove(arr->array + idx, arr->array + idx + 1,
-                (arr->cardinality - idx) * sizeof(uint16_t));
+                (arr->cardinality - idx - 1) * sizeof(uint16_t));
         arr->cardinality--;
     }
 
@@ -181,6 +200,11 @@ bool array_container_contains(const array_container_t *arr, uint16_t pos) {
     return binarySearch(arr->array, arr->cardinality, pos) >= 0;
 }
 
+int array_container_rank(const array_container_t *arr, uint16_t x) {
+    const int32_t idx = binarySearch(arr->array, arr->cardinality, x);
+    return idx >= 0 ? idx + 1 : -idx - 1;
+}
+
 /* Computes the union of array1 and array2 and write the result to arrayout.
  * It is assumed that arrayout is distinct from both array1 and array2.
  */
@@ -203,7 +227,7 @@ void array_container_union(const array_container_t *array_1,
     }
 }
 
-static inline int32_t minimum(int32_t a, int32_t b) { return (a < b) ? a : b; }
+static inline int32_t minimum_int32(int32_t a, int32_t b) { return (a < b) ? a : b; }
 
 /* computes the intersection of array1 and array2 and write the result to
  * arrayout.
@@ -213,7 +237,7 @@ void array_container_intersection(const array_container_t *array1,
                                   const array_container_t *array2,
                                   array_container_t *out) {
     int32_t card_1 = array1->cardinality, card_2 = array2->cardinality,
-            min_card = minimum(card_1, card_2);
+            min_card = minimum_int32(card_1, card_2);
     const int threshold = 64;  // subject to tuning
 #ifdef USEAVX
     min_card += sizeof(__m128i) / sizeof(uint16_t);
@@ -237,6 +261,32 @@ void array_container_intersection(const array_container_t *array1,
     }
 }
 
+int array_container_intersection_cardinality(const array_container_t *array1,
+                                             const array_container_t *array2) {
+    int32_t card_1 = array1->cardinality, card_2 = array2->cardinality;
+    const int threshold = 64;  // subject to tuning
+    if (card_1 * threshold < card_2) {
+        return intersect_skewed_uint16_cardinality(array1->array, card_1,
+                                                   array2->array, card_2);
+    } else if (card_2 * threshold < card_1) {
+        return intersect_skewed_uint16_cardinality(array2->array, card_2,
+                                                   array1->array, card_1);
+    }
+    return intersect_vector16_cardinality(array1->array, card_1,
+                                          array2->array, card_2);
+}
+
+bool array_container_intersection_cardinality_at_least(
+    const array_container_t *array1, const array_container_t *array2, int k) {
+    int32_t card_1 = array1->cardinality, card_2 = array2->cardinality;
+    const int threshold = 64;  // subject to tuning
+    if (card_1 * threshold < card_2 || card_2 * threshold < card_1) {
+        return array_container_intersection_cardinality(array1, array2) >= k;
+    }
+    return intersect_vector16_cardinality_at_least(
+        array1->array, card_1, array2->array, card_2, k < 0 ? 0 : k);
+}
+
 /* computes the intersection of array1 and array2 and write the result to
  * array1.
  * */
@@ -267,6 +317,16 @@ int array_container_to_uint32_array(uint32_t *out,
     return outpos;
 }
 
+int array_container_range_to_uint32_array(uint32_t *out,
+                                          const array_container_t *cont,
+                                          uint32_t base, int32_t offset,
+                                          int32_t limit) {
+    if (offset >= cont->cardinality) return 0;
+    if (limit > cont->cardinality - offset) limit = cont->cardinality - offset;
+    for (int32_t i = 0; i < limit; ++i) out[i] = base + cont->array[offset + i];
+    return limit;
+}
+
 void array_container_printf(const array_container_t *v) {
     if (v->cardinality == 0) {
         printf("{}");
@@ -347,6 +407,22 @@ bool array_container_equals(array_container_t *container1,
     return true;
 }
 
+bool array_container_is_subset(const array_container_t *container1,
+                               const array_container_t *container2) {
+    const int32_t card1 = container1->cardinality;
+    const int32_t card2 = container2->cardinality;
+    if (card1 > card2) return false;
+    int32_t pos = 0;
+    for (int32_t i = 0; i < card1; ++i) {
+        const uint16_t v = container1->array[i];
+        if (pos < card2 && container2->array[pos] < v)  // gallop
+            pos = advanceUntil(container2->array, pos, card2, v);
+        if (pos >= card2 || container2->array[pos] != v) return false;
+        ++pos;
+    }
+    return true;
+}
+
 int32_t array_container_read(int32_t cardinality, array_container_t *container,
                              const char *buf) {
     if (container->capacity < cardinality) {
@@ -373,7 +449,7 @@ void *array_container_deserialize(const char *buf, size_t buf_len) {
     else
         buf_len -= 2;
 
-    if ((ptr = malloc(sizeof(array_container_t))) != NULL) {
+    if ((ptr = roaring_malloc(sizeof(array_container_t))) != NULL) {
         size_t len;
         int32_t off;
         uint16_t cardinality;
@@ -384,12 +460,12 @@ void *array_container_deserialize(const char *buf, size_t buf_len) {
         len = sizeof(uint16_t) * ptr->cardinality;
 
         if (len != buf_len) {
-            free(ptr);
+            roaring_free(ptr);
             return (NULL);
         }
 
-        if ((ptr->array = malloc(sizeof(uint16_t) * ptr->capacity)) == NULL) {
-            free(ptr);
+        if ((ptr->array = roaring_malloc(sizeof(uint16_t) * ptr->capacity)) == NULL) {
+            roaring_free(ptr);
             return (NULL);
         }
 
@@ -398,12 +474,13 @@ void *array_container_deserialize(const char *buf, size_t buf_len) {
         /* Check if returned values are monotonically increasing */
         for (int32_t i = 0, j = 0; i < ptr->cardinality; i++) {
             if (ptr->array[i] < j) {
-                free(ptr->array);
-                free(ptr);
+                roaring_free(ptr->array);
+                roaring_free(ptr);
                 return (NULL);
             } else
                 j = ptr->array[i];
         }
+        ROARING_TRACE_ALLOCATION(ARRAY_CONTAINER_TYPE_CODE);
     }
 
     return (ptr);
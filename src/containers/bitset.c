@@ -10,6 +10,9 @@
 
 #include "bitset_util.h"
 #include "containers/bitset.h"
+#include "containers/containers.h"
+#include "containers/pool.h"
+#include "roaring_memory.h"
 #include "utilasm.h"
 
 extern int bitset_container_cardinality(const bitset_container_t *bitset);
@@ -38,19 +41,19 @@ void bitset_container_set_all(bitset_container_t *bitset) {
 
 /* Create a new bitset. Return NULL in case of failure. */
 bitset_container_t *bitset_container_create(void) {
-    bitset_container_t *bitset = calloc(1, sizeof(bitset_container_t));
+    bitset_container_t *bitset = roaring_calloc(1, sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
     }
 
-    if (posix_memalign((void *)&bitset->array, sizeof(__m256i),
-                       sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS)) {
-        free(bitset);
+    if ((bitset->array = pool_bitset_words_get()) == NULL) {
+        roaring_free(bitset);
         return NULL;
     }
 
     bitset_container_clear(bitset);
+    ROARING_TRACE_ALLOCATION(BITSET_CONTAINER_TYPE_CODE);
     return bitset;
 }
 
@@ -91,27 +94,28 @@ void bitset_container_add_from_range(bitset_container_t *bitset, uint32_t min, u
 
 /* Free memory. */
 void bitset_container_free(bitset_container_t *bitset) {
-    free(bitset->array);
+    ROARING_TRACE_FREE(BITSET_CONTAINER_TYPE_CODE);
+    pool_bitset_words_put(bitset->array);
     bitset->array = NULL;
-    free(bitset);
+    roaring_free(bitset);
 }
 
 /* duplicate container. */
 bitset_container_t *bitset_container_clone(const bitset_container_t *src) {
-    bitset_container_t *bitset = calloc(1, sizeof(bitset_container_t));
+    bitset_container_t *bitset = roaring_calloc(1, sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
     }
 
-    if (posix_memalign((void *)&bitset->array, sizeof(__m256i),
-                       sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS)) {
-        free(bitset);
+    if ((bitset->array = pool_bitset_words_get()) == NULL) {
+        roaring_free(bitset);
         return NULL;
     }
     bitset->cardinality = src->cardinality;
     memcpy(bitset->array, src->array,
            sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+    ROARING_TRACE_ALLOCATION(BITSET_CONTAINER_TYPE_CODE);
     return bitset;
 }
 
@@ -122,6 +126,22 @@ void bitset_container_set_range(bitset_container_t *bitset, uint32_t begin,
         bitset_container_compute_cardinality(bitset);  // could be smarter
 }
 
+uint16_t bitset_container_minimum(const bitset_container_t *bitset) {
+    for (int32_t i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS; ++i) {
+        const uint64_t w = bitset->array[i];
+        if (w != 0) return i * 64 + __builtin_ctzll(w);
+    }
+    return 0;
+}
+
+uint16_t bitset_container_maximum(const bitset_container_t *bitset) {
+    for (int32_t i = BITSET_CONTAINER_SIZE_IN_WORDS - 1; i >= 0; --i) {
+        const uint64_t w = bitset->array[i];
+        if (w != 0) return i * 64 + 63 - __builtin_clzll(w);
+    }
+    return 0;
+}
+
 //#define USEPOPCNT // when this is disabled
 // bitset_container_compute_cardinality uses AVX to compute hamming weight
 
@@ -463,6 +483,34 @@ int bitset_container_to_uint32_array( uint32_t *out, const bitset_container_t *c
 #endif
 }
 
+int bitset_container_range_to_uint32_array(uint32_t *out,
+                                           const bitset_container_t *cont,
+                                           uint32_t base, int32_t offset,
+                                           int32_t limit) {
+    int32_t i = 0;
+    uint64_t w = 0;
+    // skip whole words, then the first bits of the word holding offset
+    for (; i < BITSET_CONTAINER_SIZE_IN_WORDS; ++i) {
+        w = cont->array[i];
+        const int32_t count = __builtin_popcountll(w);
+        if (count > offset) break;
+        offset -= count;
+    }
+    if (i == BITSET_CONTAINER_SIZE_IN_WORDS) return 0;
+    for (; offset > 0; --offset) w &= w - 1;
+    int32_t outpos = 0;
+    while (outpos < limit && i < BITSET_CONTAINER_SIZE_IN_WORDS) {
+        if (w == 0) {
+            if (++i == BITSET_CONTAINER_SIZE_IN_WORDS) break;
+            w = cont->array[i];
+            continue;
+        }
+        out[outpos++] = base + i * 64 + __builtin_ctzll(w);
+        w &= w - 1;
+    }
+    return outpos;
+}
+
 /*
  * Print this container using printf (useful for debugging).
  */
@@ -512,8 +560,18 @@ void bitset_container_printf_as_uint32_array(const bitset_container_t * v, uint3
 }
 
 
+int bitset_container_rank(const bitset_container_t *bitset, uint16_t x) {
+    const int32_t last = x / 64;
+    int sum = 0;
+    for (int32_t i = 0; i < last; ++i)
+        sum += __builtin_popcountll(bitset->array[i]);
+    // the low x % 64 + 1 bits, all of them when 2 << 63 wraps to 0
+    const uint64_t mask = (UINT64_C(2) << (x % 64)) - 1;
+    return sum + __builtin_popcountll(bitset->array[last] & mask);
+}
+
 // TODO: use the fast lower bound, also
-int bitset_container_number_of_runs(bitset_container_t *b) {
+int bitset_container_number_of_runs(const bitset_container_t *b) {
   int num_runs = 0;
   uint64_t next_word = b->array[0];
 
@@ -574,16 +632,17 @@ void* bitset_container_deserialize(const char *buf, size_t buf_len) {
   if(l != buf_len)
     return(NULL);
 
-  if((ptr = (bitset_container_t *)malloc(sizeof(bitset_container_t))) != NULL) {
+  if((ptr = (bitset_container_t *)roaring_malloc(sizeof(bitset_container_t))) != NULL) {
     memcpy(ptr, buf, sizeof(bitset_container_t));
 
-    if(posix_memalign((void *)&ptr->array, sizeof(__m256i), l)) {
-      free(ptr);
+    if((ptr->array = pool_bitset_words_get()) == NULL) {
+      roaring_free(ptr);
       return(NULL);
     }
 
     memcpy(ptr->array, buf, l);
     ptr->cardinality = bitset_container_compute_cardinality(ptr);
+    ROARING_TRACE_ALLOCATION(BITSET_CONTAINER_TYPE_CODE);
   }
 
   return((void*)ptr);
@@ -616,3 +675,14 @@ bool bitset_container_equals(bitset_container_t *container1, bitset_container_t
 	}
 	return true;
 }
+
+bool bitset_container_is_subset(const bitset_container_t *container1,
+                                const bitset_container_t *container2) {
+    if (container1->cardinality != BITSET_UNKNOWN_CARDINALITY &&
+        container2->cardinality != BITSET_UNKNOWN_CARDINALITY &&
+        container1->cardinality > container2->cardinality)
+        return false;
+    for (int32_t i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS; ++i)
+        if ((container1->array[i] & ~container2->array[i]) != 0) return false;
+    return true;
+}
@@ -135,7 +135,7 @@ void *get_copy_of_container(void * container, uint8_t * typecode, bool copy_on_w
 	}
 	assert(*typecode != SHARED_CONTAINER_TYPE_CODE);
 
-    if ((shared_container = malloc(sizeof(shared_container_t))) == NULL) {
+    if ((shared_container = roaring_malloc(sizeof(shared_container_t))) == NULL) {
         return NULL;
     }
 
@@ -186,7 +186,7 @@ void * shared_container_extract_copy (shared_container_t * container, uint8_t *
 	if(container->counter == 0) {
                 answer = container->container;
 		container->container = NULL; // paranoid
-		free(container);
+		roaring_free(container);
 	} else {
                 answer = container_clone(container->container, *typecode);
         }
@@ -201,7 +201,7 @@ void shared_container_free (shared_container_t * container) {
 		assert(container->typecode != SHARED_CONTAINER_TYPE_CODE);
 		container_free(container->container,container->typecode);
 		container->container = NULL; // paranoid
-		free(container);
+		roaring_free(container);
 	}
 }
 
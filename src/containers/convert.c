@@ -8,6 +8,8 @@
 // file contains grubby stuff that must know impl. details of all container
 // types.
 bitset_container_t *bitset_container_from_array(const array_container_t *a) {
+    ROARING_TRACE_CONVERSION(ARRAY_CONTAINER_TYPE_CODE,
+                             BITSET_CONTAINER_TYPE_CODE);
     bitset_container_t *ans = bitset_container_create();
     int limit = array_container_cardinality(a);
     for (int i = 0; i < limit; ++i) bitset_container_set(ans, a->array[i]);
@@ -15,6 +17,8 @@ bitset_container_t *bitset_container_from_array(const array_container_t *a) {
 }
 
 bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
+    ROARING_TRACE_CONVERSION(RUN_CONTAINER_TYPE_CODE,
+                             BITSET_CONTAINER_TYPE_CODE);
     int card = run_container_cardinality(arr);
     bitset_container_t *answer = bitset_container_create();
     for (int rlepos = 0; rlepos < arr->n_runs; ++rlepos) {
@@ -26,6 +30,8 @@ bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_run(const run_container_t *arr) {
+    ROARING_TRACE_CONVERSION(RUN_CONTAINER_TYPE_CODE,
+                             ARRAY_CONTAINER_TYPE_CODE);
     array_container_t *answer =
         array_container_create_given_capacity(run_container_cardinality(arr));
     answer->cardinality = 0;
@@ -41,6 +47,8 @@ array_container_t *array_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_bitset(const bitset_container_t *bits) {
+    ROARING_TRACE_CONVERSION(BITSET_CONTAINER_TYPE_CODE,
+                             ARRAY_CONTAINER_TYPE_CODE);
     array_container_t *result =
         array_container_create_given_capacity(bits->cardinality);
     result->cardinality = bits->cardinality;
@@ -60,6 +68,8 @@ static void add_run(run_container_t *r, int s, int e) {
 }
 
 run_container_t *run_container_from_array(const array_container_t *c) {
+    ROARING_TRACE_CONVERSION(ARRAY_CONTAINER_TYPE_CODE,
+                             RUN_CONTAINER_TYPE_CODE);
     int32_t n_runs = array_container_number_of_runs(c);
     run_container_t *answer = run_container_create_given_capacity(n_runs);
     int prev = -2;
@@ -89,6 +99,10 @@ run_container_t *run_container_from_array(const array_container_t *c) {
 
 void *convert_to_bitset_or_array_container(run_container_t *r, int32_t card,
                                            uint8_t *resulttype) {
+    ROARING_TRACE_CONVERSION(RUN_CONTAINER_TYPE_CODE,
+                             card <= DEFAULT_MAX_SIZE
+                                 ? ARRAY_CONTAINER_TYPE_CODE
+                                 : BITSET_CONTAINER_TYPE_CODE);
     if (card <= DEFAULT_MAX_SIZE) {
         array_container_t *answer = array_container_create_given_capacity(card);
         answer->cardinality = 0;
@@ -140,6 +154,10 @@ void *convert_run_to_efficient_container(run_container_t *c,
         *typecode_after = RUN_CONTAINER_TYPE_CODE;
         return c;
     }
+    ROARING_TRACE_CONVERSION(RUN_CONTAINER_TYPE_CODE,
+                             card <= DEFAULT_MAX_SIZE
+                                 ? ARRAY_CONTAINER_TYPE_CODE
+                                 : BITSET_CONTAINER_TYPE_CODE);
     if (card <= DEFAULT_MAX_SIZE) {
         // to array
         array_container_t *answer = array_container_create_given_capacity(card);
@@ -179,21 +197,24 @@ void *convert_run_to_efficient_container_and_free(run_container_t *c,
 /* once converted, the original container is disposed here, rather than
    in roaring_array
 */
+void *convert_run_optimize(void *c, uint8_t typecode_original,
+                           uint8_t *typecode_after) {
+    void *newc = convert_run_optimize_copy(c, typecode_original, typecode_after);
+    if (newc != c) container_free(c, typecode_original);
+    return newc;
+}
 
 // TODO: split into run-  array-  and bitset-  subfunctions for sanity;
 // a few function calls won't really matter.
 
-void *convert_run_optimize(void *c, uint8_t typecode_original,
-                           uint8_t *typecode_after) {
+void *convert_run_optimize_copy(const void *c, uint8_t typecode_original,
+                                uint8_t *typecode_after) {
     if (typecode_original == RUN_CONTAINER_TYPE_CODE) {
-        void *newc = convert_run_to_efficient_container(c, typecode_after);
-        if (newc != c) {
-            container_free(c, typecode_original);
-        }
-        return newc;
+        return convert_run_to_efficient_container((run_container_t *)c,
+                                                  typecode_after);
     } else if (typecode_original == ARRAY_CONTAINER_TYPE_CODE) {
         // it might need to be converted to a run container.
-        array_container_t *c_qua_array = (array_container_t *)c;
+        const array_container_t *c_qua_array = (const array_container_t *)c;
         int32_t n_runs = array_container_number_of_runs(c);
         int32_t size_as_run_container =
             run_container_serialized_size_in_bytes(n_runs);
@@ -204,9 +225,11 @@ void *convert_run_optimize(void *c, uint8_t typecode_original,
         if (RUN_OPTI_MINIMAL_GAIN * size_as_run_container >=
             size_as_array_container) {
             *typecode_after = ARRAY_CONTAINER_TYPE_CODE;
-            return c;
+            return (void *)c;
         }
         // else convert array to run container
+        ROARING_TRACE_CONVERSION(ARRAY_CONTAINER_TYPE_CODE,
+                                 RUN_CONTAINER_TYPE_CODE);
         run_container_t *answer = run_container_create_given_capacity(n_runs);
         int prev = -2;
         int run_start = -1;
@@ -225,11 +248,10 @@ void *convert_run_optimize(void *c, uint8_t typecode_original,
         // now prev is the last seen value
         add_run(answer, run_start, prev);
         *typecode_after = RUN_CONTAINER_TYPE_CODE;
-        array_container_free(c);
         return answer;
     } else if (typecode_original == BITSET_CONTAINER_TYPE_CODE) {  // run conversions on bitset
         // does bitset need conversion to run?
-        bitset_container_t *c_qua_bitset = (bitset_container_t *)c;
+        const bitset_container_t *c_qua_bitset = (const bitset_container_t *)c;
         int32_t n_runs = bitset_container_number_of_runs(c_qua_bitset);
         int32_t size_as_run_container =
             run_container_serialized_size_in_bytes(n_runs);
@@ -240,11 +262,13 @@ void *convert_run_optimize(void *c, uint8_t typecode_original,
             RUN_OPTI_MINIMAL_GAIN * size_as_run_container) {
             // no conversion needed.
             *typecode_after = BITSET_CONTAINER_TYPE_CODE;
-            return c;
+            return (void *)c;
         }
         // bitset to runcontainer (ported from Java  RunContainer(
         // BitmapContainer bc, int nbrRuns))
         assert(n_runs > 0);  // no empty bitmaps
+        ROARING_TRACE_CONVERSION(BITSET_CONTAINER_TYPE_CODE,
+                                 RUN_CONTAINER_TYPE_CODE);
         run_container_t *answer = run_container_create_given_capacity(n_runs);
 
         int long_ctr = 0;
@@ -256,7 +280,6 @@ void *convert_run_optimize(void *c, uint8_t typecode_original,
                 cur_word = c_qua_bitset->array[++long_ctr];
 
             if (cur_word == UINT64_C(0)) {
-                bitset_container_free(c);
                 *typecode_after = RUN_CONTAINER_TYPE_CODE;
                 return answer;
             }
@@ -273,7 +296,6 @@ void *convert_run_optimize(void *c, uint8_t typecode_original,
             if (cur_word_with_1s == UINT64_C(-1)) {
                 run_end = 64 + long_ctr * 64;  // exclusive, I guess
                 add_run(answer, run_start, run_end - 1);
-                bitset_container_free(c);
                 *typecode_after = RUN_CONTAINER_TYPE_CODE;
                 return answer;
             }
@@ -6,7 +6,9 @@
 #include "containers/mixed_intersection.h"
 #include "array_util.h"
 #include "bitset_util.h"
+#include "containers/containers.h"
 #include "containers/convert.h"
+#include "containers/perfparameters.h"
 
 /* Compute the intersection of src_1 and src_2 and write the result to
  * dst.  */
@@ -37,12 +39,26 @@ void array_run_container_intersection(const array_container_t *src_1,
     if (dst->capacity < src_1->cardinality)
         array_container_grow(dst, src_1->cardinality, INT32_MAX, false);
     if (src_2->n_runs == 0) {
+        dst->cardinality = 0;
         return;
     }
     int32_t rlepos = 0;
     int32_t arraypos = 0;
-    rle16_t rle = src_2->runs[rlepos];
     int32_t newcard = 0;
+    if (src_2->n_runs > src_1->cardinality * RUN_GALLOP_RATIO) {
+        // few values, many runs: gallop to the run that could hold each value
+        for (; arraypos < src_1->cardinality; ++arraypos) {
+            const uint16_t arrayval = src_1->array[arraypos];
+            rlepos = rle16_advance_until(src_2->runs, rlepos - 1,
+                                         src_2->n_runs, arrayval);
+            if (rlepos == src_2->n_runs) break;
+            if (src_2->runs[rlepos].value <= arrayval)
+                dst->array[newcard++] = arrayval;
+        }
+        dst->cardinality = newcard;
+        return;
+    }
+    rle16_t rle = src_2->runs[rlepos];
     while (arraypos < src_1->cardinality) {
         const uint16_t arrayval = src_1->array[arraypos];
         while (rle.value + rle.length <
@@ -169,6 +185,8 @@ bool bitset_bitset_container_intersection(const bitset_container_t *src_1,
         }
         return true;  // it is a bitset
     }
+    ROARING_TRACE_CONVERSION(BITSET_CONTAINER_TYPE_CODE,
+                             ARRAY_CONTAINER_TYPE_CODE);
     *dst = array_container_create_given_capacity(newCardinality);
     if (*dst != NULL) {
         ((array_container_t *)*dst)->cardinality = newCardinality;
@@ -190,6 +208,8 @@ bool bitset_bitset_container_intersection_inplace(
         ((bitset_container_t *)*dst)->cardinality = newCardinality;
         return true;  // it is a bitset
     }
+    ROARING_TRACE_CONVERSION(BITSET_CONTAINER_TYPE_CODE,
+                             ARRAY_CONTAINER_TYPE_CODE);
     *dst = array_container_create_given_capacity(newCardinality);
     if (*dst != NULL) {
         ((array_container_t *)*dst)->cardinality = newCardinality;
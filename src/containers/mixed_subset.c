@@ -0,0 +1,145 @@
+/*
+ * mixed_subset.c
+ *
+ */
+
+#include "containers/mixed_subset.h"
+#include "containers/containers.h"
+#include "array_util.h"
+#include "bitset_util.h"
+
+bool array_container_is_subset_bitset(const array_container_t* container1,
+                                      const bitset_container_t* container2) {
+    if (container2->cardinality != BITSET_UNKNOWN_CARDINALITY &&
+        container1->cardinality > container2->cardinality)
+        return false;
+    for (int32_t i = 0; i < container1->cardinality; ++i)
+        if (!bitset_container_contains(container2, container1->array[i]))
+            return false;
+    return true;
+}
+
+bool array_container_is_subset_run(const array_container_t* container1,
+                                   const run_container_t* container2) {
+    int32_t j = 0;
+    for (int32_t i = 0; i < container1->cardinality; ++i) {
+        const uint32_t v = container1->array[i];
+        while (j < container2->n_runs &&
+               (uint32_t)container2->runs[j].value +
+                       container2->runs[j].length <
+                   v)
+            ++j;
+        if (j == container2->n_runs || container2->runs[j].value > v)
+            return false;
+    }
+    return true;
+}
+
+bool bitset_container_is_subset_array(const bitset_container_t* container1,
+                                      const array_container_t* container2) {
+    if (container1->cardinality != BITSET_UNKNOWN_CARDINALITY &&
+        container1->cardinality > container2->cardinality)
+        return false;
+    int32_t pos = 0;
+    for (int32_t i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS; ++i) {
+        for (uint64_t w = container1->array[i]; w != 0; w &= w - 1) {
+            const uint16_t v = i * 64 + __builtin_ctzll(w);
+            if (pos < container2->cardinality && container2->array[pos] < v)
+                pos = advanceUntil(container2->array, pos,
+                                   container2->cardinality, v);
+            if (pos >= container2->cardinality || container2->array[pos] != v)
+                return false;
+            ++pos;
+        }
+    }
+    return true;
+}
+
+/* no value in the gaps between the runs */
+bool bitset_container_is_subset_run(const bitset_container_t* container1,
+                                    const run_container_t* container2) {
+    uint32_t gap_start = 0;
+    for (int32_t j = 0; j < container2->n_runs; ++j) {
+        const uint32_t start = container2->runs[j].value;
+        if (!bitset_range_none_set(container1->array, gap_start, start))
+            return false;
+        gap_start = start + container2->runs[j].length + 1;
+    }
+    return bitset_range_none_set(container1->array, gap_start, 1 << 16);
+}
+
+bool run_container_is_subset_array(const run_container_t* container1,
+                                   const array_container_t* container2) {
+    // the array holds start..end if it holds start and, length positions
+    // later, end
+    int32_t pos = -1;
+    for (int32_t i = 0; i < container1->n_runs; ++i) {
+        const uint16_t start = container1->runs[i].value;
+        const int32_t length = container1->runs[i].length;
+        pos = advanceUntil(container2->array, pos, container2->cardinality,
+                           start);
+        if (pos + length >= container2->cardinality ||
+            container2->array[pos] != start ||
+            container2->array[pos + length] != start + length)
+            return false;
+        pos += length;
+    }
+    return true;
+}
+
+bool run_container_is_subset_bitset(const run_container_t* container1,
+                                    const bitset_container_t* container2) {
+    for (int32_t i = 0; i < container1->n_runs; ++i) {
+        const uint32_t start = container1->runs[i].value;
+        if (!bitset_range_all_set(container2->array, start,
+                                  start + container1->runs[i].length + 1))
+            return false;
+    }
+    return true;
+}
+
+bool container_is_subset(const void* c1, uint8_t type1, const void* c2,
+                         uint8_t type2) {
+    c1 = container_unwrap_shared(c1, &type1);
+    c2 = container_unwrap_shared(c2, &type2);
+    ROARING_TRACE_KERNEL(ROARING_TRACE_IS_SUBSET, type1, type2);
+    switch (CONTAINER_PAIR(type1, type2)) {
+        case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
+                            BITSET_CONTAINER_TYPE_CODE):
+            return bitset_container_is_subset((bitset_container_t*)c1,
+                                              (bitset_container_t*)c2);
+        case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
+                            RUN_CONTAINER_TYPE_CODE):
+            return bitset_container_is_subset_run((bitset_container_t*)c1,
+                                                  (run_container_t*)c2);
+        case CONTAINER_PAIR(RUN_CONTAINER_TYPE_CODE,
+                            BITSET_CONTAINER_TYPE_CODE):
+            return run_container_is_subset_bitset((run_container_t*)c1,
+                                                  (bitset_container_t*)c2);
+        case CONTAINER_PAIR(BITSET_CONTAINER_TYPE_CODE,
+                            ARRAY_CONTAINER_TYPE_CODE):
+            return bitset_container_is_subset_array((bitset_container_t*)c1,
+                                                    (array_container_t*)c2);
+        case CONTAINER_PAIR(ARRAY_CONTAINER_TYPE_CODE,
+                            BITSET_CONTAINER_TYPE_CODE):
+            return array_container_is_subset_bitset((array_container_t*)c1,
+                                                    (bitset_container_t*)c2);
+        case CONTAINER_PAIR(ARRAY_CONTAINER_TYPE_CODE, RUN_CONTAINER_TYPE_CODE):
+            return array_container_is_subset_run((array_container_t*)c1,
+                                                 (run_container_t*)c2);
+        case CONTAINER_PAIR(RUN_CONTAINER_TYPE_CODE, ARRAY_CONTAINER_TYPE_CODE):
+            return run_container_is_subset_array((run_container_t*)c1,
+                                                 (array_container_t*)c2);
+        case CONTAINER_PAIR(ARRAY_CONTAINER_TYPE_CODE,
+                            ARRAY_CONTAINER_TYPE_CODE):
+            return array_container_is_subset((array_container_t*)c1,
+                                             (array_container_t*)c2);
+        case CONTAINER_PAIR(RUN_CONTAINER_TYPE_CODE, RUN_CONTAINER_TYPE_CODE):
+            return run_container_is_subset((run_container_t*)c1,
+                                           (run_container_t*)c2);
+        default:
+            assert(false);
+            __builtin_unreachable();
+            return false;
+    }
+}
@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <string.h>
 #include "bitset_util.h"
+#include "containers/containers.h"
 #include "containers/convert.h"
 #include "containers/perfparameters.h"
 
@@ -57,6 +58,34 @@ void run_bitset_container_lazy_union(const run_container_t *src_1,
     dst->cardinality = BITSET_UNKNOWN_CARDINALITY;
 }
 
+/* Union of a few values with many runs: the runs sitting between two values
+ * are copied as a block, located by galloping. */
+static void array_run_container_union_skewed(const array_container_t *src_1,
+                                             const run_container_t *src_2,
+                                             run_container_t *dst) {
+    int32_t rlepos = 0;
+    rle16_t previousrle;
+    if (src_2->runs[0].value <= src_1->array[0]) {
+        previousrle = run_container_append_first(dst, src_2->runs[0]);
+        rlepos = 1;
+    } else {
+        previousrle = run_container_append_value_first(dst, src_1->array[0]);
+    }
+    for (int32_t arraypos = 0; arraypos < src_1->cardinality; ++arraypos) {
+        const uint16_t val = src_1->array[arraypos];
+        // runs starting before val come first
+        int32_t next = rle16_advance_until(src_2->runs, rlepos - 1,
+                                           src_2->n_runs, val);
+        if (next < src_2->n_runs && src_2->runs[next].value < val) ++next;
+        run_container_append_runs(dst, src_2->runs + rlepos, next - rlepos,
+                                  &previousrle);
+        run_container_append_value(dst, val, &previousrle);
+        rlepos = next;
+    }
+    run_container_append_runs(dst, src_2->runs + rlepos, src_2->n_runs - rlepos,
+                              &previousrle);
+}
+
 void array_run_container_union(const array_container_t *src_1,
                                const run_container_t *src_2,
                                run_container_t *dst) {
@@ -65,6 +94,11 @@ void array_run_container_union(const array_container_t *src_1,
         return;
     }
     run_container_grow(dst, 2 * (src_1->cardinality + src_2->n_runs), false);
+    if (src_1->cardinality > 0 &&
+        src_2->n_runs > src_1->cardinality * RUN_GALLOP_RATIO) {
+        array_run_container_union_skewed(src_1, src_2, dst);
+        return;
+    }
     int32_t rlepos = 0;
     int32_t arraypos = 0;
     rle16_t previousrle;
@@ -160,6 +194,8 @@ bool array_array_container_union(const array_container_t *src_1,
         if (*dst != NULL) array_container_union(src_1, src_2, *dst);
         return false;  // not a bitset
     }
+    ROARING_TRACE_CONVERSION(ARRAY_CONTAINER_TYPE_CODE,
+                             BITSET_CONTAINER_TYPE_CODE);
     *dst = bitset_container_create();
     bool returnval = true;  // expect a bitset
     if (*dst != NULL) {
@@ -187,6 +223,8 @@ bool array_array_container_lazy_union(const array_container_t *src_1,
         if (*dst != NULL) array_container_union(src_1, src_2, *dst);
         return false;  // not a bitset
     }
+    ROARING_TRACE_CONVERSION(ARRAY_CONTAINER_TYPE_CODE,
+                             BITSET_CONTAINER_TYPE_CODE);
     *dst = bitset_container_create();
     bool returnval = true;  // expect a bitset
     if (*dst != NULL) {
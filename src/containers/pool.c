@@ -0,0 +1,155 @@
+/*
+ * pool.c
+ *
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "containers/bitset.h"
+#include "containers/pool.h"
+#include "roaring_memory.h"
+
+enum {
+    POOL_MAX_BITSETS = 64,  // up to 512KB of bitset payloads per thread
+    POOL_MAX_ARRAYS = 256,  // per size class
+    POOL_ARRAY_CLASSES = 3
+};
+
+static const int32_t array_class_capacity[POOL_ARRAY_CLASSES] = {16, 32, 64};
+
+typedef struct container_pool_s {
+    bool registered;
+    bool disabled;
+    int32_t bitset_count;
+    int32_t array_count[POOL_ARRAY_CLASSES];
+    uint64_t *bitsets[POOL_MAX_BITSETS];
+    uint16_t *arrays[POOL_ARRAY_CLASSES][POOL_MAX_ARRAYS];
+    roaring_pool_stats_t stats;  // only the hit/miss counters are maintained
+} container_pool_t;
+
+static _Thread_local container_pool_t thread_pool;
+
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+
+static void pool_release_at_thread_exit(void *unused) {
+    (void)unused;
+    roaring_pool_trim(0);
+}
+
+static void pool_make_key(void) {
+    pthread_key_create(&pool_key, pool_release_at_thread_exit);
+}
+
+/* The first time a thread caches something, register it so that the cache
+ * is released when the thread exits. */
+static inline container_pool_t *pool_for_caching(void) {
+    container_pool_t *pool = &thread_pool;
+    if (!pool->registered) {
+        pthread_once(&pool_key_once, pool_make_key);
+        pthread_setspecific(pool_key, pool);
+        pool->registered = true;
+    }
+    return pool;
+}
+
+static inline int array_class(int32_t capacity) {
+    for (int c = 0; c < POOL_ARRAY_CLASSES; ++c)
+        if (array_class_capacity[c] == capacity) return c;
+    return -1;
+}
+
+static const size_t bitset_payload_bytes =
+    sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS;
+
+uint64_t *pool_bitset_words_get(void) {
+    container_pool_t *pool = &thread_pool;
+    if (roaring_has_thread_memory_hook())
+        return roaring_aligned_malloc(sizeof(__m256i), bitset_payload_bytes);
+    if (pool->bitset_count > 0) {
+        pool->stats.bitset_hits++;
+        return pool->bitsets[--pool->bitset_count];
+    }
+    pool->stats.bitset_misses++;
+    return roaring_aligned_malloc(sizeof(__m256i), bitset_payload_bytes);
+}
+
+void pool_bitset_words_put(uint64_t *words) {
+    if (words == NULL) return;
+    container_pool_t *pool = &thread_pool;
+    if (pool->disabled || pool->bitset_count == POOL_MAX_BITSETS ||
+        roaring_has_thread_memory_hook()) {
+        roaring_aligned_free(words);
+        return;
+    }
+    pool = pool_for_caching();
+    pool->bitsets[pool->bitset_count++] = words;
+}
+
+uint16_t *pool_array_payload_get(int32_t capacity) {
+    container_pool_t *pool = &thread_pool;
+    const int c = roaring_has_thread_memory_hook() ? -1 : array_class(capacity);
+    if (c >= 0) {
+        if (pool->array_count[c] > 0) {
+            pool->stats.array_hits++;
+            return pool->arrays[c][--pool->array_count[c]];
+        }
+        pool->stats.array_misses++;
+    }
+    return roaring_malloc(sizeof(uint16_t) * capacity);
+}
+
+void pool_array_payload_put(uint16_t *array, int32_t capacity) {
+    if (array == NULL) return;
+    container_pool_t *pool = &thread_pool;
+    const int c = array_class(capacity);
+    if (c < 0 || pool->disabled || pool->array_count[c] == POOL_MAX_ARRAYS ||
+        roaring_has_thread_memory_hook()) {
+        roaring_free(array);
+        return;
+    }
+    pool = pool_for_caching();
+    pool->arrays[c][pool->array_count[c]++] = array;
+}
+
+void roaring_pool_get_stats(roaring_pool_stats_t *stats) {
+    const container_pool_t *pool = &thread_pool;
+    *stats = pool->stats;
+    stats->cached_bitsets = pool->bitset_count;
+    stats->cached_bytes = pool->bitset_count * bitset_payload_bytes;
+    stats->cached_arrays = 0;
+    for (int c = 0; c < POOL_ARRAY_CLASSES; ++c) {
+        stats->cached_arrays += pool->array_count[c];
+        stats->cached_bytes +=
+            pool->array_count[c] * array_class_capacity[c] * sizeof(uint16_t);
+    }
+}
+
+size_t roaring_pool_trim(size_t max_cached_bytes) {
+    container_pool_t *pool = &thread_pool;
+    roaring_pool_stats_t stats;
+    roaring_pool_get_stats(&stats);
+    size_t cached = stats.cached_bytes;
+    const size_t before = cached;
+    // largest payloads first
+    while (cached > max_cached_bytes && pool->bitset_count > 0) {
+        roaring_aligned_free(pool->bitsets[--pool->bitset_count]);
+        cached -= bitset_payload_bytes;
+    }
+    for (int c = POOL_ARRAY_CLASSES - 1; c >= 0; --c) {
+        const size_t bytes = array_class_capacity[c] * sizeof(uint16_t);
+        while (cached > max_cached_bytes && pool->array_count[c] > 0) {
+            roaring_free(pool->arrays[c][--pool->array_count[c]]);
+            cached -= bytes;
+        }
+    }
+    return before - cached;
+}
+
+void roaring_pool_set_enabled(bool enabled) {
+    thread_pool.disabled = !enabled;
+    if (!enabled) roaring_pool_trim(0);
+}
@@ -9,7 +9,10 @@
 #include <string.h>
 #include <x86intrin.h>
 
+#include "containers/containers.h"
+#include "containers/perfparameters.h"
 #include "containers/run.h"
+#include "roaring_memory.h"
 
 extern bool run_container_is_full(const run_container_t *run);
 extern bool run_container_nonzero_cardinality(const run_container_t *r);
@@ -18,27 +21,28 @@ extern int32_t run_container_serialized_size_in_bytes(int32_t num_runs);
 extern run_container_t *run_container_create_range(uint32_t start,
                                                    uint32_t stop);
 
-enum { DEFAULT_INIT_SIZE = 4 };
+enum { RUN_DEFAULT_INIT_SIZE = 4 };
 
 /* Create a new run container. Return NULL in case of failure. */
 run_container_t *run_container_create_given_capacity(int32_t size) {
     run_container_t *run;
     /* Allocate the run container itself. */
-    if ((run = malloc(sizeof(run_container_t))) == NULL) {
+    if ((run = roaring_malloc(sizeof(run_container_t))) == NULL) {
         return NULL;
     }
-    if ((run->runs = malloc(sizeof(rle16_t) * size)) == NULL) {
-        free(run);
+    if ((run->runs = roaring_malloc(sizeof(rle16_t) * size)) == NULL) {
+        roaring_free(run);
         return NULL;
     }
     run->capacity = size;
     run->n_runs = 0;
+    ROARING_TRACE_ALLOCATION(RUN_CONTAINER_TYPE_CODE);
     return run;
 }
 
 /* Create a new run container. Return NULL in case of failure. */
 run_container_t *run_container_create(void) {
-    return run_container_create_given_capacity(DEFAULT_INIT_SIZE);
+    return run_container_create_given_capacity(RUN_DEFAULT_INIT_SIZE);
 }
 
 run_container_t *run_container_clone(const run_container_t *src) {
@@ -52,9 +56,10 @@ run_container_t *run_container_clone(const run_container_t *src) {
 
 /* Free memory. */
 void run_container_free(run_container_t *run) {
-    free(run->runs);
+    ROARING_TRACE_FREE(RUN_CONTAINER_TYPE_CODE);
+    roaring_free(run->runs);
     run->runs = NULL;  // pedantic
-    free(run);
+    roaring_free(run);
 }
 
 #ifdef USEAVX
@@ -111,7 +116,7 @@ _Static_assert(sizeof(rle16_t) == 2 * sizeof(uint16_t),
 void run_container_grow(run_container_t *run, int32_t min, bool copy) {
     int32_t newCapacity =
         (run->capacity == 0)
-            ? DEFAULT_INIT_SIZE
+            ? RUN_DEFAULT_INIT_SIZE
             : run->capacity < 64 ? run->capacity * 2
                                  : run->capacity < 1024 ? run->capacity * 3 / 2
                                                         : run->capacity * 5 / 4;
@@ -120,11 +125,11 @@ void run_container_grow(run_container_t *run, int32_t min, bool copy) {
     assert(run->capacity >= min);
     if (copy) {
         rle16_t *oldruns = run->runs;
-        run->runs = realloc(oldruns, run->capacity * sizeof(rle16_t));
-        if (run->runs == NULL) free(oldruns);
+        run->runs = roaring_realloc(oldruns, run->capacity * sizeof(rle16_t));
+        if (run->runs == NULL) roaring_free(oldruns);
     } else {
-        free(run->runs);
-        run->runs = malloc(run->capacity * sizeof(rle16_t));
+        roaring_free(run->runs);
+        run->runs = roaring_malloc(run->capacity * sizeof(rle16_t));
     }
     // TODO: handle the case where realloc fails
     if (run->runs == NULL) {
@@ -133,6 +138,18 @@ void run_container_grow(run_container_t *run, int32_t min, bool copy) {
             "production?\n");
     }
 }
+
+int32_t run_container_shrink_to_fit(run_container_t *run) {
+    if (run->n_runs == 0 || run->n_runs == run->capacity) return 0;
+    rle16_t *runs = roaring_realloc(run->runs, run->n_runs * sizeof(rle16_t));
+    if (runs == NULL) return 0;  // the original allocation is still valid
+    const int32_t saved =
+        (run->capacity - run->n_runs) * (int32_t)sizeof(rle16_t);
+    run->runs = runs;
+    run->capacity = run->n_runs;
+    return saved;
+}
+
 static inline void makeRoomAtIndex(run_container_t *run, uint16_t index) {
     /* This function calls realloc + memmove sequentially to move by one index.
      * Potentially copying twice the array.
@@ -291,6 +308,18 @@ bool run_container_remove(run_container_t *run, uint16_t pos) {
     return false;
 }
 
+int run_container_rank(const run_container_t *run, uint16_t x) {
+    int sum = 0;
+    for (int32_t i = 0; i < run->n_runs; ++i) {
+        const uint32_t start = run->runs[i].value;
+        const uint32_t length = run->runs[i].length;
+        if (x < start) break;
+        if (x <= start + length) return sum + (x - start) + 1;  // clipped
+        sum += length + 1;
+    }
+    return sum;
+}
+
 /* Check whether `pos' is present in `run'.  */
 bool run_container_contains(const run_container_t *run, uint16_t pos) {
     int32_t index = interleavedBinarySearch(run->runs, run->n_runs, pos);
@@ -306,10 +335,42 @@ bool run_container_contains(const run_container_t *run, uint16_t pos) {
 
 /* Compute the union of `src_1' and `src_2' and write the result to `dst'
  * It is assumed that `dst' is distinct from both `src_1' and `src_2'. */
+/* Union of a container having few runs with one having many more: the runs of
+ * the large container that sit between two runs of the small one are copied
+ * as a block, located by galloping. */
+static void run_container_union_skewed(const run_container_t *small,
+                                       const run_container_t *large,
+                                       run_container_t *dst) {
+    if (small->n_runs == 0) {
+        run_container_copy(large, dst);
+        return;
+    }
+    int32_t lpos = 0;
+    rle16_t previousrle;
+    if (large->runs[0].value <= small->runs[0].value) {
+        previousrle = run_container_append_first(dst, large->runs[0]);
+        lpos = 1;
+    } else {
+        previousrle = run_container_append_first(dst, small->runs[0]);
+    }
+    for (int32_t spos = 0; spos < small->n_runs; ++spos) {
+        const rle16_t srle = small->runs[spos];
+        // large runs starting before this small run come first
+        int32_t next = rle16_advance_until(large->runs, lpos - 1,
+                                           large->n_runs, srle.value);
+        if (next < large->n_runs && large->runs[next].value < srle.value)
+            ++next;
+        run_container_append_runs(dst, large->runs + lpos, next - lpos,
+                                  &previousrle);
+        run_container_append(dst, srle, &previousrle);
+        lpos = next;
+    }
+    run_container_append_runs(dst, large->runs + lpos, large->n_runs - lpos,
+                              &previousrle);
+}
+
 void run_container_union(const run_container_t *src_1,
                          const run_container_t *src_2, run_container_t *dst) {
-    // TODO: this could be a lot more efficient
-
     // we start out with inexpensive checks
     const bool if1 = run_container_is_full(src_1);
     const bool if2 = run_container_is_full(src_2);
@@ -327,6 +388,14 @@ void run_container_union(const run_container_t *src_1,
     if (dst->capacity < neededcapacity)
         run_container_grow(dst, neededcapacity, false);
     dst->n_runs = 0;
+    if (src_1->n_runs * RUN_GALLOP_RATIO < src_2->n_runs) {
+        run_container_union_skewed(src_1, src_2, dst);
+        return;
+    }
+    if (src_2->n_runs * RUN_GALLOP_RATIO < src_1->n_runs) {
+        run_container_union_skewed(src_2, src_1, dst);
+        return;
+    }
     int32_t rlepos = 0;
     int32_t xrlepos = 0;
 
@@ -420,6 +489,32 @@ void run_container_union_inplace(run_container_t *src_1,
     }
 }
 
+/* Intersection of a container having few runs with one having many more: for
+ * each small run, gallop to the first large run that reaches it. */
+static void run_container_intersection_skewed(const run_container_t *small,
+                                              const run_container_t *large,
+                                              run_container_t *dst) {
+    int32_t lpos = 0;
+    for (int32_t spos = 0; spos < small->n_runs; ++spos) {
+        const uint32_t start = small->runs[spos].value;
+        const uint32_t end = start + small->runs[spos].length;  // inclusive
+        lpos = rle16_advance_until(large->runs, lpos - 1, large->n_runs,
+                                   (uint16_t)start);
+        while (lpos < large->n_runs && large->runs[lpos].value <= end) {
+            const uint32_t lstart = large->runs[lpos].value;
+            const uint32_t lend = lstart + large->runs[lpos].length;
+            const uint32_t from = lstart > start ? lstart : start;
+            const uint32_t to = lend < end ? lend : end;
+            dst->runs[dst->n_runs].value = (uint16_t)from;
+            dst->runs[dst->n_runs].length = (uint16_t)(to - from);
+            dst->n_runs++;
+            if (lend > end) break;  // may also meet the next small run
+            lpos++;
+        }
+        if (lpos == large->n_runs) break;
+    }
+}
+
 /* Compute the intersection of src_1 and src_2 and write the result to
  * dst. It is assumed that dst is distinct from both src_1 and src_2. */
 void run_container_intersection(const run_container_t *src_1,
@@ -437,11 +532,18 @@ void run_container_intersection(const run_container_t *src_1,
             return;
         }
     }
-    // TODO: this could be a lot more efficient, could use SIMD optimizations
     const int32_t neededcapacity = src_1->n_runs + src_2->n_runs;
     if (dst->capacity < neededcapacity)
         run_container_grow(dst, neededcapacity, false);
     dst->n_runs = 0;
+    if (src_1->n_runs * RUN_GALLOP_RATIO < src_2->n_runs) {
+        run_container_intersection_skewed(src_1, src_2, dst);
+        return;
+    }
+    if (src_2->n_runs * RUN_GALLOP_RATIO < src_1->n_runs) {
+        run_container_intersection_skewed(src_2, src_1, dst);
+        return;
+    }
     int32_t rlepos = 0;
     int32_t xrlepos = 0;
     int32_t start = src_1->runs[rlepos].value;
@@ -499,6 +601,30 @@ void run_container_intersection(const run_container_t *src_1,
     }
 }
 
+/* Compute the intersection of src_1 and src_2 and write the result to
+ * src_1. */
+void run_container_intersection_inplace(run_container_t *src_1,
+                                        const run_container_t *src_2) {
+    if (run_container_is_full(src_2)) return;
+    if (run_container_is_full(src_1)) {
+        run_container_copy(src_2, src_1);
+        return;
+    }
+    const int32_t n1 = src_1->n_runs, n2 = src_2->n_runs;
+    if (n1 == 0 || n2 == 0) {
+        src_1->n_runs = 0;
+        return;
+    }
+    // The output has at most n1 + n2 - 1 runs. Once our runs are moved
+    // n2 slots up, the k-th output run is only written after more than
+    // k - n2 of them have been read, so it never overwrites an unread run.
+    if (src_1->capacity < n1 + n2) run_container_grow(src_1, n1 + n2, true);
+    memmove(src_1->runs + n2, src_1->runs, n1 * sizeof(rle16_t));
+    const run_container_t moved = {
+        .n_runs = n1, .capacity = n1, .runs = src_1->runs + n2};
+    run_container_intersection(&moved, src_2, src_1);
+}
+
 int run_container_to_uint32_array(uint32_t *out, const run_container_t *cont,
                                   uint32_t base) {
     int outpos = 0;
@@ -510,6 +636,23 @@ int run_container_to_uint32_array(uint32_t *out, const run_container_t *cont,
     return outpos;
 }
 
+int run_container_range_to_uint32_array(uint32_t *out,
+                                        const run_container_t *cont,
+                                        uint32_t base, int32_t offset,
+                                        int32_t limit) {
+    int32_t i = 0;
+    for (; i < cont->n_runs && cont->runs[i].length < offset; ++i)
+        offset -= cont->runs[i].length + 1;
+    int32_t outpos = 0;
+    for (; i < cont->n_runs && outpos < limit; ++i, offset = 0) {
+        const uint32_t run_start = base + cont->runs[i].value;
+        int32_t end = cont->runs[i].length + 1;
+        if (end - offset > limit - outpos) end = offset + limit - outpos;
+        for (int32_t j = offset; j < end; ++j) out[outpos++] = run_start + j;
+    }
+    return outpos;
+}
+
 /*
  * Print this container using printf (useful for debugging).
  */
@@ -598,7 +741,7 @@ void *run_container_deserialize(const char *buf, size_t buf_len) {
     else
         buf_len -= 8;
 
-    if ((ptr = malloc(sizeof(run_container_t))) != NULL) {
+    if ((ptr = roaring_malloc(sizeof(run_container_t))) != NULL) {
         size_t len;
         int32_t off;
 
@@ -609,12 +752,12 @@ void *run_container_deserialize(const char *buf, size_t buf_len) {
         len = sizeof(rle16_t) * ptr->n_runs;
 
         if (len != buf_len) {
-            free(ptr);
+            roaring_free(ptr);
             return (NULL);
         }
 
-        if ((ptr->runs = malloc(len)) == NULL) {
-            free(ptr);
+        if ((ptr->runs = roaring_malloc(len)) == NULL) {
+            roaring_free(ptr);
             return (NULL);
         }
 
@@ -623,12 +766,13 @@ void *run_container_deserialize(const char *buf, size_t buf_len) {
         /* Check if returned values are monotonically increasing */
         for (int32_t i = 0, j = 0; i < ptr->n_runs; i++) {
             if (ptr->runs[i].value < j) {
-                free(ptr->runs);
-                free(ptr);
+                roaring_free(ptr->runs);
+                roaring_free(ptr);
                 return (NULL);
             } else
                 j = ptr->runs[i].value;
         }
+        ROARING_TRACE_ALLOCATION(RUN_CONTAINER_TYPE_CODE);
     }
 
     return (ptr);
@@ -657,6 +801,27 @@ bool run_container_equals(run_container_t *container1,
     return true;
 }
 
+bool run_container_is_subset(const run_container_t *container1,
+                             const run_container_t *container2) {
+    // runs neither overlap nor touch, so each run of container1 must lie
+    // within a single run of container2
+    int32_t j = 0;
+    for (int32_t i = 0; i < container1->n_runs; ++i) {
+        const uint32_t start = container1->runs[i].value;
+        const uint32_t end = start + container1->runs[i].length;
+        while (j < container2->n_runs &&
+               (uint32_t)container2->runs[j].value +
+                       container2->runs[j].length <
+                   start)
+            ++j;
+        if (j == container2->n_runs || container2->runs[j].value > start ||
+            (uint32_t)container2->runs[j].value + container2->runs[j].length <
+                end)
+            return false;
+    }
+    return true;
+}
+
 // TODO: write smart_append_exclusive version to match the overloaded 1 param
 // Java version (or  is it even used?)
 
@@ -1,5 +1,6 @@
 #include "roaring.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -8,13 +9,13 @@
 #include "roaring_array.h"
 
 roaring_bitmap_t *roaring_bitmap_create() {
-    roaring_bitmap_t *ans = (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+    roaring_bitmap_t *ans = (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     ans->high_low_container = ra_create();
     if (!ans->high_low_container) {
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     ans->copy_on_write = false;
@@ -22,13 +23,13 @@ roaring_bitmap_t *roaring_bitmap_create() {
 }
 
 roaring_bitmap_t *roaring_bitmap_create_with_capacity(uint32_t cap) {
-    roaring_bitmap_t *ans = (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+    roaring_bitmap_t *ans = (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     ans->high_low_container = ra_create_with_capacity(cap);
     if (!ans->high_low_container) {
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     ans->copy_on_write = false;
@@ -57,7 +58,7 @@ roaring_bitmap_t *roaring_bitmap_of(size_t n_args, ...) {
     return answer;
 }
 
-static inline int32_t minimum(uint32_t a, uint32_t b) { return (a < b) ? a : b; }
+static inline int32_t minimum_uint32(uint32_t a, uint32_t b) { return (a < b) ? a : b; }
 
 roaring_bitmap_t *roaring_bitmap_from_range(uint32_t min, uint32_t max, uint32_t step) {
     if(step == 0)
@@ -75,7 +76,7 @@ roaring_bitmap_t *roaring_bitmap_from_range(uint32_t min, uint32_t max, uint32_t
     do {
         uint32_t key = min_tmp>>16;
         uint32_t container_min = min_tmp & 0xFFFF;
-        uint32_t container_max = minimum(max-(key<<16),1<<16);
+        uint32_t container_max = minimum_uint32(max-(key<<16),1<<16);
         uint8_t type;
         void *container = container_from_range(&type, container_min, container_max,
                                                           (uint16_t)step);
@@ -116,14 +117,213 @@ void roaring_bitmap_printf_describe(const roaring_bitmap_t *ra) {
     printf("}");
 }
 
+void roaring_bitmap_statistics(const roaring_bitmap_t *ra,
+                               roaring_statistics_t *stat) {
+    const roaring_array_t *hlc = ra->high_low_container;
+    memset(stat, 0, sizeof(*stat));
+    stat->n_containers = hlc->size;
+    for (int i = 0; i < hlc->size; ++i) {
+        const void *c = hlc->containers[i];
+        const uint8_t type = hlc->typecodes[i];
+        const int card = container_get_cardinality(c, type);
+        const size_t bytes = container_memory_size_in_bytes(c, type);
+        if (type == SHARED_CONTAINER_TYPE_CODE) stat->n_shared_containers++;
+        switch (get_container_type(c, type)) {
+            case ARRAY_CONTAINER_TYPE_CODE:
+                stat->n_array_containers++;
+                stat->n_values_array_containers += card;
+                stat->n_bytes_array_containers += bytes;
+                break;
+            case RUN_CONTAINER_TYPE_CODE:
+                stat->n_run_containers++;
+                stat->n_values_run_containers += card;
+                stat->n_bytes_run_containers += bytes;
+                break;
+            case BITSET_CONTAINER_TYPE_CODE:
+                stat->n_bitset_containers++;
+                stat->n_values_bitset_containers += card;
+                stat->n_bytes_bitset_containers += bytes;
+                break;
+        }
+        stat->cardinality += card;
+    }
+    stat->n_bytes_directory =
+        sizeof(roaring_bitmap_t) + ra_memory_size_in_bytes(hlc);
+    stat->n_bytes = stat->n_bytes_directory + stat->n_bytes_array_containers +
+                    stat->n_bytes_run_containers +
+                    stat->n_bytes_bitset_containers;
+    stat->portable_size_in_bytes =
+        ra_portable_size_in_bytes((roaring_array_t *)hlc);
+    if (hlc->size > 0) {
+        const int last = hlc->size - 1;
+        stat->min_value =
+            ((uint32_t)hlc->keys[0] << 16) |
+            container_minimum(hlc->containers[0], hlc->typecodes[0]);
+        stat->max_value =
+            ((uint32_t)hlc->keys[last] << 16) |
+            container_maximum(hlc->containers[last], hlc->typecodes[last]);
+    } else {
+        stat->min_value = UINT32_MAX;
+        stat->max_value = 0;
+    }
+}
+
+/* a slice [begin, end) of the containers of ra, and what was done to it */
+typedef struct container_task_s {
+    roaring_array_t *ra;
+    int32_t begin;
+    int32_t end;
+    size_t released;     // heap bytes released by shrink_to_fit
+    bool has_run;        // whether a run container is left
+    roaring_conversion_stats_t conversions;
+} container_task_t;
+
+enum { PARALLEL_MIN_CONTAINERS_PER_THREAD = 64, PARALLEL_MAX_THREADS = 64 };
+
+/* Apply work to the containers of ra, split among up to number_of_threads
+ * threads, and add up the tasks into total. The work is done in the calling
+ * thread when it has its own allocator installed (another thread would not
+ * use it). Each task only touches its own slice of the containers. */
+static void for_each_container_parallel(roaring_array_t *ra,
+                                        int number_of_threads,
+                                        void *(*work)(void *),
+                                        container_task_t *total) {
+    int nthreads = ra->size / PARALLEL_MIN_CONTAINERS_PER_THREAD;
+    if (nthreads > number_of_threads) nthreads = number_of_threads;
+    if (nthreads > PARALLEL_MAX_THREADS) nthreads = PARALLEL_MAX_THREADS;
+    if (nthreads < 1 || roaring_has_thread_memory_hook()) nthreads = 1;
+    container_task_t tasks[PARALLEL_MAX_THREADS];
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS];
+    for (int t = 0; t < nthreads; ++t) {
+        memset(&tasks[t], 0, sizeof(container_task_t));
+        tasks[t].ra = ra;
+        tasks[t].begin = (int32_t)((int64_t)ra->size * t / nthreads);
+        tasks[t].end = (int32_t)((int64_t)ra->size * (t + 1) / nthreads);
+    }
+    // the calling thread takes the first slice
+    for (int t = 1; t < nthreads; ++t)
+        started[t] = pthread_create(&threads[t], NULL, work, &tasks[t]) == 0;
+    work(&tasks[0]);
+    memset(total, 0, sizeof(container_task_t));
+    for (int t = 0; t < nthreads; ++t) {
+        if (t > 0) {
+            if (started[t])
+                pthread_join(threads[t], NULL);
+            else
+                work(&tasks[t]);
+        }
+        total->released += tasks[t].released;
+        total->has_run = total->has_run || tasks[t].has_run;
+        total->conversions.n_containers_converted +=
+            tasks[t].conversions.n_containers_converted;
+        total->conversions.n_bytes_saved +=
+            tasks[t].conversions.n_bytes_saved;
+    }
+}
+
+static void *shrink_containers(void *arg) {
+    container_task_t *task = (container_task_t *)arg;
+    for (int32_t i = task->begin; i < task->end; ++i)
+        task->released += container_shrink_to_fit(task->ra->containers[i],
+                                                  task->ra->typecodes[i]);
+    return NULL;
+}
+
+size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r) {
+    return roaring_bitmap_shrink_to_fit_parallel(r, 1);
+}
+
+size_t roaring_bitmap_shrink_to_fit_parallel(roaring_bitmap_t *r,
+                                             int number_of_threads) {
+    container_task_t total;
+    for_each_container_parallel(r->high_low_container, number_of_threads,
+                                shrink_containers, &total);
+    return total.released + ra_shrink_to_fit(r->high_low_container);
+}
+
+/* replace container i, whose content is c (unwrapped, of type typecode),
+ * by its conversion c1 */
+static void replace_converted_container(container_task_t *task, int32_t i,
+                                        const void *c, uint8_t typecode,
+                                        void *c1, uint8_t typecode_after) {
+    task->conversions.n_containers_converted++;
+    task->conversions.n_bytes_saved +=
+        (int64_t)container_size_in_bytes(c, typecode) -
+        container_size_in_bytes(c1, typecode_after);
+    // a shared container is released, not freed: the conversion was made
+    // from it without a copy
+    container_free(task->ra->containers[i], task->ra->typecodes[i]);
+    task->ra->containers[i] = c1;
+    task->ra->typecodes[i] = typecode_after;
+}
+
+static void *run_optimize_containers(void *arg) {
+    container_task_t *task = (container_task_t *)arg;
+    roaring_array_t *ra = task->ra;
+    for (int32_t i = task->begin; i < task->end; ++i) {
+        uint8_t typecode = ra->typecodes[i], typecode_after;
+        const void *c = container_unwrap_shared(ra->containers[i], &typecode);
+        void *c1 = convert_run_optimize_copy(c, typecode, &typecode_after);
+        if (c1 != c)
+            replace_converted_container(task, i, c, typecode, c1,
+                                        typecode_after);
+        if (typecode_after == RUN_CONTAINER_TYPE_CODE) task->has_run = true;
+    }
+    return NULL;
+}
+
+static void *remove_run_containers(void *arg) {
+    container_task_t *task = (container_task_t *)arg;
+    roaring_array_t *ra = task->ra;
+    for (int32_t i = task->begin; i < task->end; ++i) {
+        uint8_t typecode = ra->typecodes[i];
+        const void *c = container_unwrap_shared(ra->containers[i], &typecode);
+        if (typecode != RUN_CONTAINER_TYPE_CODE) continue;
+        task->has_run = true;
+        const run_container_t *run = (const run_container_t *)c;
+        if (run_container_cardinality(run) <= DEFAULT_MAX_SIZE)
+            replace_converted_container(task, i, c, typecode,
+                                        array_container_from_run(run),
+                                        ARRAY_CONTAINER_TYPE_CODE);
+        else
+            replace_converted_container(task, i, c, typecode,
+                                        bitset_container_from_run(run),
+                                        BITSET_CONTAINER_TYPE_CODE);
+    }
+    return NULL;
+}
+
+bool roaring_bitmap_run_optimize_parallel(roaring_bitmap_t *r,
+                                          int number_of_threads,
+                                          roaring_conversion_stats_t *stats) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_run_optimize_parallel");
+    container_task_t total;
+    for_each_container_parallel(r->high_low_container, number_of_threads,
+                                run_optimize_containers, &total);
+    if (stats != NULL) *stats = total.conversions;
+    return total.has_run;
+}
+
+bool roaring_bitmap_remove_run_compression_parallel(
+    roaring_bitmap_t *r, int number_of_threads,
+    roaring_conversion_stats_t *stats) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_remove_run_compression_parallel");
+    container_task_t total;
+    for_each_container_parallel(r->high_low_container, number_of_threads,
+                                remove_run_containers, &total);
+    if (stats != NULL) *stats = total.conversions;
+    return total.has_run;
+}
+
 roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
-    roaring_bitmap_t *ans = (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+    roaring_bitmap_t *ans = (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     ans->high_low_container = ra_copy(r->high_low_container,r->copy_on_write);
     if (!ans->high_low_container) {
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     ans->copy_on_write = r->copy_on_write;
@@ -141,7 +341,7 @@ static void roaring_bitmap_overwrite(roaring_bitmap_t *dest,
 void roaring_bitmap_free(roaring_bitmap_t *r) {
     ra_free(r->high_low_container);
     r->high_low_container = NULL;  // paranoid
-    free(r);
+    roaring_free(r);
 }
 
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
@@ -170,6 +370,27 @@ void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
     }
 }
 
+void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
+    const uint16_t hb = val >> 16;
+    const int i = ra_get_index(r->high_low_container, hb);
+    uint8_t typecode;
+    if (i >= 0) {
+        ra_unshare_container_at_index(r->high_low_container, i);
+        void *container =
+            ra_get_container_at_index(r->high_low_container, i, &typecode);
+        uint8_t newtypecode = typecode;
+        void *container2 =
+            container_remove(container, val & 0xFFFF, typecode, &newtypecode);
+        if (container2 != container) {
+            container_free(container, typecode);
+            ra_set_container_at_index(r->high_low_container, i, container2,
+                                      newtypecode);
+        }
+        if (!container_nonzero_cardinality(container2, newtypecode))
+            ra_remove_at_index(r->high_low_container, i);
+    }
+}
+
 bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(r->high_low_container, hb);
@@ -186,6 +407,7 @@ bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
 // there should be some SIMD optimizations possible here
 roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
                                      const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_and");
     uint8_t container_result_type = 0;
     const int length1 = x1->high_low_container->size,
               length2 = x2->high_low_container->size;
@@ -230,6 +452,7 @@ roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
  */
 roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
                                          const roaring_bitmap_t **x) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_or_many");
     if (number == 0) {
         return roaring_bitmap_create();
     }
@@ -247,6 +470,7 @@ roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
 // inplace and (modifies its first argument).
 void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
                                 const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_and_inplace");
     int pos1 = 0, pos2 = 0, intersection_size = 0;
     const int length1 = ra_get_size(x1->high_low_container);
     const int length2 = ra_get_size(x2->high_low_container);
@@ -301,18 +525,19 @@ void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
 
 roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_or");
     uint8_t container_result_type = 0;
     const int length1 = x1->high_low_container->size,
               length2 = x2->high_low_container->size;
-    roaring_bitmap_t *answer =
-        roaring_bitmap_create_with_capacity(length1 + length2);
-    answer->copy_on_write = x1->copy_on_write && x2->copy_on_write;
     if (0 == length1) {
         return roaring_bitmap_copy(x2);
     }
     if (0 == length2) {
         return roaring_bitmap_copy(x1);
     }
+    roaring_bitmap_t *answer =
+        roaring_bitmap_create_with_capacity(length1 + length2);
+    answer->copy_on_write = x1->copy_on_write && x2->copy_on_write;
     int pos1 = 0, pos2 = 0;
     uint8_t container_type_1, container_type_2;
     uint16_t s1 = ra_get_key_at_index(x1->high_low_container, pos1);
@@ -376,6 +601,7 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
 // inplace or (modifies its first argument).
 void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
                                const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_or_inplace");
     uint8_t container_result_type = 0;
     int length1 = x1->high_low_container->size;
     const int length2 = x2->high_low_container->size;
@@ -451,11 +677,57 @@ uint64_t roaring_bitmap_get_cardinality(const roaring_bitmap_t *ra) {
     return card;
 }
 
+uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *ra,
+                                          uint64_t range_start,
+                                          uint64_t range_end) {
+    if (range_end > UINT64_C(0x100000000)) range_end = UINT64_C(0x100000000);
+    if (range_start >= range_end) return 0;
+    range_end--;  // now inclusive
+    const uint16_t minhb = range_start >> 16, maxhb = range_end >> 16;
+    const uint16_t minlb = range_start & 0xFFFF, maxlb = range_end & 0xFFFF;
+    roaring_array_t *hlc = ra->high_low_container;
+    uint64_t card = 0;
+    int32_t i = ra_get_index(hlc, minhb);
+    if (i >= 0) {
+        // the first container counts whole below, less what precedes
+        // range_start
+        if (minlb > 0)
+            card -= container_rank(hlc->containers[i], hlc->typecodes[i],
+                                   minlb - 1);
+        if (minhb == maxhb)
+            return card + container_rank(hlc->containers[i], hlc->typecodes[i],
+                                         maxlb);
+    } else {
+        i = -i - 1;
+    }
+    for (; i < hlc->size && hlc->keys[i] < maxhb; ++i)
+        card += container_get_cardinality(hlc->containers[i],
+                                          hlc->typecodes[i]);
+    if (i < hlc->size && hlc->keys[i] == maxhb)
+        card += container_rank(hlc->containers[i], hlc->typecodes[i], maxlb);
+    return card;
+}
+
+uint32_t roaring_bitmap_minimum(const roaring_bitmap_t *ra) {
+    const roaring_array_t *hlc = ra->high_low_container;
+    if (hlc->size == 0) return UINT32_MAX;
+    return ((uint32_t)hlc->keys[0] << 16) |
+           container_minimum(hlc->containers[0], hlc->typecodes[0]);
+}
+
+uint32_t roaring_bitmap_maximum(const roaring_bitmap_t *ra) {
+    const roaring_array_t *hlc = ra->high_low_container;
+    if (hlc->size == 0) return 0;
+    const int32_t last = hlc->size - 1;
+    return ((uint32_t)hlc->keys[last] << 16) |
+           container_maximum(hlc->containers[last], hlc->typecodes[last]);
+}
+
 uint32_t *roaring_bitmap_to_uint32_array(const roaring_bitmap_t *ra,
                                          uint32_t *cardinality) {
     uint32_t card1 = roaring_bitmap_get_cardinality(ra);
 
-    uint32_t *ans = malloc((card1 + 10) * sizeof(uint32_t));  //+20??
+    uint32_t *ans = malloc((card1 + 10) * sizeof(uint32_t));  //+20?? caller frees
     // TODO Valgrind reports we write beyond the end of this array (?) with an
     // 8-byte write (?)
     // but it may just be an AVX2 instruction needing a little extra space.  Add
@@ -474,23 +746,74 @@ uint32_t *roaring_bitmap_to_uint32_array(const roaring_bitmap_t *ra,
     return ans;
 }
 
+/* limit for a container: its values are at most 1 << 16 */
+static inline int32_t container_limit(size_t limit) {
+    return limit > (1 << 16) ? (1 << 16) : (int32_t)limit;
+}
+
+size_t roaring_bitmap_range_uint32_array(const roaring_bitmap_t *ra,
+                                         size_t offset, size_t limit,
+                                         uint32_t *ans) {
+    const roaring_array_t *hlc = ra->high_low_container;
+    size_t written = 0;
+    for (int32_t i = 0; i < hlc->size && written < limit; ++i) {
+        // only the containers before offset need their cardinality
+        if (offset > 0) {
+            const int card =
+                container_get_cardinality(hlc->containers[i], hlc->typecodes[i]);
+            if ((size_t)card <= offset) {
+                offset -= card;
+                continue;
+            }
+        }
+        written += container_range_to_uint32_array(
+            ans + written, hlc->containers[i], hlc->typecodes[i],
+            ((uint32_t)hlc->keys[i]) << 16, (int32_t)offset,
+            container_limit(limit - written));
+        offset = 0;
+    }
+    return written;
+}
+
+size_t roaring_bitmap_range_values_uint32_array(const roaring_bitmap_t *ra,
+                                                uint64_t range_start,
+                                                uint64_t range_end,
+                                                size_t limit, uint32_t *ans) {
+    if (range_end > UINT64_C(0x100000000)) range_end = UINT64_C(0x100000000);
+    if (range_start >= range_end) return 0;
+    range_end--;  // now inclusive
+    const uint16_t minhb = range_start >> 16, maxhb = range_end >> 16;
+    const uint16_t minlb = range_start & 0xFFFF, maxlb = range_end & 0xFFFF;
+    roaring_array_t *hlc = ra->high_low_container;
+    int32_t i = ra_get_index(hlc, minhb);
+    if (i < 0) i = -i - 1;
+    size_t written = 0;
+    for (; i < hlc->size && hlc->keys[i] <= maxhb && written < limit; ++i) {
+        const void *c = hlc->containers[i];
+        const uint8_t type = hlc->typecodes[i];
+        // ranks [first, last) of the values in range, the boundary
+        // containers being the only ones ranked
+        int32_t first = 0, last = 1 << 16;
+        if (hlc->keys[i] == minhb && minlb > 0)
+            first = container_rank(c, type, minlb - 1);
+        if (hlc->keys[i] == maxhb) last = container_rank(c, type, maxlb);
+        if (last <= first) continue;
+        int32_t count = container_limit(limit - written);
+        if (count > last - first) count = last - first;
+        written += container_range_to_uint32_array(
+            ans + written, c, type, ((uint32_t)hlc->keys[i]) << 16, first,
+            count);
+    }
+    return written;
+}
+
 /** convert array and bitmap containers to run containers when it is more
  * efficient;
  * also convert from run containers when more space efficient.  Returns
  * true if the result has at least one run container.
 */
 bool roaring_bitmap_run_optimize(roaring_bitmap_t *r) {
-    bool answer = false;
-    for (int i = 0; i < r->high_low_container->size; i++) {
-    	uint8_t typecode_original, typecode_after;
-    	ra_unshare_container_at_index(r->high_low_container, i);//TODO: this introduces extra cloning!
-        void *c = ra_get_container_at_index(r->high_low_container, i,
-                                            &typecode_original);
-        void *c1 = convert_run_optimize(c, typecode_original, &typecode_after);
-        if (typecode_after == RUN_CONTAINER_TYPE_CODE) answer = true;
-        ra_set_container_at_index(r->high_low_container, i, c1, typecode_after);
-    }
-    return answer;
+    return roaring_bitmap_run_optimize_parallel(r, 1, NULL);
 }
 
 /**
@@ -498,32 +821,7 @@ bool roaring_bitmap_run_optimize(roaring_bitmap_t *r) {
  *  return whether a change was applied
  */
 bool roaring_bitmap_remove_run_compression(roaring_bitmap_t *r) {
-    bool answer = false;
-    for (int i = 0; i < r->high_low_container->size; i++) {
-        uint8_t typecode_original, typecode_after;
-        void *c = ra_get_container_at_index(r->high_low_container, i,
-                                            &typecode_original);
-        if (get_container_type(c,typecode_original) == RUN_CONTAINER_TYPE_CODE) {
-        	answer = true;
-			if (typecode_original == SHARED_CONTAINER_TYPE_CODE) {
-				void* truec = ((shared_container_t *) c)->container;
-				int32_t card = run_container_cardinality(truec);
-				void *c1 = convert_to_bitset_or_array_container(truec, card,
-						&typecode_after);
-				shared_container_free(c);
-				ra_set_container_at_index(r->high_low_container, i, c1,
-						typecode_after);
-
-			} else {
-				int32_t card = run_container_cardinality(c);
-				void *c1 = convert_to_bitset_or_array_container(c, card,
-						&typecode_after);
-				ra_set_container_at_index(r->high_low_container, i, c1,
-						typecode_after);
-			}
-        }
-    }
-    return answer;
+    return roaring_bitmap_remove_run_compression_parallel(r, 1, NULL);
 }
 
 char *roaring_bitmap_serialize(roaring_bitmap_t *ra, uint32_t *serialize_len) {
@@ -559,18 +857,23 @@ size_t roaring_bitmap_portable_size_in_bytes(const roaring_bitmap_t *ra) {
 }
 
 roaring_bitmap_t *roaring_bitmap_portable_deserialize(const char *buf) {
-    roaring_bitmap_t *ans = (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+    ROARING_TRACE_OPERATION("roaring_bitmap_portable_deserialize");
+    roaring_bitmap_t *ans = (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (ans == NULL) {
         return NULL;
     }
-    ans->high_low_container =
-        ra_portable_deserialize(buf);  // todo: handle the case where it is NULL
+    ans->high_low_container = ra_portable_deserialize(buf);
+    if (ans->high_low_container == NULL) {
+        roaring_free(ans);
+        return NULL;
+    }
     ans->copy_on_write = false;
     return ans;
 }
 
 size_t roaring_bitmap_portable_serialize(const roaring_bitmap_t *ra,
                                          char *buf) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_portable_serialize");
     return ra_portable_serialize(ra->high_low_container, buf);
 }
 
@@ -600,12 +903,12 @@ roaring_bitmap_t *roaring_bitmap_deserialize(const void *buf,
 
         if (len != buf_len) return (NULL);
 
-        b = (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+        b = (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
         if (b) {
             b->high_low_container =
                 ra_deserialize((const char *)buf + 5, buf_len - 5);
             if (b->high_low_container == NULL) {
-                free(b);
+                roaring_free(b);
                 b = NULL;
             }
         }
@@ -626,6 +929,7 @@ void roaring_iterate(roaring_bitmap_t *ra, roaring_iterator iterator,
 }
 
 bool roaring_bitmap_equals(roaring_bitmap_t *ra1, roaring_bitmap_t *ra2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_equals");
     if (ra1->high_low_container->size != ra2->high_low_container->size) {
         return false;
     }
@@ -647,6 +951,48 @@ bool roaring_bitmap_equals(roaring_bitmap_t *ra1, roaring_bitmap_t *ra2) {
     return true;
 }
 
+/* Whether ra1 is a subset of ra2; *strict is set to whether ra2 has more
+ * elements. Gallops over the keys of ra2 missing from ra1. */
+static bool is_subset(const roaring_bitmap_t *ra1, const roaring_bitmap_t *ra2,
+                      bool *strict) {
+    roaring_array_t *h1 = ra1->high_low_container;
+    roaring_array_t *h2 = ra2->high_low_container;
+    const int32_t length1 = h1->size, length2 = h2->size;
+    if (length1 > length2) return false;
+    *strict = length1 < length2;
+    int32_t pos2 = 0;
+    for (int32_t pos1 = 0; pos1 < length1; ++pos1, ++pos2) {
+        const uint16_t key1 = h1->keys[pos1];
+        if (pos2 < length2 && h2->keys[pos2] < key1)
+            pos2 = ra_advance_until(h2, key1, pos2);
+        if (pos2 == length2 || h2->keys[pos2] != key1) return false;
+        const int card1 =
+            container_get_cardinality(h1->containers[pos1], h1->typecodes[pos1]);
+        const int card2 =
+            container_get_cardinality(h2->containers[pos2], h2->typecodes[pos2]);
+        if (card1 > card2) return false;
+        if (!container_is_subset(h1->containers[pos1], h1->typecodes[pos1],
+                                 h2->containers[pos2], h2->typecodes[pos2]))
+            return false;
+        if (card1 < card2) *strict = true;
+    }
+    return true;
+}
+
+bool roaring_bitmap_is_subset(const roaring_bitmap_t *ra1,
+                              const roaring_bitmap_t *ra2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_is_subset");
+    bool strict;
+    return is_subset(ra1, ra2, &strict);
+}
+
+bool roaring_bitmap_is_strict_subset(const roaring_bitmap_t *ra1,
+                                     const roaring_bitmap_t *ra2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_is_strict_subset");
+    bool strict;
+    return is_subset(ra1, ra2, &strict) && strict;
+}
+
 static void insert_flipped_container(roaring_array_t *ans_arr,
                                      roaring_array_t *x1_arr, uint16_t hb,
                                      uint16_t lb_start, uint16_t lb_end) {
@@ -664,6 +1010,8 @@ static void insert_flipped_container(roaring_array_t *ans_arr,
         if (container_get_cardinality(flipped_container, ctype_out))
             ra_insert_new_key_value_at(ans_arr, -j - 1, hb, flipped_container,
                                        ctype_out);
+        else
+            container_free(flipped_container, ctype_out);
     } else {
         flipped_container = container_range_of_ones(
             (uint32_t)lb_start, (uint32_t)(lb_end + 1), &ctype_out);
@@ -687,7 +1035,8 @@ static void inplace_flip_container(roaring_array_t *x1_arr, uint16_t hb,
         if (container_get_cardinality(flipped_container, ctype_out)) {
             ra_set_container_at_index(x1_arr, i, flipped_container, ctype_out);
         } else {
-            container_free(flipped_container, ctype_out);
+            // ra_remove_at_index frees whatever sits at i
+            ra_set_container_at_index(x1_arr, i, flipped_container, ctype_out);
             ra_remove_at_index(x1_arr, i);
         }
 
@@ -714,6 +1063,8 @@ static void insert_fully_flipped_container(roaring_array_t *ans_arr,
         if (container_get_cardinality(flipped_container, ctype_out))
             ra_insert_new_key_value_at(ans_arr, -j - 1, hb, flipped_container,
                                        ctype_out);
+        else
+            container_free(flipped_container, ctype_out);
     } else {
         flipped_container = container_range_of_ones(0U, 0x10000U, &ctype_out);
         ra_insert_new_key_value_at(ans_arr, -j - 1, hb, flipped_container,
@@ -734,7 +1085,8 @@ static void inplace_fully_flip_container(roaring_array_t *x1_arr, uint16_t hb) {
         if (container_get_cardinality(flipped_container, ctype_out)) {
             ra_set_container_at_index(x1_arr, i, flipped_container, ctype_out);
         } else {
-            container_free(flipped_container, ctype_out);
+            // ra_remove_at_index frees whatever sits at i
+            ra_set_container_at_index(x1_arr, i, flipped_container, ctype_out);
             ra_remove_at_index(x1_arr, i);
         }
 
@@ -748,6 +1100,7 @@ static void inplace_fully_flip_container(roaring_array_t *x1_arr, uint16_t hb) {
 roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
                                       uint64_t range_start,
                                       uint64_t range_end) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_flip");
     if (range_start >= range_end) {
         return roaring_bitmap_copy(x1);
     }
@@ -798,6 +1151,7 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
 
 void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
                                  uint64_t range_end) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_flip_inplace");
     if (range_start >= range_end) {
         return;  // empty range
     }
@@ -836,18 +1190,19 @@ void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
 
 roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
                                          const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_lazy_or");
     uint8_t container_result_type = 0;
     const int length1 = x1->high_low_container->size,
               length2 = x2->high_low_container->size;
-    roaring_bitmap_t *answer =
-        roaring_bitmap_create_with_capacity(length1 + length2);
-    answer->copy_on_write = x1->copy_on_write && x2->copy_on_write;
     if (0 == length1) {
         return roaring_bitmap_copy(x2);
     }
     if (0 == length2) {
         return roaring_bitmap_copy(x1);
     }
+    roaring_bitmap_t *answer =
+        roaring_bitmap_create_with_capacity(length1 + length2);
+    answer->copy_on_write = x1->copy_on_write && x2->copy_on_write;
     int pos1 = 0, pos2 = 0;
     uint8_t container_type_1, container_type_2;
     uint16_t s1 = ra_get_key_at_index(x1->high_low_container, pos1);
@@ -910,6 +1265,7 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
 
 void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_lazy_or_inplace");
     uint8_t container_result_type = 0;
     int length1 = x1->high_low_container->size;
     const int length2 = x2->high_low_container->size;
@@ -977,6 +1333,7 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
 }
 
 void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *ra) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_repair_after_lazy");
     for (int i = 0; i < ra->high_low_container->size; ++i) {
         const uint8_t original_typecode = ra->high_low_container->typecodes[i];
         void *container = ra->high_low_container->containers[i];
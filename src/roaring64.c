@@ -0,0 +1,747 @@
+/*
+ * roaring64.c
+ *
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_util.h"
+#include "containers/containers.h"
+#include "portability.h"
+#include "roaring64.h"
+#include "roaring_expression.h"
+#include "roaring_memory.h"
+
+static inline uint32_t high_bits(uint64_t x) { return (uint32_t)(x >> 32); }
+
+static inline uint32_t low_bits(uint64_t x) { return (uint32_t)x; }
+
+static roaring64_bitmap_t *r64_create_with_capacity(int32_t cap) {
+    roaring64_bitmap_t *r = roaring_malloc(sizeof(roaring64_bitmap_t));
+    if (r == NULL) return NULL;
+    r->high = NULL;
+    r->bitmaps = NULL;
+    if (cap > 0) {
+        r->high = roaring_malloc(cap * sizeof(uint32_t));
+        r->bitmaps = roaring_malloc(cap * sizeof(roaring_bitmap_t *));
+        if (r->high == NULL || r->bitmaps == NULL) {
+            roaring_free(r->high);
+            roaring_free(r->bitmaps);
+            roaring_free(r);
+            return NULL;
+        }
+    }
+    r->size = 0;
+    r->capacity = cap;
+    r->copy_on_write = false;
+    return r;
+}
+
+/* make room for at least cap buckets */
+static bool r64_reserve(roaring64_bitmap_t *r, int32_t cap) {
+    if (cap <= r->capacity) return true;
+    int32_t newcap = r->capacity < 4 ? 4 : 2 * r->capacity;
+    if (newcap < cap) newcap = cap;
+    uint32_t *high = roaring_realloc(r->high, newcap * sizeof(uint32_t));
+    if (high == NULL) return false;
+    r->high = high;
+    roaring_bitmap_t **bitmaps =
+        roaring_realloc(r->bitmaps, newcap * sizeof(roaring_bitmap_t *));
+    if (bitmaps == NULL) return false;
+    r->bitmaps = bitmaps;
+    r->capacity = newcap;
+    return true;
+}
+
+/* index of the bucket with these high bits, or -(insertion point) - 1 as
+ * ra_get_index */
+static int32_t r64_get_index(const roaring64_bitmap_t *r, uint32_t high) {
+    if (r->size > 0 && r->high[r->size - 1] == high) return r->size - 1;
+    int32_t low = 0, up = r->size - 1;
+    while (low <= up) {
+        const int32_t middle = (low + up) >> 1;
+        if (r->high[middle] < high)
+            low = middle + 1;
+        else if (r->high[middle] > high)
+            up = middle - 1;
+        else
+            return middle;
+    }
+    return -(low + 1);
+}
+
+static void r64_append(roaring64_bitmap_t *r, uint32_t high,
+                       roaring_bitmap_t *bitmap) {
+    assert(r->size < r->capacity);
+    r->high[r->size] = high;
+    r->bitmaps[r->size] = bitmap;
+    r->size++;
+}
+
+/* free the bucket at index i and close the gap */
+static void r64_remove_at(roaring64_bitmap_t *r, int32_t i) {
+    roaring_bitmap_free(r->bitmaps[i]);
+    memmove(r->high + i, r->high + i + 1,
+            (r->size - i - 1) * sizeof(uint32_t));
+    memmove(r->bitmaps + i, r->bitmaps + i + 1,
+            (r->size - i - 1) * sizeof(roaring_bitmap_t *));
+    r->size--;
+}
+
+static inline bool bucket_is_empty(const roaring_bitmap_t *b) {
+    return b->high_low_container->size == 0;
+}
+
+/* copy of a bucket, sharing its containers if copy_on_write is set */
+static roaring_bitmap_t *bucket_copy(const roaring_bitmap_t *b,
+                                     bool copy_on_write) {
+    roaring_bitmap_t source = *b;
+    source.copy_on_write = copy_on_write;
+    return roaring_bitmap_copy(&source);
+}
+
+/* there is no 32-bit xor or andnot: they are two-leaf expressions */
+static roaring_bitmap_t *bucket_evaluate(
+    const roaring_bitmap_t *x1, const roaring_bitmap_t *x2,
+    int32_t (*operation)(roaring_expression_t *, int32_t, int32_t)) {
+    roaring_expression_t *e = roaring_expression_create();
+    if (e == NULL) return NULL;
+    roaring_bitmap_t *answer = NULL;
+    const int32_t left = roaring_expression_bitmap(e, x1);
+    const int32_t right = roaring_expression_bitmap(e, x2);
+    if (left >= 0 && right >= 0) {
+        const int32_t root = operation(e, left, right);
+        if (root >= 0) answer = roaring_expression_evaluate(e, root);
+    }
+    roaring_expression_free(e);
+    return answer;
+}
+
+static roaring_bitmap_t *bucket_xor(const roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2) {
+    return bucket_evaluate(x1, x2, roaring_expression_xor);
+}
+
+static roaring_bitmap_t *bucket_andnot(const roaring_bitmap_t *x1,
+                                       const roaring_bitmap_t *x2) {
+    return bucket_evaluate(x1, x2, roaring_expression_andnot);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_create(void) {
+    return r64_create_with_capacity(0);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_of_ptr(size_t n_args,
+                                            const uint64_t *vals) {
+    roaring64_bitmap_t *answer = roaring64_bitmap_create();
+    if (answer == NULL) return NULL;
+    for (size_t i = 0; i < n_args; i++) roaring64_bitmap_add(answer, vals[i]);
+    return answer;
+}
+
+roaring64_bitmap_t *roaring64_bitmap_copy(const roaring64_bitmap_t *r) {
+    roaring64_bitmap_t *answer = r64_create_with_capacity(r->size);
+    if (answer == NULL) return NULL;
+    answer->copy_on_write = r->copy_on_write;
+    for (int32_t i = 0; i < r->size; ++i) {
+        roaring_bitmap_t *b = bucket_copy(r->bitmaps[i], r->copy_on_write);
+        if (b == NULL) {
+            roaring64_bitmap_free(answer);
+            return NULL;
+        }
+        r64_append(answer, r->high[i], b);
+    }
+    return answer;
+}
+
+void roaring64_bitmap_free(roaring64_bitmap_t *r) {
+    if (r == NULL) return;
+    for (int32_t i = 0; i < r->size; ++i) roaring_bitmap_free(r->bitmaps[i]);
+    roaring_free(r->high);
+    roaring_free(r->bitmaps);
+    roaring_free(r);
+}
+
+void roaring64_bitmap_add(roaring64_bitmap_t *r, uint64_t x) {
+    const uint32_t high = high_bits(x);
+    int32_t i = r64_get_index(r, high);
+    if (i < 0) {
+        i = -i - 1;
+        if (!r64_reserve(r, r->size + 1)) return;
+        roaring_bitmap_t *b = roaring_bitmap_create();
+        if (b == NULL) return;
+        b->copy_on_write = r->copy_on_write;
+        memmove(r->high + i + 1, r->high + i, (r->size - i) * sizeof(uint32_t));
+        memmove(r->bitmaps + i + 1, r->bitmaps + i,
+                (r->size - i) * sizeof(roaring_bitmap_t *));
+        r->high[i] = high;
+        r->bitmaps[i] = b;
+        r->size++;
+    }
+    roaring_bitmap_add(r->bitmaps[i], low_bits(x));
+}
+
+void roaring64_bitmap_remove(roaring64_bitmap_t *r, uint64_t x) {
+    const int32_t i = r64_get_index(r, high_bits(x));
+    if (i < 0) return;
+    roaring_bitmap_remove(r->bitmaps[i], low_bits(x));
+    if (bucket_is_empty(r->bitmaps[i])) r64_remove_at(r, i);
+}
+
+bool roaring64_bitmap_contains(const roaring64_bitmap_t *r, uint64_t x) {
+    const int32_t i = r64_get_index(r, high_bits(x));
+    return i >= 0 && roaring_bitmap_contains(r->bitmaps[i], low_bits(x));
+}
+
+uint64_t roaring64_bitmap_get_cardinality(const roaring64_bitmap_t *r) {
+    uint64_t card = 0;
+    for (int32_t i = 0; i < r->size; ++i)
+        card += roaring_bitmap_get_cardinality(r->bitmaps[i]);
+    return card;
+}
+
+/* Merge the buckets of x1 and x2: the buckets found in both are combined
+ * with operation, those found in only one of them are copied if keep1
+ * (resp. keep2) is set. Empty results are dropped. */
+static roaring64_bitmap_t *r64_merge(
+    const roaring64_bitmap_t *x1, const roaring64_bitmap_t *x2,
+    roaring_bitmap_t *(*operation)(const roaring_bitmap_t *,
+                                   const roaring_bitmap_t *),
+    bool keep1, bool keep2) {
+    int32_t cap = x1->size < x2->size ? x1->size : x2->size;
+    if (keep1) cap = keep2 ? x1->size + x2->size : x1->size;
+    roaring64_bitmap_t *answer = r64_create_with_capacity(cap);
+    if (answer == NULL) return NULL;
+    answer->copy_on_write = x1->copy_on_write && x2->copy_on_write;
+    int32_t pos1 = 0, pos2 = 0;
+    while (pos1 < x1->size || pos2 < x2->size) {
+        roaring_bitmap_t *b = NULL;
+        uint32_t high;
+        if (pos2 == x2->size ||
+            (pos1 < x1->size && x1->high[pos1] < x2->high[pos2])) {
+            high = x1->high[pos1];
+            if (!keep1) {
+                ++pos1;
+                continue;
+            }
+            b = bucket_copy(x1->bitmaps[pos1++], answer->copy_on_write);
+        } else if (pos1 == x1->size || x2->high[pos2] < x1->high[pos1]) {
+            high = x2->high[pos2];
+            if (!keep2) {
+                ++pos2;
+                continue;
+            }
+            b = bucket_copy(x2->bitmaps[pos2++], answer->copy_on_write);
+        } else {
+            high = x1->high[pos1];
+            b = operation(x1->bitmaps[pos1++], x2->bitmaps[pos2++]);
+            if (b != NULL) b->copy_on_write = answer->copy_on_write;
+        }
+        if (b == NULL) {
+            roaring64_bitmap_free(answer);
+            return NULL;
+        }
+        if (bucket_is_empty(b))
+            roaring_bitmap_free(b);
+        else
+            r64_append(answer, high, b);
+    }
+    return answer;
+}
+
+roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *x1,
+                                         const roaring64_bitmap_t *x2) {
+    return r64_merge(x1, x2, roaring_bitmap_and, false, false);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *x1,
+                                        const roaring64_bitmap_t *x2) {
+    return r64_merge(x1, x2, roaring_bitmap_or, true, true);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *x1,
+                                         const roaring64_bitmap_t *x2) {
+    return r64_merge(x1, x2, bucket_xor, true, true);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *x1,
+                                            const roaring64_bitmap_t *x2) {
+    return r64_merge(x1, x2, bucket_andnot, true, false);
+}
+
+void roaring64_bitmap_and_inplace(roaring64_bitmap_t *x1,
+                                  const roaring64_bitmap_t *x2) {
+    int32_t pos2 = 0, kept = 0;
+    for (int32_t pos1 = 0; pos1 < x1->size; ++pos1) {
+        while (pos2 < x2->size && x2->high[pos2] < x1->high[pos1]) ++pos2;
+        roaring_bitmap_t *b = x1->bitmaps[pos1];
+        if (pos2 < x2->size && x2->high[pos2] == x1->high[pos1]) {
+            roaring_bitmap_and_inplace(b, x2->bitmaps[pos2]);
+            if (!bucket_is_empty(b)) {
+                x1->high[kept] = x1->high[pos1];
+                x1->bitmaps[kept++] = b;
+                continue;
+            }
+        }
+        roaring_bitmap_free(b);
+    }
+    x1->size = kept;
+}
+
+bool roaring64_bitmap_or_inplace(roaring64_bitmap_t *x1,
+                                 const roaring64_bitmap_t *x2) {
+    int32_t pos1 = 0, missing = 0;
+    for (int32_t pos2 = 0; pos2 < x2->size; ++pos2) {
+        while (pos1 < x1->size && x1->high[pos1] < x2->high[pos2]) ++pos1;
+        if (pos1 == x1->size || x1->high[pos1] != x2->high[pos2]) ++missing;
+    }
+    if (!r64_reserve(x1, x1->size + missing)) return false;
+    // copy the buckets missing from x1 before touching it, so that a failed
+    // copy leaves x1 as it was
+    roaring_bitmap_t **copies = NULL;
+    if (missing > 0) {
+        copies = roaring_malloc(missing * sizeof(roaring_bitmap_t *));
+        if (copies == NULL) return false;
+    }
+    int32_t copied = 0;
+    pos1 = 0;
+    for (int32_t pos2 = 0; pos2 < x2->size; ++pos2) {
+        while (pos1 < x1->size && x1->high[pos1] < x2->high[pos2]) ++pos1;
+        if (pos1 < x1->size && x1->high[pos1] == x2->high[pos2]) continue;
+        copies[copied] = bucket_copy(x2->bitmaps[pos2], x1->copy_on_write);
+        if (copies[copied] == NULL) {
+            while (copied > 0) roaring_bitmap_free(copies[--copied]);
+            roaring_free(copies);
+            return false;
+        }
+        ++copied;
+    }
+    // merge from the end so that the buckets of x1 move at most once; the
+    // shared buckets are merged in place (roaring_bitmap_or_inplace does not
+    // report allocation failures)
+    pos1 = x1->size - 1;
+    int32_t pos2 = x2->size - 1, pos = x1->size + missing - 1;
+    while (pos2 >= 0) {
+        if (pos1 >= 0 && x1->high[pos1] >= x2->high[pos2]) {
+            if (x1->high[pos1] == x2->high[pos2])
+                roaring_bitmap_or_inplace(x1->bitmaps[pos1], x2->bitmaps[pos2--]);
+            x1->high[pos] = x1->high[pos1];
+            x1->bitmaps[pos--] = x1->bitmaps[pos1--];
+        } else {
+            x1->high[pos] = x2->high[pos2--];
+            x1->bitmaps[pos--] = copies[--copied];
+        }
+    }
+    roaring_free(copies);
+    x1->size += missing;
+    return true;
+}
+
+typedef struct r64_source_s {
+    uint32_t high;
+    const roaring_bitmap_t *bitmap;
+} r64_source_t;
+
+static int compare_sources(const void *a, const void *b) {
+    const uint32_t ha = ((const r64_source_t *)a)->high;
+    const uint32_t hb = ((const r64_source_t *)b)->high;
+    return (ha > hb) - (ha < hb);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_or_many(size_t number,
+                                             const roaring64_bitmap_t **x) {
+    if (number == 0) return roaring64_bitmap_create();
+    if (number == 1) return roaring64_bitmap_copy(x[0]);
+    size_t total = 0;
+    bool copy_on_write = true;
+    for (size_t i = 0; i < number; ++i) {
+        total += x[i]->size;
+        copy_on_write = copy_on_write && x[i]->copy_on_write;
+    }
+    if (total > INT32_MAX) return NULL;
+    // the buckets of all the bitmaps, grouped by high bits; each bitmap
+    // contributes at most one bucket to a group
+    r64_source_t *sources = roaring_malloc((total + 1) * sizeof(r64_source_t));
+    const roaring_bitmap_t **group =
+        roaring_malloc(number * sizeof(roaring_bitmap_t *));
+    roaring64_bitmap_t *answer = r64_create_with_capacity((int32_t)total);
+    if (sources == NULL || group == NULL || answer == NULL) goto fail;
+    answer->copy_on_write = copy_on_write;
+    size_t n = 0;
+    for (size_t i = 0; i < number; ++i)
+        for (int32_t j = 0; j < x[i]->size; ++j) {
+            sources[n].high = x[i]->high[j];
+            sources[n++].bitmap = x[i]->bitmaps[j];
+        }
+    qsort(sources, total, sizeof(r64_source_t), compare_sources);
+    for (size_t start = 0; start < total;) {
+        size_t end = start + 1;
+        while (end < total && sources[end].high == sources[start].high) ++end;
+        roaring_bitmap_t *b;
+        if (end - start == 1) {
+            b = bucket_copy(sources[start].bitmap, copy_on_write);
+        } else {
+            for (size_t k = start; k < end; ++k)
+                group[k - start] = sources[k].bitmap;
+            // lazy unions, repaired once
+            b = roaring_bitmap_or_many(end - start, group);
+        }
+        if (b == NULL) goto fail;
+        b->copy_on_write = copy_on_write;
+        r64_append(answer, sources[start].high, b);
+        start = end;
+    }
+    roaring_free(sources);
+    roaring_free(group);
+    return answer;
+fail:
+    roaring_free(sources);
+    roaring_free(group);
+    roaring64_bitmap_free(answer);
+    return NULL;
+}
+
+typedef struct r64_iterate_s {
+    uint64_t high;
+    roaring64_iterator iterator;
+    void *ptr;
+} r64_iterate_t;
+
+static void r64_iterate_bucket(uint32_t value, void *param) {
+    const r64_iterate_t *it = (const r64_iterate_t *)param;
+    it->iterator(it->high | value, it->ptr);
+}
+
+void roaring64_iterate(const roaring64_bitmap_t *r,
+                       roaring64_iterator iterator, void *ptr) {
+    r64_iterate_t it = {.iterator = iterator, .ptr = ptr};
+    for (int32_t i = 0; i < r->size; ++i) {
+        it.high = (uint64_t)r->high[i] << 32;
+        roaring_iterate(r->bitmaps[i], r64_iterate_bucket, &it);
+    }
+}
+
+uint64_t *roaring64_bitmap_to_uint64_array(const roaring64_bitmap_t *r,
+                                           uint64_t *cardinality) {
+    const uint64_t card = roaring64_bitmap_get_cardinality(r);
+    uint64_t *ans = malloc((card > 0 ? card : 1) * sizeof(uint64_t));
+    if (ans == NULL) return NULL;
+    uint64_t ctr = 0;
+    for (int32_t i = 0; i < r->size; ++i) {
+        uint32_t n;
+        uint32_t *values = roaring_bitmap_to_uint32_array(r->bitmaps[i], &n);
+        if (values == NULL) {
+            free(ans);
+            return NULL;
+        }
+        const uint64_t high = (uint64_t)r->high[i] << 32;
+        for (uint32_t j = 0; j < n; ++j) ans[ctr++] = high | values[j];
+        free(values);
+    }
+    *cardinality = ctr;
+    return ans;
+}
+
+bool roaring64_bitmap_equals(const roaring64_bitmap_t *r1,
+                             const roaring64_bitmap_t *r2) {
+    if (r1->size != r2->size) return false;
+    for (int32_t i = 0; i < r1->size; ++i)
+        if (r1->high[i] != r2->high[i] ||
+            !roaring_bitmap_equals(r1->bitmaps[i], r2->bitmaps[i]))
+            return false;
+    return true;
+}
+
+bool roaring64_bitmap_run_optimize(roaring64_bitmap_t *r) {
+    bool answer = false;
+    for (int32_t i = 0; i < r->size; ++i)
+        if (roaring_bitmap_run_optimize(r->bitmaps[i])) answer = true;
+    return answer;
+}
+
+size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r) {
+    size_t count = sizeof(uint64_t);
+    for (int32_t i = 0; i < r->size; ++i)
+        count += sizeof(uint32_t) +
+                 roaring_bitmap_portable_size_in_bytes(r->bitmaps[i]);
+    return count;
+}
+
+size_t roaring64_bitmap_portable_serialize(const roaring64_bitmap_t *r,
+                                           char *buf) {
+    assert(!IS_BIG_ENDIAN);  // not implemented
+    char *initbuf = buf;
+    const uint64_t size = r->size;
+    memcpy(buf, &size, sizeof(size));
+    buf += sizeof(size);
+    for (int32_t i = 0; i < r->size; ++i) {
+        memcpy(buf, &r->high[i], sizeof(uint32_t));
+        buf += sizeof(uint32_t);
+        buf += roaring_bitmap_portable_serialize(r->bitmaps[i], buf);
+    }
+    return buf - initbuf;
+}
+
+roaring64_bitmap_t *roaring64_bitmap_portable_deserialize(const char *buf) {
+    assert(!IS_BIG_ENDIAN);  // not implemented
+    uint64_t size;
+    memcpy(&size, buf, sizeof(size));
+    buf += sizeof(size);
+    if (size > INT32_MAX) return NULL;
+    roaring64_bitmap_t *answer = r64_create_with_capacity((int32_t)size);
+    if (answer == NULL) return NULL;
+    for (uint64_t i = 0; i < size; ++i) {
+        uint32_t high;
+        memcpy(&high, buf, sizeof(high));
+        buf += sizeof(high);
+        if (answer->size > 0 && answer->high[answer->size - 1] >= high) {
+            roaring64_bitmap_free(answer);  // buckets must be sorted
+            return NULL;
+        }
+        roaring_bitmap_t *b = roaring_bitmap_portable_deserialize(buf);
+        if (b == NULL) {
+            roaring64_bitmap_free(answer);
+            return NULL;
+        }
+        // containers keep their type, hence their size in bytes
+        buf += roaring_bitmap_portable_size_in_bytes(b);
+        if (bucket_is_empty(b))
+            roaring_bitmap_free(b);
+        else
+            r64_append(answer, high, b);
+    }
+    return answer;
+}
+
+/* The directory of a frozen bitmap: the containers of bucket i are
+ * [first[i], first[i + 1]) in keys, cardinalities, typecodes and containers,
+ * containers pointing into the buffer. */
+struct roaring64_frozen_s {
+    int32_t size;
+    uint32_t *high;
+    int32_t *first;
+    uint16_t *keys;
+    int32_t *cardinalities;
+    uint8_t *typecodes;
+    const char **containers;
+    uint64_t cardinality;
+    size_t size_in_bytes;
+};
+
+static inline uint16_t frozen_read16(const char *buf, int32_t i) {
+    uint16_t v;
+    memcpy(&v, buf + 2 * i, sizeof(v));
+    return v;
+}
+
+/* Parse the header of a bitmap in the 32-bit portable format and find its
+ * containers. If f is NULL, only count them. Return the number of containers
+ * (-1 if there is no valid cookie) and set *end past the bitmap. */
+static int32_t frozen_parse_bitmap(const char *buf, roaring64_frozen_t *f,
+                                   int32_t first, const char **end) {
+    uint32_t cookie;
+    memcpy(&cookie, buf, sizeof(cookie));
+    buf += sizeof(cookie);
+    int32_t size;
+    const uint8_t *runflags = NULL;
+    if ((cookie & 0xFFFF) == SERIAL_COOKIE) {
+        size = (cookie >> 16) + 1;
+        runflags = (const uint8_t *)buf;
+        buf += (size + 7) / 8;
+    } else if (cookie == SERIAL_COOKIE_NO_RUNCONTAINER) {
+        memcpy(&size, buf, sizeof(size));
+        buf += sizeof(size);
+        if (size < 0 || size > (1 << 16)) return -1;
+    } else {
+        return -1;
+    }
+    const char *keycards = buf;
+    buf += 4 * size;
+    if (runflags == NULL || size >= NO_OFFSET_THRESHOLD) buf += 4 * size;
+    for (int32_t k = 0; k < size; ++k) {
+        const int32_t card = frozen_read16(keycards, 2 * k + 1) + 1;
+        uint8_t typecode;
+        if (runflags != NULL && (runflags[k / 8] & (1 << (k % 8))) != 0)
+            typecode = RUN_CONTAINER_TYPE_CODE;
+        else if (card > DEFAULT_MAX_SIZE)
+            typecode = BITSET_CONTAINER_TYPE_CODE;
+        else
+            typecode = ARRAY_CONTAINER_TYPE_CODE;
+        if (f != NULL) {
+            f->keys[first + k] = frozen_read16(keycards, 2 * k);
+            f->cardinalities[first + k] = card;
+            f->typecodes[first + k] = typecode;
+            f->containers[first + k] = buf;
+        }
+        if (typecode == RUN_CONTAINER_TYPE_CODE)
+            buf += sizeof(uint16_t) + frozen_read16(buf, 0) * sizeof(rle16_t);
+        else if (typecode == BITSET_CONTAINER_TYPE_CODE)
+            buf += BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t);
+        else
+            buf += card * sizeof(uint16_t);
+    }
+    *end = buf;
+    return size;
+}
+
+roaring64_frozen_t *roaring64_frozen_view(const char *buf) {
+    assert(!IS_BIG_ENDIAN);  // not implemented
+    uint64_t size;
+    memcpy(&size, buf, sizeof(size));
+    if (size > INT32_MAX) return NULL;
+    // first pass: count the containers
+    const char *p = buf + sizeof(size);
+    int64_t total = 0;
+    for (uint64_t i = 0; i < size; ++i) {
+        const int32_t n = frozen_parse_bitmap(p + sizeof(uint32_t), NULL, 0, &p);
+        if (n < 0) return NULL;
+        total += n;
+    }
+    if (total > INT32_MAX) return NULL;
+    roaring64_frozen_t *f = roaring_calloc(1, sizeof(roaring64_frozen_t));
+    if (f == NULL) return NULL;
+    f->size = (int32_t)size;
+    f->high = roaring_malloc((size + 1) * sizeof(uint32_t));
+    f->first = roaring_malloc((size + 1) * sizeof(int32_t));
+    f->keys = roaring_malloc((total + 1) * sizeof(uint16_t));
+    f->cardinalities = roaring_malloc((total + 1) * sizeof(int32_t));
+    f->typecodes = roaring_malloc(total + 1);
+    f->containers = roaring_malloc((total + 1) * sizeof(const char *));
+    if (f->high == NULL || f->first == NULL || f->keys == NULL ||
+        f->cardinalities == NULL || f->typecodes == NULL ||
+        f->containers == NULL) {
+        roaring64_frozen_free(f);
+        return NULL;
+    }
+    // second pass: fill in the directory
+    p = buf + sizeof(size);
+    int32_t first = 0;
+    for (int32_t i = 0; i < f->size; ++i) {
+        memcpy(&f->high[i], p, sizeof(uint32_t));
+        if (i > 0 && f->high[i - 1] >= f->high[i]) {
+            roaring64_frozen_free(f);  // buckets must be sorted
+            return NULL;
+        }
+        f->first[i] = first;
+        first += frozen_parse_bitmap(p + sizeof(uint32_t), f, first, &p);
+    }
+    f->first[f->size] = first;
+    for (int32_t k = 0; k < first; ++k) f->cardinality += f->cardinalities[k];
+    f->size_in_bytes = p - buf;
+    return f;
+}
+
+void roaring64_frozen_free(roaring64_frozen_t *f) {
+    if (f == NULL) return;
+    roaring_free(f->high);
+    roaring_free(f->first);
+    roaring_free(f->keys);
+    roaring_free(f->cardinalities);
+    roaring_free(f->typecodes);
+    roaring_free(f->containers);
+    roaring_free(f);
+}
+
+/* binary search over n little-endian uint16 values, as binarySearch */
+static int32_t frozen_binary_search(const char *buf, int32_t n,
+                                    int32_t stride, uint16_t target) {
+    int32_t low = 0, high = n - 1;
+    while (low <= high) {
+        const int32_t middle = (low + high) >> 1;
+        const uint16_t v = frozen_read16(buf, middle * stride);
+        if (v < target)
+            low = middle + 1;
+        else if (v > target)
+            high = middle - 1;
+        else
+            return middle;
+    }
+    return -(low + 1);
+}
+
+bool roaring64_frozen_contains(const roaring64_frozen_t *f, uint64_t x) {
+    const uint32_t high = high_bits(x);
+    int32_t low = 0, up = f->size - 1, i = -1;
+    while (low <= up) {
+        const int32_t middle = (low + up) >> 1;
+        if (f->high[middle] < high)
+            low = middle + 1;
+        else if (f->high[middle] > high)
+            up = middle - 1;
+        else {
+            i = middle;
+            break;
+        }
+    }
+    if (i < 0) return false;
+    const int32_t first = f->first[i];
+    const int32_t k = binarySearch(f->keys + first, f->first[i + 1] - first,
+                                   (uint16_t)(low_bits(x) >> 16));
+    if (k < 0) return false;
+    const char *c = f->containers[first + k];
+    const uint16_t v = (uint16_t)x;
+    switch (f->typecodes[first + k]) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            return ((const uint8_t *)c)[v >> 3] & (1 << (v & 7));
+        case ARRAY_CONTAINER_TYPE_CODE:
+            return frozen_binary_search(c, f->cardinalities[first + k], 1, v) >=
+                   0;
+        default: {
+            // runs of (value, length) after their count
+            const int32_t n_runs = frozen_read16(c, 0);
+            int32_t r = frozen_binary_search(c + 2, n_runs, 2, v);
+            if (r >= 0) return true;
+            r = -r - 2;  // the run starting before v, possibly -1
+            return r >= 0 &&
+                   v - frozen_read16(c + 2, 2 * r) <= frozen_read16(c + 2, 2 * r + 1);
+        }
+    }
+}
+
+uint64_t roaring64_frozen_get_cardinality(const roaring64_frozen_t *f) {
+    return f->cardinality;
+}
+
+size_t roaring64_frozen_size_in_bytes(const roaring64_frozen_t *f) {
+    return f->size_in_bytes;
+}
+
+void roaring64_frozen_iterate(const roaring64_frozen_t *f,
+                              roaring64_iterator iterator, void *ptr) {
+    for (int32_t i = 0; i < f->size; ++i) {
+        for (int32_t k = f->first[i]; k < f->first[i + 1]; ++k) {
+            const uint64_t base =
+                ((uint64_t)f->high[i] << 32) | ((uint32_t)f->keys[k] << 16);
+            const char *c = f->containers[k];
+            switch (f->typecodes[k]) {
+                case BITSET_CONTAINER_TYPE_CODE:
+                    for (int32_t w = 0; w < BITSET_CONTAINER_SIZE_IN_WORDS;
+                         ++w) {
+                        uint64_t word;
+                        memcpy(&word, c + w * sizeof(uint64_t), sizeof(word));
+                        while (word != 0) {
+                            iterator(base + w * 64 + __builtin_ctzll(word), ptr);
+                            word &= word - 1;
+                        }
+                    }
+                    break;
+                case ARRAY_CONTAINER_TYPE_CODE:
+                    for (int32_t j = 0; j < f->cardinalities[k]; ++j)
+                        iterator(base + frozen_read16(c, j), ptr);
+                    break;
+                default: {
+                    const int32_t n_runs = frozen_read16(c, 0);
+                    for (int32_t r = 0; r < n_runs; ++r) {
+                        const uint32_t start = frozen_read16(c + 2, 2 * r);
+                        const uint32_t last =
+                            start + frozen_read16(c + 2, 2 * r + 1);
+                        for (uint32_t v = start; v <= last; ++v)
+                            iterator(base + v, ptr);
+                    }
+                }
+            }
+        }
+    }
+}
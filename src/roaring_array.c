@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <x86intrin.h>
 
 #include "containers/bitset.h"
 #include "containers/containers.h"
@@ -18,30 +19,140 @@
 // Convention: [0,ra->size) all elements are initialized
 //  [ra->size, ra->allocation_size) is junk and contains nothing needing freeing
 
+// Memory layout: containers, keys and typecodes live in a single allocation
+// starting at ra->containers (widest elements first, so that every sub-array
+// is naturally aligned). Only ra->containers may be passed to free.
+
 extern int32_t ra_get_size(roaring_array_t *ra);
 
 #define INITIAL_CAPACITY 4
 
+/* Rank directory over the keys, maintained once an array holds at least
+ * KEY_INDEX_THRESHOLD containers so that ra_get_index is O(1).
+ * Bit k of words is set iff key k is present, and rank[w] is the number of
+ * keys in words [0, w). Entries of rank beyond last_word are not maintained:
+ * all keys are known to lie below them. */
+struct ra_key_index_s {
+    uint64_t words[1 << 10];
+    uint16_t rank[1 << 10];
+    int32_t last_word;
+};
+
+static void ra_key_index_free(roaring_array_t *ra) {
+    roaring_free(ra->key_index);
+    ra->key_index = NULL;
+}
+
+static void ra_key_index_build(roaring_array_t *ra) {
+    ra_key_index_t *idx = ra->key_index;
+    if (idx == NULL) {
+        idx = roaring_malloc(sizeof(ra_key_index_t));
+        if (idx == NULL) return;  // we just keep using binary searches
+        ra->key_index = idx;
+    }
+    memset(idx->words, 0, sizeof(idx->words));
+    for (int32_t i = 0; i < ra->size; ++i) {
+        idx->words[ra->keys[i] >> 6] |= UINT64_C(1) << (ra->keys[i] & 63);
+    }
+    idx->last_word = ra->size > 0 ? ra->keys[ra->size - 1] >> 6 : -1;
+    int32_t sum = 0;
+    for (int32_t w = 0; w <= idx->last_word; ++w) {
+        idx->rank[w] = (uint16_t)sum;
+        sum += _mm_popcnt_u64(idx->words[w]);
+    }
+}
+
+/* Record that key was added; size_before is the number of keys before it
+ * was added. */
+static void ra_key_index_add(ra_key_index_t *idx, uint16_t key,
+                             int32_t size_before) {
+    const int32_t w = key >> 6;
+    idx->words[w] |= UINT64_C(1) << (key & 63);
+    if (w > idx->last_word) {  // appending: only new words need a rank
+        for (int32_t j = idx->last_word + 1; j <= w; ++j)
+            idx->rank[j] = (uint16_t)size_before;
+        idx->last_word = w;
+    } else {
+        for (int32_t j = w + 1; j <= idx->last_word; ++j) idx->rank[j]++;
+    }
+}
+
+static void ra_key_index_remove(ra_key_index_t *idx, uint16_t key) {
+    const int32_t w = key >> 6;
+    idx->words[w] &= ~(UINT64_C(1) << (key & 63));
+    for (int32_t j = w + 1; j <= idx->last_word; ++j) idx->rank[j]--;
+}
+
+/* Same contract as binarySearch over ra->keys. */
+static inline int32_t ra_key_index_find(const ra_key_index_t *idx,
+                                        int32_t size, uint16_t key) {
+    const int32_t w = key >> 6;
+    if (w > idx->last_word) return -(size + 1);
+    const uint64_t word = idx->words[w];
+    const uint64_t bit = UINT64_C(1) << (key & 63);
+    const int32_t r = idx->rank[w] + (int32_t)_mm_popcnt_u64(word & (bit - 1));
+    return (word & bit) ? r : -(r + 1);
+}
+
+/* To be called after ra->keys[ra->size - 1 ... ] gained key (size already
+ * incremented). */
+static inline void ra_key_index_on_insert(roaring_array_t *ra, uint16_t key) {
+    if (ra->key_index != NULL)
+        ra_key_index_add(ra->key_index, key, ra->size - 1);
+    else if (ra->size >= KEY_INDEX_THRESHOLD)
+        ra_key_index_build(ra);
+}
+
+/* Rebuild (or drop) the index after keys were rewritten wholesale. */
+static void ra_key_index_reset(roaring_array_t *ra) {
+    if (ra->size >= KEY_INDEX_THRESHOLD)
+        ra_key_index_build(ra);
+    else
+        ra_key_index_free(ra);
+}
+
+static inline size_t ra_bytes_for_capacity(int32_t cap) {
+    return (size_t)cap * (sizeof(void *) + sizeof(uint16_t) + sizeof(uint8_t));
+}
+
+/* Moves the content of ra to a new block of new_capacity entries. Returns
+ * false (leaving ra untouched) on allocation failure. */
+static bool realloc_array(roaring_array_t *ra, int32_t new_capacity) {
+    assert(new_capacity >= ra->size);
+    void *bigalloc = NULL;
+    if (new_capacity > 0) {
+        bigalloc = roaring_malloc(ra_bytes_for_capacity(new_capacity));
+        if (bigalloc == NULL) return false;
+    }
+    void **newcontainers = (void **)bigalloc;
+    uint16_t *newkeys = (uint16_t *)(newcontainers + new_capacity);
+    uint8_t *newtypecodes = (uint8_t *)(newkeys + new_capacity);
+    if (ra->size > 0) {
+        memcpy(newcontainers, ra->containers, sizeof(void *) * ra->size);
+        memcpy(newkeys, ra->keys, sizeof(uint16_t) * ra->size);
+        memcpy(newtypecodes, ra->typecodes, sizeof(uint8_t) * ra->size);
+    }
+    roaring_free(ra->containers);
+    ra->containers = newcontainers;
+    ra->keys = bigalloc == NULL ? NULL : newkeys;
+    ra->typecodes = bigalloc == NULL ? NULL : newtypecodes;
+    ra->allocation_size = new_capacity;
+    return true;
+}
+
 roaring_array_t *ra_create_with_capacity(uint32_t cap) {
-    roaring_array_t *new_ra = malloc(sizeof(roaring_array_t));
+    roaring_array_t *new_ra = roaring_malloc(sizeof(roaring_array_t));
     if (!new_ra) return NULL;
     new_ra->keys = NULL;
     new_ra->containers = NULL;
     new_ra->typecodes = NULL;
-
-    new_ra->allocation_size = cap;
-    new_ra->keys = malloc(cap * sizeof(uint16_t));
-    new_ra->containers = malloc(cap * sizeof(void *));
-    new_ra->typecodes = malloc(cap * sizeof(uint8_t));
-    if (!new_ra->keys || !new_ra->containers || !new_ra->typecodes ) {
-        free(new_ra);
-        free(new_ra->keys);
-        free(new_ra->containers);
-        free(new_ra->typecodes);
+    new_ra->key_index = NULL;
+    new_ra->size = 0;
+    new_ra->allocation_size = 0;
+    if (!realloc_array(new_ra, (int32_t)cap)) {
+        roaring_free(new_ra);
         return NULL;
     }
-    new_ra->size = 0;
-
     return new_ra;
 }
 
@@ -50,27 +161,9 @@ roaring_array_t *ra_create() {
 }
 
 roaring_array_t *ra_copy(roaring_array_t *r, bool copy_on_write) {
-    roaring_array_t *new_ra = malloc(sizeof(roaring_array_t));
+    roaring_array_t *new_ra = ra_create_with_capacity(r->allocation_size);
     if (!new_ra) return NULL;
-    new_ra->keys = NULL;
-    new_ra->containers = NULL;
-    new_ra->typecodes = NULL;
-
-    const int32_t allocsize = r->allocation_size;
-    new_ra->allocation_size = allocsize;
-    new_ra->keys = malloc(allocsize * sizeof(uint16_t));
-    new_ra->containers =
-        calloc(allocsize, sizeof(void *));  // setting pointers to zero
-    new_ra->typecodes = malloc(allocsize * sizeof(uint8_t));
-    if (!new_ra->keys || !new_ra->containers || !new_ra->typecodes ) {
-        free(new_ra);
-        free(new_ra->keys);
-        free(new_ra->containers);
-        free(new_ra->typecodes);
-        return NULL;
-    }
-    int32_t s = r->size;
-    new_ra->size = s;
+    const int32_t s = r->size;
     memcpy(new_ra->keys, r->keys, s * sizeof(uint16_t));
     // we go through the containers, turning them into shared containers...
     if(copy_on_write) {
@@ -87,48 +180,45 @@ roaring_array_t *ra_copy(roaring_array_t *r, bool copy_on_write) {
             container_clone(r->containers[i], r->typecodes[i]);
         if (new_ra->containers[i] == NULL) {
             for (int32_t j = 0; j < i; j++) {
-                container_free(r->containers[j], r->typecodes[j]);
+                container_free(new_ra->containers[j], new_ra->typecodes[j]);
             }
-            free(new_ra);
-            free(new_ra->keys);
-            free(new_ra->containers);
-            free(new_ra->typecodes);
+            ra_free_without_containers(new_ra);
             return NULL;
         }
       }
     }
+    new_ra->size = s;
+    if (r->key_index != NULL) {
+        new_ra->key_index = roaring_malloc(sizeof(ra_key_index_t));
+        if (new_ra->key_index != NULL)
+            memcpy(new_ra->key_index, r->key_index, sizeof(ra_key_index_t));
+    }
     return new_ra;
 }
 
-static void ra_clear(roaring_array_t *ra) {
-    free(ra->keys);
-    ra->keys = NULL;  // paranoid
-    for (int i = 0; i < ra->size; ++i) {
-          container_free(ra->containers[i], ra->typecodes[i]);
-    }
-    free(ra->containers);
+static void ra_clear_without_containers(roaring_array_t *ra) {
+    roaring_free(ra->containers);  // keys and typecodes share this allocation
     ra->containers = NULL;  // paranoid
-    free(ra->typecodes);
+    ra->keys = NULL;  // paranoid
     ra->typecodes = NULL;  // paranoid
+    ra_key_index_free(ra);
 }
 
-static void ra_clear_without_containers(roaring_array_t *ra) {
-    free(ra->keys);
-    ra->keys = NULL;  // paranoid
-    free(ra->containers);
-    ra->containers = NULL;  // paranoid
-    free(ra->typecodes);
-    ra->typecodes = NULL;  // paranoid
+static void ra_clear(roaring_array_t *ra) {
+    for (int i = 0; i < ra->size; ++i) {
+          container_free(ra->containers[i], ra->typecodes[i]);
+    }
+    ra_clear_without_containers(ra);
 }
 
 void ra_free(roaring_array_t *ra) {
     ra_clear(ra);
-    free(ra);
+    roaring_free(ra);
 }
 
 void ra_free_without_containers(roaring_array_t *ra) {
     ra_clear_without_containers(ra);
-    free(ra);
+    roaring_free(ra);
 }
 
 void extend_array(roaring_array_t *ra, uint32_t k) {
@@ -138,17 +228,12 @@ void extend_array(roaring_array_t *ra, uint32_t k) {
         int new_capacity =
             (ra->size < 1024) ? 2 * desired_size : 5 * desired_size / 4;
 
-        ra->keys = realloc(ra->keys, sizeof(uint16_t) * new_capacity);
-        ra->containers = realloc(ra->containers, sizeof(void *) * new_capacity);
-        ra->typecodes = realloc(ra->typecodes, sizeof(uint8_t) * new_capacity);
-        if (!ra->keys || !ra->containers || !ra->typecodes ) {
+        if (!realloc_array(ra, new_capacity)) {
             fprintf(stderr, "[%s] %s\n", __FILE__, __func__);
             perror(0);
         }
-        ra->allocation_size = new_capacity;
     }
 }
-
 void ra_append(roaring_array_t *ra, uint16_t key, void *container,
                uint8_t typecode) {
     extend_array(ra, 1);
@@ -158,6 +243,7 @@ void ra_append(roaring_array_t *ra, uint16_t key, void *container,
     ra->containers[pos] = container;
     ra->typecodes[pos] = typecode;
     ra->size++;
+    ra_key_index_on_insert(ra, key);
 }
 
 
@@ -178,6 +264,7 @@ void ra_append_copy(roaring_array_t *ra, roaring_array_t *sa, uint16_t index, bo
             ra->typecodes[pos] = sa->typecodes[index];
       }
     ra->size++;
+    ra_key_index_on_insert(ra, ra->keys[pos]);
 }
 
 
@@ -206,6 +293,7 @@ if(copy_on_write) {
         ra->typecodes[pos] = sa->typecodes[i];
           }
         ra->size++;
+        ra_key_index_on_insert(ra, ra->keys[pos]);
     }
 }
 
@@ -230,6 +318,7 @@ void ra_append_move_range(roaring_array_t *ra, roaring_array_t *sa,
         ra->containers[pos] = sa->containers[i];
         ra->typecodes[pos] = sa->typecodes[i];
         ra->size++;
+        ra_key_index_on_insert(ra, ra->keys[pos]);
     }
 }
 
@@ -250,11 +339,12 @@ void ra_append_range(roaring_array_t *ra, roaring_array_t *sa,
                     ra->typecodes[pos] = sa->typecodes[i];
           }
         ra->size++;
+        ra_key_index_on_insert(ra, ra->keys[pos]);
     }
 }
 
 void *ra_get_container(roaring_array_t *ra, uint16_t x, uint8_t *typecode) {
-    int i = binarySearch(ra->keys, (int32_t)ra->size, x);
+    int i = ra_get_index(ra, x);
     if (i < 0) return NULL;
     *typecode = ra->typecodes[i];
     return ra->containers[i];
@@ -269,7 +359,7 @@ void *ra_get_container_at_index(roaring_array_t *ra, uint16_t i,
 
 
 void *ra_get_writable_container(roaring_array_t *ra, uint16_t x, uint8_t *typecode) {
-    int i = binarySearch(ra->keys, (int32_t)ra->size, x);
+    int i = ra_get_index(ra, x);
     if (i < 0) return NULL;
     *typecode = ra->typecodes[i];
     return get_writable_copy_if_shared(ra->containers[i], typecode);
@@ -289,6 +379,10 @@ uint16_t ra_get_key_at_index(roaring_array_t *ra, uint16_t i) {
 int32_t ra_get_index(roaring_array_t *ra, uint16_t x) {
     // TODO: next line is possibly unsafe
     if ((ra->size == 0) || ra->keys[ra->size - 1] == x) return ra->size - 1;
+    // once size >= KEY_INDEX_THRESHOLD the rank directory answers; it is
+    // only read here, so concurrent readers stay safe
+    if (ra->key_index != NULL)
+        return ra_key_index_find(ra->key_index, ra->size, x);
 
     return binarySearch(ra->keys, (int32_t)ra->size, x);
 }
@@ -320,6 +414,7 @@ void ra_insert_new_key_value_at(roaring_array_t *ra, int32_t i, uint16_t key,
     ra->containers[i] = container;
     ra->typecodes[i] = typecode;
     ra->size++;
+    ra_key_index_on_insert(ra, key);
 }
 
 // note: Java routine set things to 0, enabling GC.
@@ -330,9 +425,12 @@ void ra_insert_new_key_value_at(roaring_array_t *ra, int32_t i, uint16_t key,
 void ra_downsize(roaring_array_t *ra, int32_t new_length) {
     assert(new_length <= ra->size);
     ra->size = new_length;
+    if (ra->key_index != NULL || ra->size >= KEY_INDEX_THRESHOLD)
+        ra_key_index_reset(ra);
 }
 
 void ra_remove_at_index(roaring_array_t *ra, int32_t i) {
+    const uint16_t key = ra->keys[i];
     container_free(ra->containers[i], ra->typecodes[i]);
     memmove(&(ra->containers[i]), &(ra->containers[i + 1]),
             sizeof(void *) * (ra->size - i - 1));
@@ -341,6 +439,12 @@ void ra_remove_at_index(roaring_array_t *ra, int32_t i) {
     memmove(&(ra->typecodes[i]), &(ra->typecodes[i + 1]),
             sizeof(uint8_t) * (ra->size - i - 1));
     ra->size--;
+    if (ra->key_index != NULL) {
+        if (ra->size < KEY_INDEX_THRESHOLD / 2)
+            ra_key_index_free(ra);
+        else
+            ra_key_index_remove(ra->key_index, key);
+    }
 }
 
 
@@ -370,6 +474,7 @@ void ra_copy_range(roaring_array_t *ra, uint32_t begin, uint32_t end,
             sizeof(uint16_t) * range);
     memmove(&(ra->typecodes[new_begin]), &(ra->typecodes[begin]),
             sizeof(uint8_t) * range);
+    if (ra->key_index != NULL) ra_key_index_free(ra);  // keys are now stale
 }
 
 void ra_set_container_at_index(roaring_array_t *ra, int32_t i, void *c,
@@ -397,6 +502,9 @@ void ra_replace_key_and_container_at_index(roaring_array_t *ra, int32_t i,
     // possibly we just need to avoid free if c == ra->containers[i] but
     // otherwise do it.
 
+    // Callers compact the array this way (followed by ra_downsize), so keys
+    // may transiently appear twice: drop the index, ra_downsize rebuilds it.
+    if (ra->key_index != NULL && ra->keys[i] != key) ra_key_index_free(ra);
     ra->keys[i] = key;
     ra->containers[i] = c;
     ra->typecodes[i] = typecode;
@@ -426,7 +534,7 @@ char *ra_serialize(roaring_array_t *ra, uint32_t *serialize_len,
 
     (*retry_with_array) = 0;
     /* [ 32 bit length ] [ serialization bytes ] */
-    if ((lens = (uint16_t *)malloc(sizeof(int16_t) * ra->size)) == NULL) {
+    if ((lens = (uint16_t *)roaring_malloc(sizeof(int16_t) * ra->size)) == NULL) {
         *serialize_len = 0;
         return (NULL);
     }
@@ -443,14 +551,14 @@ char *ra_serialize(roaring_array_t *ra, uint32_t *serialize_len,
 
     if ((cardinality * sizeof(uint32_t)) < tot_len) {
         *retry_with_array = 1;
-        free(lens);
+        roaring_free(lens);
         return (NULL);
     }
 
-    out = (char *)malloc(tot_len);
+    out = (char *)malloc(tot_len);  // handed over to the caller
 
     if (out == NULL) {
-        free(lens);
+        roaring_free(lens);
         *serialize_len = 0;
         return (NULL);
     } else
@@ -494,7 +602,7 @@ char *ra_serialize(roaring_array_t *ra, uint32_t *serialize_len,
             for (int32_t j = 0; j <= i; j++)
                 container_free(ra->containers[j], ra->typecodes[j]);
 
-            free(lens);
+            roaring_free(lens);
             free(out);
             assert(serialized_bytes != lens[i]);
             return (NULL);
@@ -507,7 +615,7 @@ char *ra_serialize(roaring_array_t *ra, uint32_t *serialize_len,
         assert(tot_len != off);
     }
 
-    free(lens);
+    roaring_free(lens);
 
     return (out);
 }
@@ -524,28 +632,9 @@ roaring_array_t *ra_deserialize(const void *buf, uint32_t buf_len) {
 
     if (buf_len < expected_len) return (NULL);
 
-    if ((ra_copy = (roaring_array_t *)malloc(sizeof(roaring_array_t))) == NULL)
-        return (NULL);
-
-    memcpy(ra_copy, bufaschar, off = sizeof(roaring_array_t));
-
-    if ((ra_copy->keys = malloc(size * sizeof(uint16_t))) == NULL) {
-        free(ra_copy);
-        return (NULL);
-    }
-
-    if ((ra_copy->containers = malloc(size * sizeof(void *))) == NULL) {
-        free(ra_copy->keys);
-        free(ra_copy);
-        return (NULL);
-    }
+    if ((ra_copy = ra_create_with_capacity(size)) == NULL) return (NULL);
 
-    if ((ra_copy->typecodes = malloc(size * sizeof(uint8_t))) == NULL) {
-        free(ra_copy->containers);
-        free(ra_copy->keys);
-        free(ra_copy);
-        return (NULL);
-    }
+    off = sizeof(roaring_array_t);  // pointers stored in the buffer are stale
 
     l = size * sizeof(uint16_t);
     memcpy(ra_copy->keys, &bufaschar[off], l);
@@ -572,14 +661,14 @@ roaring_array_t *ra_deserialize(const void *buf, uint32_t buf_len) {
             for (int32_t j = 0; j < i; j++)
                 container_free(ra_copy->containers[j], ra_copy->typecodes[j]);
 
-            free(ra_copy->containers);
-            free(ra_copy->keys);
-            free(ra_copy);
+            ra_free_without_containers(ra_copy);
             return (NULL);
         }
 
         off += len;
     }
+    ra_copy->size = size;
+    ra_key_index_reset(ra_copy);
 
     return (ra_copy);
 }
@@ -605,6 +694,21 @@ uint32_t ra_portable_header_size(roaring_array_t *ra) {
     }
 }
 
+size_t ra_memory_size_in_bytes(const roaring_array_t *ra) {
+    size_t bytes = sizeof(roaring_array_t);
+    if (ra->allocation_size > 0)
+        bytes += ra_bytes_for_capacity(ra->allocation_size);
+    if (ra->key_index != NULL) bytes += sizeof(ra_key_index_t);
+    return bytes;
+}
+
+size_t ra_shrink_to_fit(roaring_array_t *ra) {
+    if (ra->allocation_size == ra->size) return 0;
+    const size_t before = ra_bytes_for_capacity(ra->allocation_size);
+    if (!realloc_array(ra, ra->size)) return 0;
+    return before - ra_bytes_for_capacity(ra->size);
+}
+
 size_t ra_portable_size_in_bytes(roaring_array_t *ra) {
     size_t count = ra_portable_header_size(ra);
 
@@ -624,7 +728,7 @@ size_t ra_portable_serialize(roaring_array_t *ra, char *buf) {
         memcpy(buf, &cookie, sizeof(cookie));
         buf += sizeof(cookie);
         uint32_t s = (ra->size + 7) / 8;
-        uint8_t *bitmapOfRunContainers = calloc(s, 1);
+        uint8_t *bitmapOfRunContainers = roaring_calloc(s, 1);
         assert(bitmapOfRunContainers != NULL);  // todo: handle
         for (int32_t i = 0; i < ra->size; ++i) {
             if (get_container_type(ra->containers[i],ra->typecodes[i])
@@ -634,7 +738,7 @@ size_t ra_portable_serialize(roaring_array_t *ra, char *buf) {
         }
         memcpy(buf, bitmapOfRunContainers, s);
         buf += s;
-        free(bitmapOfRunContainers);
+        roaring_free(bitmapOfRunContainers);
         if (ra->size < NO_OFFSET_THRESHOLD) {
             startOffset = 4 + 4 * ra->size + s;
         } else {
@@ -704,15 +808,15 @@ roaring_array_t *ra_portable_deserialize(const char *buf) {
     bool hasrun = (cookie & 0xFFFF) == SERIAL_COOKIE;
     if (hasrun) {
         int32_t s = (size + 7) / 8;
-        bitmapOfRunContainers = malloc((size + 7) / 8);
+        bitmapOfRunContainers = roaring_malloc((size + 7) / 8);
         assert(bitmapOfRunContainers != NULL);  // todo: handle
         memcpy(bitmapOfRunContainers, buf, s);
         buf += s;
     }
     uint16_t *keys = answer->keys;
-    int32_t *cardinalities = malloc(size * sizeof(int32_t));
+    int32_t *cardinalities = roaring_malloc(size * sizeof(int32_t));
     assert(cardinalities != NULL);  // todo: handle
-    bool *isBitmap = malloc(size * sizeof(bool));
+    bool *isBitmap = roaring_malloc(size * sizeof(bool));
     assert(isBitmap != NULL);  // todo: handle
     uint16_t tmp;
     for (int32_t k = 0; k < size; ++k) {
@@ -755,9 +859,10 @@ roaring_array_t *ra_portable_deserialize(const char *buf) {
             answer->typecodes[k] = ARRAY_CONTAINER_TYPE_CODE;
         }
     }
-    free(bitmapOfRunContainers);
-    free(cardinalities);
-    free(isBitmap);
+    roaring_free(bitmapOfRunContainers);
+    roaring_free(cardinalities);
+    roaring_free(isBitmap);
+    ra_key_index_reset(answer);
     return answer;
 }
 
@@ -0,0 +1,401 @@
+/*
+ * roaring_bsi.c
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset_util.h"
+#include "containers/containers.h"
+#include "roaring_bsi.h"
+#include "roaring_expression.h"
+
+enum {
+    // an operand known to be empty, not a node of the expression
+    BSI_EMPTY = -2,
+    BSI_WORDS = BITSET_CONTAINER_SIZE_IN_WORDS
+};
+
+roaring_bsi_t *roaring_bsi_create(void) {
+    roaring_bsi_t *b = roaring_malloc(sizeof(roaring_bsi_t));
+    if (b == NULL) return NULL;
+    b->ebm = roaring_bitmap_create();
+    if (b->ebm == NULL) {
+        roaring_free(b);
+        return NULL;
+    }
+    b->bit_depth = 0;
+    return b;
+}
+
+void roaring_bsi_free(roaring_bsi_t *b) {
+    if (b == NULL) return;
+    roaring_bitmap_free(b->ebm);
+    for (int32_t i = 0; i < b->bit_depth; ++i) roaring_bitmap_free(b->slices[i]);
+    roaring_free(b);
+}
+
+/* allocate the slices needed for value */
+static bool bsi_grow(roaring_bsi_t *b, uint64_t value) {
+    const int32_t depth = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    while (b->bit_depth < depth) {
+        roaring_bitmap_t *slice = roaring_bitmap_create();
+        if (slice == NULL) return false;
+        b->slices[b->bit_depth++] = slice;
+    }
+    return true;
+}
+
+void roaring_bsi_set_value(roaring_bsi_t *b, uint32_t column, uint64_t value) {
+    if (!bsi_grow(b, value)) return;
+    const bool existed = roaring_bitmap_contains(b->ebm, column);
+    if (!existed) roaring_bitmap_add(b->ebm, column);
+    for (int32_t i = 0; i < b->bit_depth; ++i) {
+        if ((value >> i) & 1)
+            roaring_bitmap_add(b->slices[i], column);
+        else if (existed)
+            roaring_bitmap_remove(b->slices[i], column);
+    }
+}
+
+bool roaring_bsi_get_value(const roaring_bsi_t *b, uint32_t column,
+                           uint64_t *value) {
+    if (!roaring_bitmap_contains(b->ebm, column)) return false;
+    uint64_t v = 0;
+    for (int32_t i = 0; i < b->bit_depth; ++i)
+        if (roaring_bitmap_contains(b->slices[i], column)) v |= UINT64_C(1) << i;
+    *value = v;
+    return true;
+}
+
+/* append the bits of words to r as the container of this key, if any */
+static bool bsi_append_words(roaring_bitmap_t *r, uint16_t key,
+                             const uint64_t *words) {
+    bitset_container_t *bitset = bitset_container_create();
+    if (bitset == NULL) return false;
+    memcpy(bitset->array, words, BSI_WORDS * sizeof(uint64_t));
+    bitset->cardinality = bitset_container_compute_cardinality(bitset);
+    void *c = bitset;
+    uint8_t typecode = BITSET_CONTAINER_TYPE_CODE;
+    if (bitset->cardinality == 0) {
+        bitset_container_free(bitset);
+        return true;
+    }
+    if (bitset->cardinality <= DEFAULT_MAX_SIZE) {
+        c = array_container_from_bitset(bitset);
+        typecode = ARRAY_CONTAINER_TYPE_CODE;
+        bitset_container_free(bitset);
+        if (c == NULL) return false;
+    }
+    ra_append(r->high_low_container, key, c, typecode);
+    return true;
+}
+
+bool roaring_bsi_append(roaring_bsi_t *b, uint32_t first_column,
+                        const uint64_t *values, uint32_t count) {
+    const roaring_array_t *ebm = b->ebm->high_low_container;
+    if ((first_column & 0xFFFF) != 0 ||
+        (ebm->size > 0 && ebm->keys[ebm->size - 1] >= (first_column >> 16)) ||
+        (count > 0 && count - 1 > UINT32_MAX - first_column))
+        return false;
+    uint64_t all = 0;
+    for (uint32_t i = 0; i < count; ++i) all |= values[i];
+    if (!bsi_grow(b, all)) return false;
+    // the containers of one key: the existence bits, then the slices
+    uint64_t *words =
+        roaring_malloc((b->bit_depth + 1) * BSI_WORDS * sizeof(uint64_t));
+    if (words == NULL) return false;
+    bool ok = true;
+    for (uint64_t start = 0; ok && start < count; start += 1 << 16) {
+        const uint32_t n = count - start < (1 << 16) ? count - start : 1 << 16;
+        memset(words, 0, (b->bit_depth + 1) * BSI_WORDS * sizeof(uint64_t));
+        bitset_set_range(words, 0, n);
+        for (uint32_t j = 0; j < n; ++j) {
+            const uint64_t bit = UINT64_C(1) << (j & 63);
+            for (uint64_t v = values[start + j]; v != 0; v &= v - 1)
+                words[(1 + __builtin_ctzll(v)) * BSI_WORDS + (j >> 6)] |= bit;
+        }
+        const uint16_t key = (uint16_t)((first_column + start) >> 16);
+        ok = bsi_append_words(b->ebm, key, words);
+        for (int32_t i = 0; ok && i < b->bit_depth; ++i)
+            ok = bsi_append_words(b->slices[i], key,
+                                  words + (1 + i) * BSI_WORDS);
+    }
+    roaring_free(words);
+    return ok;
+}
+
+/* Node helpers that know about BSI_EMPTY. A failure (-1) is carried
+ * through since roaring_expression_* reject a -1 operand. */
+static int32_t bsi_or(roaring_expression_t *e, int32_t left, int32_t right) {
+    if (left == BSI_EMPTY) return right;
+    if (right == BSI_EMPTY) return left;
+    return roaring_expression_or(e, left, right);
+}
+
+static int32_t bsi_and(roaring_expression_t *e, int32_t left, int32_t right) {
+    if (left == BSI_EMPTY || right == BSI_EMPTY) return BSI_EMPTY;
+    return roaring_expression_and(e, left, right);
+}
+
+static int32_t bsi_andnot(roaring_expression_t *e, int32_t left,
+                          int32_t right) {
+    if (left == BSI_EMPTY) return BSI_EMPTY;
+    if (right == BSI_EMPTY) return left;
+    return roaring_expression_andnot(e, left, right);
+}
+
+/* Make an expression whose nodes 0 .. bit_depth - 1 are the slices, and set
+ * *start to the node of the columns to consider. */
+static roaring_expression_t *bsi_expression(const roaring_bsi_t *b,
+                                            const roaring_bitmap_t *foundset,
+                                            int32_t *start) {
+    roaring_expression_t *e = roaring_expression_create();
+    if (e == NULL) return NULL;
+    for (int32_t i = 0; i < b->bit_depth; ++i)
+        roaring_expression_bitmap(e, b->slices[i]);
+    *start = roaring_expression_bitmap(e, b->ebm);
+    if (foundset != NULL)
+        *start = roaring_expression_and(e, *start,
+                                        roaring_expression_bitmap(e, foundset));
+    return e;
+}
+
+typedef struct bsi_nodes_s {
+    int32_t lt;
+    int32_t eq;
+    int32_t gt;
+} bsi_nodes_t;
+
+/* The columns of start whose value is less than, equal to or greater than
+ * value, from the most significant slice down. */
+static bsi_nodes_t bsi_compare_nodes(roaring_expression_t *e,
+                                     const roaring_bsi_t *b, int32_t start,
+                                     uint64_t value) {
+    bsi_nodes_t n = {BSI_EMPTY, start, BSI_EMPTY};
+    if (b->bit_depth < 64 && (value >> b->bit_depth) != 0) {
+        n.lt = start;  // value has more bits than any column
+        n.eq = BSI_EMPTY;
+        return n;
+    }
+    for (int32_t i = b->bit_depth - 1; i >= 0; --i) {
+        if ((value >> i) & 1) {
+            n.lt = bsi_or(e, n.lt, bsi_andnot(e, n.eq, i));
+            n.eq = bsi_and(e, n.eq, i);
+        } else {
+            n.gt = bsi_or(e, n.gt, bsi_and(e, n.eq, i));
+            n.eq = bsi_andnot(e, n.eq, i);
+        }
+    }
+    return n;
+}
+
+static int32_t bsi_operation_node(roaring_expression_t *e, bsi_nodes_t n,
+                                  roaring_bsi_operation_t op) {
+    switch (op) {
+        case ROARING_BSI_LT:
+            return n.lt;
+        case ROARING_BSI_LE:
+            return bsi_or(e, n.lt, n.eq);
+        case ROARING_BSI_EQ:
+            return n.eq;
+        case ROARING_BSI_GE:
+            return bsi_or(e, n.gt, n.eq);
+        case ROARING_BSI_GT:
+            return n.gt;
+    }
+    return -1;
+}
+
+static roaring_bitmap_t *bsi_evaluate(roaring_expression_t *e, int32_t node) {
+    roaring_bitmap_t *answer = NULL;
+    if (node == BSI_EMPTY)
+        answer = roaring_bitmap_create();
+    else if (node >= 0)
+        answer = roaring_expression_evaluate(e, node);
+    roaring_expression_free(e);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bsi_compare(const roaring_bsi_t *b,
+                                      roaring_bsi_operation_t op,
+                                      uint64_t value,
+                                      const roaring_bitmap_t *foundset) {
+    int32_t start;
+    roaring_expression_t *e = bsi_expression(b, foundset, &start);
+    if (e == NULL) return NULL;
+    const bsi_nodes_t n = bsi_compare_nodes(e, b, start, value);
+    return bsi_evaluate(e, bsi_operation_node(e, n, op));
+}
+
+roaring_bitmap_t *roaring_bsi_range(const roaring_bsi_t *b, uint64_t low,
+                                    uint64_t high,
+                                    const roaring_bitmap_t *foundset) {
+    if (low > high) return roaring_bitmap_create();
+    int32_t start;
+    roaring_expression_t *e = bsi_expression(b, foundset, &start);
+    if (e == NULL) return NULL;
+    const bsi_nodes_t from = bsi_compare_nodes(e, b, start, low);
+    const bsi_nodes_t to = bsi_compare_nodes(e, b, start, high);
+    return bsi_evaluate(
+        e, bsi_and(e, bsi_operation_node(e, from, ROARING_BSI_GE),
+                   bsi_operation_node(e, to, ROARING_BSI_LE)));
+}
+
+/* load a container into words */
+static void bsi_load_words(uint64_t *words, const void *c, uint8_t typecode) {
+    c = container_unwrap_shared(c, &typecode);
+    if (typecode == BITSET_CONTAINER_TYPE_CODE) {
+        memcpy(words, ((const bitset_container_t *)c)->array,
+               BSI_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(words, 0, BSI_WORDS * sizeof(uint64_t));
+    if (typecode == ARRAY_CONTAINER_TYPE_CODE) {
+        const array_container_t *ac = (const array_container_t *)c;
+        bitset_set_list(words, ac->array, ac->cardinality);
+    } else {
+        const run_container_t *rc = (const run_container_t *)c;
+        for (int32_t i = 0; i < rc->n_runs; ++i)
+            bitset_set_range(words, rc->runs[i].value,
+                             rc->runs[i].value + rc->runs[i].length + 1);
+    }
+}
+
+/* number of bits of words in [start, end) */
+static uint64_t bsi_range_count(const uint64_t *words, uint32_t start,
+                                uint32_t end) {
+    const uint32_t first = start >> 6, last = (end - 1) >> 6;
+    const uint64_t lo = ~UINT64_C(0) << (start & 63);
+    const uint64_t hi = ~UINT64_C(0) >> ((-end) & 63);
+    if (first == last) return __builtin_popcountll(words[first] & lo & hi);
+    uint64_t count = __builtin_popcountll(words[first] & lo) +
+                     __builtin_popcountll(words[last] & hi);
+    for (uint32_t w = first + 1; w < last; ++w)
+        count += __builtin_popcountll(words[w]);
+    return count;
+}
+
+/* number of values of the container that are set in words */
+static uint64_t bsi_and_count(const uint64_t *words, const void *c,
+                              uint8_t typecode) {
+    c = container_unwrap_shared(c, &typecode);
+    uint64_t count = 0;
+    if (typecode == BITSET_CONTAINER_TYPE_CODE) {
+        const uint64_t *array = ((const bitset_container_t *)c)->array;
+        for (int32_t w = 0; w < BSI_WORDS; ++w)
+            count += __builtin_popcountll(words[w] & array[w]);
+    } else if (typecode == ARRAY_CONTAINER_TYPE_CODE) {
+        const array_container_t *ac = (const array_container_t *)c;
+        for (int32_t i = 0; i < ac->cardinality; ++i)
+            count += (words[ac->array[i] >> 6] >> (ac->array[i] & 63)) & 1;
+    } else {
+        const run_container_t *rc = (const run_container_t *)c;
+        for (int32_t i = 0; i < rc->n_runs; ++i)
+            count += bsi_range_count(words, rc->runs[i].value,
+                                     rc->runs[i].value + rc->runs[i].length +
+                                         1);
+    }
+    return count;
+}
+
+uint64_t roaring_bsi_sum(const roaring_bsi_t *b,
+                         const roaring_bitmap_t *foundset, uint64_t *count) {
+    uint64_t sum = 0, n = 0;
+    if (foundset == NULL) {
+        // the slices only hold columns with a value
+        for (int32_t i = 0; i < b->bit_depth; ++i)
+            sum += roaring_bitmap_get_cardinality(b->slices[i]) << i;
+        if (count != NULL) *count = roaring_bitmap_get_cardinality(b->ebm);
+        return sum;
+    }
+    uint64_t *words = roaring_malloc(2 * BSI_WORDS * sizeof(uint64_t));
+    if (words == NULL) return 0;
+    uint64_t *other = words + BSI_WORDS;
+    roaring_array_t *ebm = b->ebm->high_low_container;
+    roaring_array_t *fs = foundset->high_low_container;
+    int32_t pos = 0;
+    for (int32_t k = 0; k < ebm->size; ++k) {
+        const uint16_t key = ebm->keys[k];
+        pos = ra_advance_until(fs, key, pos - 1);
+        if (pos == fs->size) break;
+        if (fs->keys[pos] != key) continue;
+        // words: the columns of this key to add up
+        bsi_load_words(words, ebm->containers[k], ebm->typecodes[k]);
+        bsi_load_words(other, fs->containers[pos], fs->typecodes[pos]);
+        for (int32_t w = 0; w < BSI_WORDS; ++w) words[w] &= other[w];
+        n += bsi_range_count(words, 0, 1 << 16);
+        for (int32_t i = 0; i < b->bit_depth; ++i) {
+            roaring_array_t *slice = b->slices[i]->high_low_container;
+            const int32_t s = ra_get_index(slice, key);
+            if (s >= 0)
+                sum += bsi_and_count(words, slice->containers[s],
+                                     slice->typecodes[s])
+                       << i;
+        }
+    }
+    roaring_free(words);
+    if (count != NULL) *count = n;
+    return sum;
+}
+
+/* left & ~right, as a two-leaf expression */
+static roaring_bitmap_t *bsi_bitmap_andnot(const roaring_bitmap_t *left,
+                                           const roaring_bitmap_t *right) {
+    roaring_expression_t *e = roaring_expression_create();
+    if (e == NULL) return NULL;
+    const int32_t l = roaring_expression_bitmap(e, left);
+    return bsi_evaluate(
+        e, roaring_expression_andnot(e, l, roaring_expression_bitmap(e, right)));
+}
+
+roaring_bitmap_t *roaring_bsi_top_k(const roaring_bsi_t *b, uint64_t k,
+                                    const roaring_bitmap_t *foundset) {
+    // greater: the columns known to be in the top k; ties: the columns whose
+    // bits, so far, are those of the k-th largest value
+    roaring_bitmap_t *greater = roaring_bitmap_create();
+    roaring_bitmap_t *ties = foundset == NULL
+                                 ? roaring_bitmap_copy(b->ebm)
+                                 : roaring_bitmap_and(b->ebm, foundset);
+    if (greater == NULL || ties == NULL) goto fail;
+    if (roaring_bitmap_get_cardinality(ties) <= k) {
+        roaring_bitmap_free(greater);
+        return ties;
+    }
+    uint64_t ngreater = 0;
+    for (int32_t i = b->bit_depth - 1; i >= 0 && ngreater < k; --i) {
+        roaring_bitmap_t *set = roaring_bitmap_and(ties, b->slices[i]);
+        if (set == NULL) goto fail;
+        const uint64_t nset = roaring_bitmap_get_cardinality(set);
+        if (ngreater + nset > k) {
+            roaring_bitmap_free(ties);
+            ties = set;
+            continue;
+        }
+        // all of set is in the top k
+        roaring_bitmap_t *unset = ngreater + nset == k
+                                      ? roaring_bitmap_create()  // done
+                                      : bsi_bitmap_andnot(ties, set);
+        roaring_bitmap_or_inplace(greater, set);
+        roaring_bitmap_free(set);
+        roaring_bitmap_free(ties);
+        ties = unset;
+        if (ties == NULL) goto fail;
+        ngreater += nset;
+    }
+    // fill up with the smallest tied columns
+    if (ngreater < k) {
+        uint32_t nties;
+        uint32_t *values = roaring_bitmap_to_uint32_array(ties, &nties);
+        for (uint64_t j = 0; j < k - ngreater && j < nties; ++j)
+            roaring_bitmap_add(greater, values[j]);
+        free(values);
+    }
+    roaring_bitmap_free(ties);
+    return greater;
+fail:
+    if (greater != NULL) roaring_bitmap_free(greater);
+    if (ties != NULL) roaring_bitmap_free(ties);
+    return NULL;
+}
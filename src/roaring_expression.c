@@ -0,0 +1,494 @@
+/*
+ * roaring_expression.c
+ *
+ */
+
+#include <string.h>
+
+#include "bitset_util.h"
+#include "containers/containers.h"
+#include "containers/mixed_union.h"
+#include "roaring_expression.h"
+
+enum {
+    EXPR_BITMAP,
+    EXPR_AND,
+    EXPR_OR,
+    EXPR_XOR,
+    EXPR_ANDNOT,
+    KEY_MASK_WORDS = (1 << 16) / 64
+};
+
+typedef struct expr_node_s {
+    uint8_t op;
+    int32_t left;
+    int32_t right;
+    const roaring_bitmap_t *bitmap;  // EXPR_BITMAP only
+} expr_node_t;
+
+struct roaring_expression_s {
+    expr_node_t *nodes;
+    int32_t size;
+    int32_t capacity;
+};
+
+roaring_expression_t *roaring_expression_create(void) {
+    roaring_expression_t *e = roaring_malloc(sizeof(roaring_expression_t));
+    if (e == NULL) return NULL;
+    e->nodes = NULL;
+    e->size = 0;
+    e->capacity = 0;
+    return e;
+}
+
+void roaring_expression_free(roaring_expression_t *e) {
+    if (e == NULL) return;
+    roaring_free(e->nodes);
+    roaring_free(e);
+}
+
+static int32_t expr_add_node(roaring_expression_t *e, uint8_t op,
+                             int32_t left, int32_t right,
+                             const roaring_bitmap_t *bitmap) {
+    if (op == EXPR_BITMAP ? bitmap == NULL
+                          : (left < 0 || left >= e->size || right < 0 ||
+                             right >= e->size))
+        return -1;
+    if (e->size == e->capacity) {
+        const int32_t newcapacity = e->capacity == 0 ? 16 : 2 * e->capacity;
+        expr_node_t *nodes =
+            roaring_realloc(e->nodes, newcapacity * sizeof(expr_node_t));
+        if (nodes == NULL) return -1;
+        e->nodes = nodes;
+        e->capacity = newcapacity;
+    }
+    expr_node_t *n = &e->nodes[e->size];
+    n->op = op;
+    n->left = left;
+    n->right = right;
+    n->bitmap = bitmap;
+    return e->size++;
+}
+
+int32_t roaring_expression_bitmap(roaring_expression_t *e,
+                                  const roaring_bitmap_t *r) {
+    return expr_add_node(e, EXPR_BITMAP, -1, -1, r);
+}
+
+int32_t roaring_expression_and(roaring_expression_t *e, int32_t left,
+                               int32_t right) {
+    return expr_add_node(e, EXPR_AND, left, right, NULL);
+}
+
+int32_t roaring_expression_or(roaring_expression_t *e, int32_t left,
+                              int32_t right) {
+    return expr_add_node(e, EXPR_OR, left, right, NULL);
+}
+
+int32_t roaring_expression_xor(roaring_expression_t *e, int32_t left,
+                               int32_t right) {
+    return expr_add_node(e, EXPR_XOR, left, right, NULL);
+}
+
+int32_t roaring_expression_andnot(roaring_expression_t *e, int32_t left,
+                                  int32_t right) {
+    return expr_add_node(e, EXPR_ANDNOT, left, right, NULL);
+}
+
+/* The value of a node for the current key: nothing (container == NULL), a
+ * container of one of the bitmaps (borrowed) or a scratch bitset. */
+typedef struct expr_value_s {
+    const void *container;
+    uint8_t typecode;
+    int32_t scratch;  // index of the scratch bitset, or -1
+} expr_value_t;
+
+typedef struct expr_scratch_s {
+    bitset_container_t *bitset;  // NULL once handed over to the answer
+    int32_t readers;             // reads still to come for this key
+} expr_scratch_t;
+
+typedef struct expr_eval_s {
+    const expr_node_t *nodes;
+    int32_t *uses;       // how many times the value of a node is read
+    int32_t *slot;       // index of the key mask of a node
+    uint64_t *keymasks;  // keys for which a node may be non-empty
+    int32_t *position;   // index of the last container used, bitmap nodes
+    uint32_t *stamp;     // 1 + the key for which values[i] was computed
+    expr_value_t *values;
+    expr_scratch_t *scratch;
+    int32_t *free_scratch;
+    int32_t n_scratch;
+    int32_t n_free;
+    uint16_t *buffer;  // room for the values of any array container
+} expr_eval_t;
+
+static void expr_eval_free(expr_eval_t *ev) {
+    if (ev->scratch != NULL) {
+        for (int32_t s = 0; s < ev->n_scratch; ++s)
+            if (ev->scratch[s].bitset != NULL)
+                bitset_container_free(ev->scratch[s].bitset);
+    }
+    roaring_free(ev->uses);
+    roaring_free(ev->slot);
+    roaring_free(ev->keymasks);
+    roaring_free(ev->position);
+    roaring_free(ev->stamp);
+    roaring_free(ev->values);
+    roaring_free(ev->scratch);
+    roaring_free(ev->free_scratch);
+    roaring_free(ev->buffer);
+}
+
+static inline uint64_t *expr_keymask(const expr_eval_t *ev, int32_t i) {
+    return ev->keymasks + (size_t)ev->slot[i] * KEY_MASK_WORDS;
+}
+
+/* Count the reads of every node reachable from root and compute, for each
+ * of them, the keys where it may be non-empty. */
+static bool expr_eval_init(expr_eval_t *ev, const roaring_expression_t *e,
+                           int32_t root) {
+    memset(ev, 0, sizeof(*ev));
+    const int32_t n = root + 1;
+    ev->nodes = e->nodes;
+    ev->uses = roaring_calloc(n, sizeof(int32_t));
+    ev->slot = roaring_malloc(n * sizeof(int32_t));
+    ev->position = roaring_malloc(n * sizeof(int32_t));
+    ev->stamp = roaring_calloc(n, sizeof(uint32_t));
+    ev->values = roaring_malloc(n * sizeof(expr_value_t));
+    ev->buffer = roaring_malloc((1 << 16) * sizeof(uint16_t));
+    if (ev->uses == NULL || ev->slot == NULL || ev->position == NULL ||
+        ev->stamp == NULL || ev->values == NULL || ev->buffer == NULL)
+        return false;
+    ev->uses[root] = 1;  // read once more when the answer is written
+    int32_t reachable = 0, internal = 0;
+    for (int32_t i = root; i >= 0; --i) {  // operands come before their users
+        ev->slot[i] = -1;
+        ev->position[i] = -1;
+        if (ev->uses[i] == 0) continue;
+        ev->slot[i] = reachable++;
+        if (e->nodes[i].op != EXPR_BITMAP) {
+            internal++;
+            ev->uses[e->nodes[i].left]++;
+            ev->uses[e->nodes[i].right]++;
+        }
+    }
+    ev->keymasks =
+        roaring_malloc((size_t)reachable * KEY_MASK_WORDS * sizeof(uint64_t));
+    ev->scratch = roaring_calloc(internal > 0 ? internal : 1,
+                                 sizeof(expr_scratch_t));
+    ev->free_scratch =
+        roaring_malloc((internal > 0 ? internal : 1) * sizeof(int32_t));
+    if (ev->keymasks == NULL || ev->scratch == NULL ||
+        ev->free_scratch == NULL)
+        return false;
+    ev->n_scratch = internal;
+    for (int32_t i = 0; i < n; ++i) {
+        if (ev->slot[i] < 0) continue;
+        const expr_node_t *node = &e->nodes[i];
+        uint64_t *mask = expr_keymask(ev, i);
+        if (node->op == EXPR_BITMAP) {
+            const roaring_array_t *ra = node->bitmap->high_low_container;
+            memset(mask, 0, KEY_MASK_WORDS * sizeof(uint64_t));
+            for (int32_t k = 0; k < ra->size; ++k)
+                mask[ra->keys[k] >> 6] |= UINT64_C(1) << (ra->keys[k] & 63);
+            continue;
+        }
+        const uint64_t *l = expr_keymask(ev, node->left);
+        const uint64_t *r = expr_keymask(ev, node->right);
+        for (int32_t w = 0; w < KEY_MASK_WORDS; ++w) {
+            switch (node->op) {
+                case EXPR_AND:
+                    mask[w] = l[w] & r[w];
+                    break;
+                case EXPR_OR:
+                case EXPR_XOR:
+                    mask[w] = l[w] | r[w];
+                    break;
+                default:  // EXPR_ANDNOT
+                    mask[w] = l[w];
+            }
+        }
+    }
+    return true;
+}
+
+/* all the scratch bitsets are free again */
+static void expr_eval_next_key(expr_eval_t *ev) {
+    for (int32_t s = 0; s < ev->n_scratch; ++s) {
+        ev->scratch[s].readers = 0;
+        ev->free_scratch[s] = s;
+    }
+    ev->n_free = ev->n_scratch;
+}
+
+static int32_t expr_acquire_scratch(expr_eval_t *ev) {
+    const int32_t s = ev->free_scratch[--ev->n_free];
+    if (ev->scratch[s].bitset == NULL) {
+        ev->scratch[s].bitset = bitset_container_create();
+        if (ev->scratch[s].bitset == NULL) return -1;
+    }
+    return s;
+}
+
+/* done reading v */
+static inline void expr_release(expr_eval_t *ev, const expr_value_t *v) {
+    if (v->scratch >= 0 && --ev->scratch[v->scratch].readers == 0)
+        ev->free_scratch[ev->n_free++] = v->scratch;
+}
+
+/* The kernels below leave the cardinality of dst unknown. */
+
+static void expr_or_into(bitset_container_t *dst, const void *c,
+                         uint8_t typecode) {
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            bitset_container_or_nocard(dst, (const bitset_container_t *)c,
+                                       dst);
+            return;
+        case ARRAY_CONTAINER_TYPE_CODE:
+            array_bitset_container_lazy_union((const array_container_t *)c,
+                                              dst, dst);
+            return;
+        default: {  // RUN_CONTAINER_TYPE_CODE
+            const run_container_t *run = (const run_container_t *)c;
+            for (int32_t i = 0; i < run->n_runs; ++i)
+                bitset_set_range(dst->array, run->runs[i].value,
+                                 run->runs[i].value + run->runs[i].length +
+                                     UINT32_C(1));
+        }
+    }
+}
+
+static void expr_and_into(bitset_container_t *dst, const void *c,
+                          uint8_t typecode, uint16_t *buffer) {
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            bitset_container_and_nocard(dst, (const bitset_container_t *)c,
+                                        dst);
+            return;
+        case ARRAY_CONTAINER_TYPE_CODE: {
+            const array_container_t *array = (const array_container_t *)c;
+            int32_t n = 0;
+            for (int32_t i = 0; i < array->cardinality; ++i)
+                if (bitset_container_get(dst, array->array[i]))
+                    buffer[n++] = array->array[i];
+            bitset_container_clear(dst);
+            bitset_set_list(dst->array, buffer, n);
+            return;
+        }
+        default: {  // RUN_CONTAINER_TYPE_CODE: clear the gaps
+            const run_container_t *run = (const run_container_t *)c;
+            uint32_t start = 0;
+            for (int32_t i = 0; i < run->n_runs; ++i) {
+                bitset_reset_range(dst->array, start, run->runs[i].value);
+                start = run->runs[i].value + run->runs[i].length + 1;
+            }
+            bitset_reset_range(dst->array, start, UINT32_C(1) << 16);
+        }
+    }
+}
+
+static void expr_xor_into(bitset_container_t *dst, const void *c,
+                          uint8_t typecode) {
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            bitset_container_xor_nocard(dst, (const bitset_container_t *)c,
+                                        dst);
+            return;
+        case ARRAY_CONTAINER_TYPE_CODE: {
+            const array_container_t *array = (const array_container_t *)c;
+            for (int32_t i = 0; i < array->cardinality; ++i)
+                dst->array[array->array[i] >> 6] ^=
+                    UINT64_C(1) << (array->array[i] & 63);
+            return;
+        }
+        default: {  // RUN_CONTAINER_TYPE_CODE
+            const run_container_t *run = (const run_container_t *)c;
+            for (int32_t i = 0; i < run->n_runs; ++i)
+                bitset_flip_range(dst->array, run->runs[i].value,
+                                  run->runs[i].value + run->runs[i].length +
+                                      UINT32_C(1));
+        }
+    }
+}
+
+static void expr_andnot_into(bitset_container_t *dst, const void *c,
+                             uint8_t typecode) {
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE_CODE:
+            bitset_container_andnot_nocard(dst, (const bitset_container_t *)c,
+                                           dst);
+            return;
+        case ARRAY_CONTAINER_TYPE_CODE: {
+            const array_container_t *array = (const array_container_t *)c;
+            bitset_clear_list(dst->array, 0, array->array, array->cardinality);
+            return;
+        }
+        default: {  // RUN_CONTAINER_TYPE_CODE
+            const run_container_t *run = (const run_container_t *)c;
+            for (int32_t i = 0; i < run->n_runs; ++i)
+                bitset_reset_range(dst->array, run->runs[i].value,
+                                   run->runs[i].value + run->runs[i].length +
+                                       UINT32_C(1));
+        }
+    }
+}
+
+static void expr_load(bitset_container_t *dst, const expr_value_t *v,
+                      const expr_eval_t *ev) {
+    if (v->scratch >= 0) {
+        bitset_container_copy(ev->scratch[v->scratch].bitset, dst);
+    } else if (v->typecode == BITSET_CONTAINER_TYPE_CODE) {
+        bitset_container_copy((const bitset_container_t *)v->container, dst);
+    } else {
+        bitset_container_clear(dst);
+        expr_or_into(dst, v->container, v->typecode);
+    }
+}
+
+/* Compute the value of node i for the given key (at most once per key).
+ * Returns false in case of failure. */
+static bool expr_evaluate_node(expr_eval_t *ev, int32_t i, uint16_t key) {
+    expr_value_t *v = &ev->values[i];
+    if (ev->stamp[i] == key + UINT32_C(1)) return true;
+    ev->stamp[i] = key + UINT32_C(1);
+    v->container = NULL;
+    v->scratch = -1;
+    const uint64_t *mask = expr_keymask(ev, i);
+    if ((mask[key >> 6] & (UINT64_C(1) << (key & 63))) == 0) return true;
+    const expr_node_t *node = &ev->nodes[i];
+    if (node->op == EXPR_BITMAP) {
+        roaring_array_t *ra = node->bitmap->high_low_container;
+        // keys come in increasing order and the mask says that this one is
+        // there
+        const int32_t pos = ra_advance_until(ra, key, ev->position[i]);
+        ev->position[i] = pos;
+        v->typecode = ra->typecodes[pos];
+        v->container = container_unwrap_shared(ra->containers[pos],
+                                               &v->typecode);
+        return true;
+    }
+    if (!expr_evaluate_node(ev, node->left, key)) return false;
+    const expr_value_t *a = &ev->values[node->left];
+    if (a->container == NULL && node->op != EXPR_OR && node->op != EXPR_XOR)
+        return true;  // and, andnot: nothing left
+    if (!expr_evaluate_node(ev, node->right, key)) return false;
+    const expr_value_t *b = &ev->values[node->right];
+    const expr_value_t *passed = NULL;
+    if (b->container == NULL) {
+        if (node->op == EXPR_AND) {
+            expr_release(ev, a);
+            return true;
+        }
+        passed = a;
+    } else if (a->container == NULL) {
+        passed = b;
+    }
+    if (passed != NULL) {  // the value of an operand, as is
+        *v = *passed;
+        if (v->scratch >= 0) ev->scratch[v->scratch].readers += ev->uses[i] - 1;
+        return true;
+    }
+    // reuse the scratch of an operand if nobody else is going to read it
+    const expr_value_t *other;
+    int32_t s;
+    if (a->scratch >= 0 && ev->scratch[a->scratch].readers == 1) {
+        s = a->scratch;
+        other = b;
+    } else if (node->op != EXPR_ANDNOT && b->scratch >= 0 &&
+               ev->scratch[b->scratch].readers == 1) {
+        s = b->scratch;
+        other = a;
+    } else {
+        s = expr_acquire_scratch(ev);
+        if (s < 0) return false;
+        expr_load(ev->scratch[s].bitset, a, ev);
+        expr_release(ev, a);
+        other = b;
+    }
+    bitset_container_t *dst = ev->scratch[s].bitset;
+    const void *c = other->scratch >= 0 ? ev->scratch[other->scratch].bitset
+                                        : other->container;
+    const uint8_t typecode = other->scratch >= 0 ? BITSET_CONTAINER_TYPE_CODE
+                                                 : other->typecode;
+    switch (node->op) {
+        case EXPR_AND:
+            expr_and_into(dst, c, typecode, ev->buffer);
+            break;
+        case EXPR_OR:
+            expr_or_into(dst, c, typecode);
+            break;
+        case EXPR_XOR:
+            expr_xor_into(dst, c, typecode);
+            break;
+        default:  // EXPR_ANDNOT
+            expr_andnot_into(dst, c, typecode);
+    }
+    expr_release(ev, other);
+    ev->scratch[s].readers = ev->uses[i];
+    v->container = dst;
+    v->typecode = BITSET_CONTAINER_TYPE_CODE;
+    v->scratch = s;
+    return true;
+}
+
+/* Append the value of the root for this key to the answer. */
+static bool expr_emit(expr_eval_t *ev, const expr_value_t *v, uint16_t key,
+                      roaring_array_t *answer) {
+    void *c = NULL;
+    uint8_t typecode = v->typecode;
+    if (v->scratch < 0) {
+        c = container_clone(v->container, v->typecode);
+        if (c == NULL) return false;
+    } else {
+        expr_scratch_t *scratch = &ev->scratch[v->scratch];
+        bitset_container_t *bitset = scratch->bitset;
+        bitset->cardinality = bitset_container_compute_cardinality(bitset);
+        if (bitset->cardinality == 0) {
+            expr_release(ev, v);
+            return true;
+        }
+        if (bitset->cardinality <= DEFAULT_MAX_SIZE) {
+            c = array_container_from_bitset(bitset);
+            typecode = ARRAY_CONTAINER_TYPE_CODE;
+            if (c == NULL) return false;
+        } else if (scratch->readers == 1) {
+            c = bitset;  // hand it over, a new one is made when needed
+            scratch->bitset = NULL;
+        } else {
+            c = bitset_container_clone(bitset);
+            if (c == NULL) return false;
+        }
+    }
+    expr_release(ev, v);
+    ra_append(answer, key, c, typecode);
+    return true;
+}
+
+roaring_bitmap_t *roaring_expression_evaluate(const roaring_expression_t *e,
+                                              int32_t node) {
+    ROARING_TRACE_OPERATION("roaring_expression_evaluate");
+    if (node < 0 || node >= e->size) return NULL;
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL) return NULL;
+    expr_eval_t ev;
+    bool ok = expr_eval_init(&ev, e, node);
+    const uint64_t *keys = ok ? expr_keymask(&ev, node) : NULL;
+    for (int32_t w = 0; ok && w < KEY_MASK_WORDS; ++w) {
+        for (uint64_t word = keys[w]; ok && word != 0; word &= word - 1) {
+            const uint16_t key = (uint16_t)(w * 64 + __builtin_ctzll(word));
+            expr_eval_next_key(&ev);
+            ok = expr_evaluate_node(&ev, node, key) &&
+                 (ev.values[node].container == NULL ||
+                  expr_emit(&ev, &ev.values[node], key,
+                            answer->high_low_container));
+        }
+    }
+    expr_eval_free(&ev);
+    if (!ok) {
+        roaring_bitmap_free(answer);
+        return NULL;
+    }
+    return answer;
+}
@@ -0,0 +1,181 @@
+/*
+ * roaring_index.c
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "containers/containers.h"
+#include "containers/perfparameters.h"
+#include "roaring.h"
+
+/* the container holding the sorted values lows[0 .. n - 1], which may repeat,
+ * as the smallest of an array, a bitset and a run container */
+static void *index_container(const uint32_t *lows, uint32_t n,
+                             uint8_t *typecode) {
+    int32_t card = 0, n_runs = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (i > 0 && lows[i] == lows[i - 1]) continue;
+        card++;
+        if (i == 0 || (uint16_t)lows[i] != (uint16_t)(lows[i - 1] + 1))
+            n_runs++;
+    }
+    const int32_t size_as_run = run_container_serialized_size_in_bytes(n_runs);
+    const int32_t size_as_other =
+        card <= DEFAULT_MAX_SIZE
+            ? array_container_serialized_size_in_bytes(card)
+            : bitset_container_serialized_size_in_bytes();
+    if (RUN_OPTI_MINIMAL_GAIN * size_as_run < size_as_other) {
+        run_container_t *run = run_container_create_given_capacity(n_runs);
+        if (run == NULL) return NULL;
+        for (uint32_t i = 0; i < n; ++i) {
+            const uint16_t low = (uint16_t)lows[i];
+            if (run->n_runs > 0) {
+                rle16_t *last = &run->runs[run->n_runs - 1];
+                if (low <= last->value + last->length + 1) {
+                    if (low == last->value + last->length + 1) last->length++;
+                    continue;
+                }
+            }
+            run->runs[run->n_runs].value = low;
+            run->runs[run->n_runs].length = 0;
+            run->n_runs++;
+        }
+        *typecode = RUN_CONTAINER_TYPE_CODE;
+        return run;
+    }
+    if (card <= DEFAULT_MAX_SIZE) {
+        array_container_t *array = array_container_create_given_capacity(card);
+        if (array == NULL) return NULL;
+        for (uint32_t i = 0; i < n; ++i)
+            if (i == 0 || lows[i] != lows[i - 1])
+                array->array[array->cardinality++] = (uint16_t)lows[i];
+        *typecode = ARRAY_CONTAINER_TYPE_CODE;
+        return array;
+    }
+    bitset_container_t *bitset = bitset_container_create();
+    if (bitset == NULL) return NULL;
+    for (uint32_t i = 0; i < n; ++i)
+        bitset->array[(uint16_t)lows[i] >> 6] |= UINT64_C(1)
+                                                 << (lows[i] & 63);
+    bitset->cardinality = card;
+    *typecode = BITSET_CONTAINER_TYPE_CODE;
+    return bitset;
+}
+
+/* the bitmap of the sorted rows[0 .. n - 1], one container per key */
+static roaring_bitmap_t *index_bitmap(const uint32_t *rows, uint32_t n) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    if (r == NULL) return NULL;
+    for (uint32_t start = 0; start < n;) {
+        const uint32_t key = rows[start] >> 16;
+        uint32_t end = start + 1;
+        while (end < n && rows[end] >> 16 == key) end++;
+        uint8_t typecode;
+        void *c = index_container(rows + start, end - start, &typecode);
+        if (c == NULL) {
+            roaring_bitmap_free(r);
+            return NULL;
+        }
+        ra_append(r->high_low_container, (uint16_t)key, c, typecode);
+        start = end;
+    }
+    return r;
+}
+
+/* order[0 .. n - 1] such that rows[order[i]] is sorted, by a stable radix
+ * sort on the low then the high 16 bits */
+static uint32_t *index_sort_rows(const uint32_t *rows, uint32_t n) {
+    uint32_t *order = roaring_malloc((2 * (size_t)n + 1) * sizeof(uint32_t));
+    uint32_t *counts = roaring_malloc((1 << 16) * sizeof(uint32_t));
+    if (order == NULL || counts == NULL) {
+        roaring_free(order);
+        roaring_free(counts);
+        return NULL;
+    }
+    uint32_t *from = order, *to = order + n;
+    for (uint32_t i = 0; i < n; ++i) from[i] = i;
+    for (int shift = 0; shift < 32; shift += 16) {
+        memset(counts, 0, (1 << 16) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; ++i)
+            counts[(uint16_t)(rows[i] >> shift)]++;
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < (1 << 16); ++d) {
+            const uint32_t count = counts[d];
+            counts[d] = offset;
+            offset += count;
+        }
+        for (uint32_t i = 0; i < n; ++i)
+            to[counts[(uint16_t)(rows[from[i]] >> shift)]++] = from[i];
+        uint32_t *tmp = from;
+        from = to;
+        to = tmp;
+    }
+    // after two passes the result is back in the first half
+    roaring_free(counts);
+    return order;
+}
+
+roaring_bitmap_t **roaring_bitmap_index_build(const uint32_t *values,
+                                              const uint32_t *rows, uint32_t n,
+                                              uint32_t number_of_values,
+                                              bool range_encoded) {
+    if (number_of_values == 0) return NULL;
+    uint32_t *offsets =
+        roaring_malloc(((size_t)number_of_values + 1) * sizeof(uint32_t));
+    if (offsets == NULL) return NULL;
+    memset(offsets, 0, ((size_t)number_of_values + 1) * sizeof(uint32_t));
+    bool sorted = true;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (values[i] >= number_of_values) {
+            roaring_free(offsets);
+            return NULL;
+        }
+        offsets[values[i] + 1]++;
+        if (rows != NULL && i > 0 && rows[i] < rows[i - 1]) sorted = false;
+    }
+    for (uint32_t v = 0; v < number_of_values; ++v)
+        offsets[v + 1] += offsets[v];
+    uint32_t *order = sorted ? NULL : index_sort_rows(rows, n);
+    uint32_t *bucketed = roaring_malloc(((size_t)n + 1) * sizeof(uint32_t));
+    // handed over to the caller: from malloc, as roaring_bitmap_to_uint32_array
+    roaring_bitmap_t **answer =
+        malloc((size_t)number_of_values * sizeof(roaring_bitmap_t *));
+    bool ok = (sorted || order != NULL) && bucketed != NULL && answer != NULL;
+    if (ok) {
+        // a stable counting sort on the value, visiting the rows in order
+        // so that the rows of each value come out sorted
+        uint32_t *next = offsets;
+        for (uint32_t i = 0; i < n; ++i) {
+            const uint32_t j = order == NULL ? i : order[i];
+            bucketed[next[values[j]]++] = rows == NULL ? j : rows[j];
+        }
+        // next[v] is now the start of v + 1, shift back
+        memmove(offsets + 1, offsets, number_of_values * sizeof(uint32_t));
+        offsets[0] = 0;
+    }
+    uint32_t built = 0;
+    for (; ok && built < number_of_values; ++built) {
+        roaring_bitmap_t *equal =
+            index_bitmap(bucketed + offsets[built],
+                         offsets[built + 1] - offsets[built]);
+        if (equal != NULL && range_encoded && built > 0) {
+            roaring_bitmap_t *below = answer[built - 1];
+            answer[built] = roaring_bitmap_or(below, equal);
+            roaring_bitmap_free(equal);
+        } else {
+            answer[built] = equal;
+        }
+        ok = answer[built] != NULL;
+    }
+    if (!ok && answer != NULL) {
+        for (uint32_t v = 0; v + 1 < built; ++v) roaring_bitmap_free(answer[v]);
+        free(answer);
+        answer = NULL;
+    }
+    roaring_free(bucketed);
+    roaring_free(order);
+    roaring_free(offsets);
+    return answer;
+}
@@ -0,0 +1,73 @@
+/*
+ * roaring_memory.c
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L  // posix_memalign
+#include <stdlib.h>
+
+#include "containers/pool.h"
+#include "roaring_memory.h"
+
+static void *default_aligned_malloc(size_t alignment, size_t size) {
+    void *p;
+    if (posix_memalign(&p, alignment, size)) return NULL;
+    return p;
+}
+
+static const roaring_memory_t default_memory_hook = {
+    .malloc = malloc,
+    .realloc = realloc,
+    .calloc = calloc,
+    .free = free,
+    .aligned_malloc = default_aligned_malloc,
+    .aligned_free = free,
+};
+
+static roaring_memory_t global_memory_hook = {
+    .malloc = malloc,
+    .realloc = realloc,
+    .calloc = calloc,
+    .free = free,
+    .aligned_malloc = default_aligned_malloc,
+    .aligned_free = free,
+};
+
+static _Thread_local const roaring_memory_t *thread_memory_hook = NULL;
+
+static inline const roaring_memory_t *current_hook(void) {
+    const roaring_memory_t *hook = thread_memory_hook;
+    return hook != NULL ? hook : &global_memory_hook;
+}
+
+void roaring_init_memory_hook(const roaring_memory_t *memory_hook) {
+    roaring_pool_trim(0);  // cached blocks belong to the previous allocator
+    global_memory_hook =
+        memory_hook != NULL ? *memory_hook : default_memory_hook;
+}
+
+void roaring_set_thread_memory_hook(const roaring_memory_t *memory_hook) {
+    thread_memory_hook = memory_hook;
+}
+
+bool roaring_has_thread_memory_hook(void) {
+    return thread_memory_hook != NULL;
+}
+
+void *roaring_malloc(size_t size) { return current_hook()->malloc(size); }
+
+void *roaring_realloc(void *ptr, size_t size) {
+    return current_hook()->realloc(ptr, size);
+}
+
+void *roaring_calloc(size_t nmemb, size_t size) {
+    return current_hook()->calloc(nmemb, size);
+}
+
+void roaring_free(void *ptr) { current_hook()->free(ptr); }
+
+void *roaring_aligned_malloc(size_t alignment, size_t size) {
+    return current_hook()->aligned_malloc(alignment, size);
+}
+
+void roaring_aligned_free(void *ptr) { current_hook()->aligned_free(ptr); }
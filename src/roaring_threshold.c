@@ -0,0 +1,324 @@
+
+
+
+/*
+ * roaring_threshold.c
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset_util.h"
+#include "containers/containers.h"
+#include "roaring.h"
+
+enum {
+    // ScanCount is used for a key when its containers hold fewer than
+    // this many values per container (on average)
+    SCANCOUNT_MAX_AVERAGE_CARDINALITY = 16,
+    // larger array containers are added to the bit-sliced counters as
+    // bitsets rather than one value at a time
+    SLICED_ARRAY_MAX_CARDINALITY = 256
+};
+
+typedef struct threshold_input_s {
+    const void *container;
+    uint8_t typecode;
+} threshold_input_t;
+
+/* buffers are allocated when first needed */
+typedef struct threshold_state_s {
+    uint32_t threshold;
+    int max_slices;     // enough for the largest number of containers
+    uint32_t *counts;   // ScanCount: one counter per value
+    uint16_t *reached;  // ScanCount: values reaching the threshold
+    uint64_t *slices;   // bit-sliced counters, one bitset per bit
+    uint64_t *words;    // a run container as a bitset
+    uint64_t *carry;
+} threshold_state_t;
+
+static int compare_uint16(const void *a, const void *b) {
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+static inline void scancount_add(threshold_state_t *st, int32_t *nreached,
+                                 uint16_t v) {
+    if (++st->counts[v] == st->threshold) st->reached[(*nreached)++] = v;
+}
+
+/* runs body with v set to each value of the container, in order */
+#define THRESHOLD_FOR_EACH_VALUE(input, v, body)                             \
+    do {                                                                     \
+        switch ((input)->typecode) {                                         \
+            case ARRAY_CONTAINER_TYPE_CODE: {                                \
+                const array_container_t *_a =                                \
+                    (const array_container_t *)(input)->container;           \
+                for (int32_t _i = 0; _i < _a->cardinality; ++_i) {           \
+                    const uint16_t v = _a->array[_i];                        \
+                    body;                                                    \
+                }                                                            \
+                break;                                                       \
+            }                                                                \
+            case RUN_CONTAINER_TYPE_CODE: {                                  \
+                const run_container_t *_r =                                  \
+                    (const run_container_t *)(input)->container;             \
+                for (int32_t _i = 0; _i < _r->n_runs; ++_i) {                \
+                    const uint32_t _end =                                    \
+                        _r->runs[_i].value + (uint32_t)_r->runs[_i].length;  \
+                    for (uint32_t _x = _r->runs[_i].value; _x <= _end;       \
+                         ++_x) {                                             \
+                        const uint16_t v = (uint16_t)_x;                     \
+                        body;                                                \
+                    }                                                        \
+                }                                                            \
+                break;                                                       \
+            }                                                                \
+            default: {                                                       \
+                const bitset_container_t *_b =                               \
+                    (const bitset_container_t *)(input)->container;          \
+                for (uint32_t _w = 0; _w < BITSET_CONTAINER_SIZE_IN_WORDS;   \
+                     ++_w) {                                                 \
+                    for (uint64_t _word = _b->array[_w]; _word != 0;         \
+                         _word &= _word - 1) {                               \
+                        const uint16_t v =                                   \
+                            (uint16_t)(_w * 64 + __builtin_ctzll(_word));    \
+                        body;                                                \
+                    }                                                        \
+                }                                                            \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+/* ScanCount: one counter per value, for sparse containers. Returns false
+ * in case of failure, *result is NULL if no value reaches the threshold. */
+static bool threshold_scancount(threshold_state_t *st,
+                                const threshold_input_t *inputs, int32_t m,
+                                void **result, uint8_t *typecode) {
+    if (st->counts == NULL) {
+        st->counts = roaring_calloc(1 << 16, sizeof(uint32_t));
+        st->reached = roaring_malloc((1 << 16) * sizeof(uint16_t));
+        if (st->counts == NULL || st->reached == NULL) return false;
+    }
+    int32_t nreached = 0;
+    for (int32_t i = 0; i < m; ++i)
+        THRESHOLD_FOR_EACH_VALUE(&inputs[i], v,
+                                 scancount_add(st, &nreached, v));
+    for (int32_t i = 0; i < m; ++i)
+        THRESHOLD_FOR_EACH_VALUE(&inputs[i], v, st->counts[v] = 0);
+    *result = NULL;
+    if (nreached == 0) return true;
+    if (nreached <= DEFAULT_MAX_SIZE) {
+        qsort(st->reached, nreached, sizeof(uint16_t), compare_uint16);
+        array_container_t *answer =
+            array_container_create_given_capacity(nreached);
+        if (answer == NULL) return false;
+        memcpy(answer->array, st->reached, nreached * sizeof(uint16_t));
+        answer->cardinality = nreached;
+        *result = answer;
+        *typecode = ARRAY_CONTAINER_TYPE_CODE;
+        return true;
+    }
+    bitset_container_t *answer = bitset_container_create();
+    if (answer == NULL) return false;
+    bitset_set_list(answer->array, st->reached, nreached);
+    answer->cardinality = nreached;
+    *result = answer;
+    *typecode = BITSET_CONTAINER_TYPE_CODE;
+    return true;
+}
+
+/* Adds a bitset to the k bit-sliced counters, one slice at a time so that
+ * the loops vectorize, stopping when nothing is carried over. */
+static void slices_add_words(uint64_t *slices, int k, const uint64_t *words,
+                             uint64_t *carry) {
+    const uint64_t *in = words;
+    for (int j = 0; j < k; ++j) {
+        uint64_t *s = slices + j * BITSET_CONTAINER_SIZE_IN_WORDS;
+        uint64_t any = 0;
+        for (int32_t w = 0; w < BITSET_CONTAINER_SIZE_IN_WORDS; ++w) {
+            const uint64_t c = s[w] & in[w];
+            s[w] ^= in[w];
+            carry[w] = c;
+            any |= c;
+        }
+        if (any == 0) return;
+        in = carry;
+    }
+}
+
+/* Bit-sliced adders: k-bit counters stored as k bitsets, a bitset is added
+ * word by word. Same conventions as threshold_scancount. */
+static bool threshold_bitsliced(threshold_state_t *st,
+                                const threshold_input_t *inputs, int32_t m,
+                                void **result, uint8_t *typecode) {
+    const int k = 32 - __builtin_clz((uint32_t)m);  // m < 2^k
+    if (st->slices == NULL) {
+        st->slices = roaring_malloc(BITSET_CONTAINER_SIZE_IN_WORDS *
+                                    st->max_slices * sizeof(uint64_t));
+        st->words =
+            roaring_malloc(BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+        st->carry =
+            roaring_malloc(BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+        if (st->slices == NULL || st->words == NULL || st->carry == NULL)
+            return false;
+    }
+    uint64_t *slices = st->slices;
+    memset(slices, 0, BITSET_CONTAINER_SIZE_IN_WORDS * k * sizeof(uint64_t));
+    for (int32_t i = 0; i < m; ++i) {
+        switch (inputs[i].typecode) {
+            case BITSET_CONTAINER_TYPE_CODE:
+                slices_add_words(
+                    slices, k,
+                    ((const bitset_container_t *)inputs[i].container)->array,
+                    st->carry);
+                break;
+            case RUN_CONTAINER_TYPE_CODE: {
+                const run_container_t *run =
+                    (const run_container_t *)inputs[i].container;
+                memset(st->words, 0,
+                       BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+                for (int32_t r = 0; r < run->n_runs; ++r)
+                    bitset_set_range(st->words, run->runs[r].value,
+                                     run->runs[r].value +
+                                         run->runs[r].length + UINT32_C(1));
+                slices_add_words(slices, k, st->words, st->carry);
+                break;
+            }
+            default: {
+                const array_container_t *array =
+                    (const array_container_t *)inputs[i].container;
+                if (array->cardinality > SLICED_ARRAY_MAX_CARDINALITY) {
+                    memset(st->words, 0,
+                           BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+                    bitset_set_list(st->words, array->array,
+                                    array->cardinality);
+                    slices_add_words(slices, k, st->words, st->carry);
+                    break;
+                }
+                // one value at a time
+                for (int32_t a = 0; a < array->cardinality; ++a) {
+                    const uint16_t v = array->array[a];
+                    uint64_t *s = slices + (v >> 6);
+                    const uint64_t bit = UINT64_C(1) << (v & 63);
+                    for (int j = 0; j < k; ++j) {
+                        s[j * BITSET_CONTAINER_SIZE_IN_WORDS] ^= bit;
+                        if (s[j * BITSET_CONTAINER_SIZE_IN_WORDS] & bit)
+                            break;  // no carry
+                    }
+                }
+            }
+        }
+    }
+    bitset_container_t *answer = bitset_container_create();
+    if (answer == NULL) return false;
+    const uint32_t t = st->threshold;
+    int32_t card = 0;
+    for (int32_t w = 0; w < BITSET_CONTAINER_SIZE_IN_WORDS; ++w) {
+        // counter >= t, comparing from the most significant slice
+        const uint64_t *s = slices + w;
+        uint64_t greater = 0, equal = ~UINT64_C(0);
+        for (int j = k - 1; j >= 0; --j) {
+            const uint64_t sj = s[j * BITSET_CONTAINER_SIZE_IN_WORDS];
+            if (t & (UINT32_C(1) << j)) {
+                equal &= sj;
+            } else {
+                greater |= equal & sj;
+                equal &= ~sj;
+            }
+        }
+        answer->array[w] = greater | equal;
+        card += __builtin_popcountll(answer->array[w]);
+    }
+    answer->cardinality = card;
+    *result = NULL;
+    if (card > DEFAULT_MAX_SIZE) {
+        *result = answer;
+        *typecode = BITSET_CONTAINER_TYPE_CODE;
+        return true;
+    }
+    bool ok = true;
+    if (card > 0) {
+        *result = array_container_from_bitset(answer);
+        *typecode = ARRAY_CONTAINER_TYPE_CODE;
+        ok = *result != NULL;
+    }
+    bitset_container_free(answer);
+    return ok;
+}
+
+roaring_bitmap_t *roaring_bitmap_threshold(size_t number,
+                                           const roaring_bitmap_t **x,
+                                           uint32_t threshold) {
+    ROARING_TRACE_OPERATION("roaring_bitmap_threshold");
+    if (threshold <= 1) return roaring_bitmap_or_many(number, x);
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL || threshold > number) return answer;
+    // how many bitmaps have each key: the others are skipped
+    uint32_t *keycount = roaring_calloc(1 << 16, sizeof(uint32_t));
+    uint64_t *offset = roaring_malloc(((1 << 16) + 1) * sizeof(uint64_t));
+    threshold_state_t st = {.threshold = threshold};
+    threshold_input_t *inputs = NULL;
+    bool ok = keycount != NULL && offset != NULL;
+    for (size_t i = 0; ok && i < number; ++i) {
+        const roaring_array_t *ra = x[i]->high_low_container;
+        for (int32_t k = 0; k < ra->size; ++k) keycount[ra->keys[k]]++;
+    }
+    // containers grouped by key, only for the keys found often enough
+    uint64_t total = 0;
+    uint32_t maxcount = 0;
+    for (uint32_t key = 0; ok && key < (1 << 16); ++key) {
+        offset[key] = total;
+        if (keycount[key] < threshold) continue;
+        total += keycount[key];
+        if (keycount[key] > maxcount) maxcount = keycount[key];
+    }
+    if (ok) offset[1 << 16] = total;
+    if (ok && total > 0) {
+        inputs = roaring_malloc(total * sizeof(threshold_input_t));
+        st.max_slices = 32 - __builtin_clz(maxcount);
+        ok = inputs != NULL;
+    }
+    for (size_t i = 0; ok && total > 0 && i < number; ++i) {
+        const roaring_array_t *ra = x[i]->high_low_container;
+        for (int32_t k = 0; k < ra->size; ++k) {
+            const uint16_t key = ra->keys[k];
+            if (keycount[key] < threshold) continue;
+            threshold_input_t *in = &inputs[offset[key]++];
+            in->typecode = ra->typecodes[k];
+            in->container =
+                container_unwrap_shared(ra->containers[k], &in->typecode);
+        }
+    }
+    // offset[key] now points past the containers of key
+    for (uint32_t key = 0; ok && total > 0 && key < (1 << 16); ++key) {
+        const uint32_t m = keycount[key];
+        if (m < threshold) continue;
+        const threshold_input_t *in = inputs + offset[key] - m;
+        uint64_t card = 0;
+        for (uint32_t i = 0; i < m; ++i)
+            card += container_get_cardinality(in[i].container, in[i].typecode);
+        uint8_t typecode;
+        void *c;
+        if (card < (uint64_t)SCANCOUNT_MAX_AVERAGE_CARDINALITY * m) {
+            ok = threshold_scancount(&st, in, m, &c, &typecode);
+        } else {
+            ok = threshold_bitsliced(&st, in, m, &c, &typecode);
+        }
+        if (ok && c != NULL)
+            ra_append(answer->high_low_container, key, c, typecode);
+    }
+    roaring_free(keycount);
+    roaring_free(offset);
+    roaring_free(inputs);
+    roaring_free(st.counts);
+    roaring_free(st.reached);
+    roaring_free(st.slices);
+    roaring_free(st.words);
+    roaring_free(st.carry);
+    if (!ok) {
+        roaring_bitmap_free(answer);
+        return NULL;
+    }
+    return answer;
+}
@@ -0,0 +1,76 @@
+/*
+ * roaring_trace.c
+ *
+ */
+
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+
+#include <string.h>
+#include <time.h>
+
+#include "roaring_trace.h"
+
+#ifdef ROARING_TRACE
+
+_Thread_local roaring_trace_counters_t roaring_trace_thread_counters;
+
+static _Thread_local int operation_depth;  // nested top-level operations
+
+static roaring_trace_callback_t trace_callback;
+static void *trace_callback_param;
+
+static uint64_t trace_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+void roaring_trace_timer_start(roaring_trace_timer_t *timer,
+                               const char *operation) {
+    timer->operation = operation;
+    timer->start = 0;
+    if (operation_depth++ == 0 && trace_callback != NULL)
+        timer->start = trace_now() | 1;  // never 0
+}
+
+void roaring_trace_timer_stop(roaring_trace_timer_t *timer) {
+    operation_depth--;
+    if (timer->start == 0 || trace_callback == NULL) return;
+    trace_callback(timer->operation, trace_now() - timer->start,
+                   trace_callback_param);
+}
+
+bool roaring_trace_enabled(void) { return true; }
+
+void roaring_trace_get_counters(roaring_trace_counters_t *counters) {
+    *counters = roaring_trace_thread_counters;
+}
+
+void roaring_trace_reset_counters(void) {
+    memset(&roaring_trace_thread_counters, 0,
+           sizeof(roaring_trace_thread_counters));
+}
+
+void roaring_trace_set_callback(roaring_trace_callback_t callback,
+                                void *param) {
+    trace_callback_param = param;
+    trace_callback = callback;
+}
+
+#else
+
+bool roaring_trace_enabled(void) { return false; }
+
+void roaring_trace_get_counters(roaring_trace_counters_t *counters) {
+    memset(counters, 0, sizeof(*counters));
+}
+
+void roaring_trace_reset_counters(void) {}
+
+void roaring_trace_set_callback(roaring_trace_callback_t callback,
+                                void *param) {
+    (void)callback;
+    (void)param;
+}
+
+#endif /* ROARING_TRACE */
@@ -127,6 +127,45 @@ void and_or_test() {
     array_container_free(TMP);
 }
 
+void cardinality_only_test() {
+    DESCRIBE_TEST;
+
+    srand(4321);
+    for (int trial = 0; trial < 200; ++trial) {
+        array_container_t* B1 = array_container_create();
+        array_container_t* B2 = array_container_create();
+        array_container_t* TMP = array_container_create();
+        // values near zero exercise the vector blocks starting with 0
+        const int n1 = rand() % 3000, n2 = rand() % (trial % 10 == 0 ? 20 : 3000);
+        const int range = 1 + rand() % (1 << 16);
+        for (int i = 0; i < n1; ++i) array_container_add(B1, rand() % range);
+        for (int i = 0; i < n2; ++i) array_container_add(B2, rand() % range);
+
+        array_container_intersection(B1, B2, TMP);
+        const int card_inter = array_container_cardinality(TMP);
+        assert_int_equal(card_inter,
+                         array_container_intersection_cardinality(B1, B2));
+        assert_int_equal(card_inter,
+                         array_container_intersection_cardinality(B2, B1));
+        array_container_union(B1, B2, TMP);
+        assert_int_equal(array_container_cardinality(TMP),
+                         array_container_union_cardinality(B1, B2));
+
+        const int ks[] = {0, 1, card_inter / 2, card_inter, card_inter + 1,
+                          card_inter + 100};
+        for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+            assert_int_equal(
+                array_container_intersection_cardinality_at_least(B1, B2,
+                                                                  ks[i]),
+                card_inter >= ks[i]);
+        }
+
+        array_container_free(B1);
+        array_container_free(B2);
+        array_container_free(TMP);
+    }
+}
+
 void to_uint32_array_test() {
     for (size_t offset = 1; offset < 128; offset *= 2) {
         array_container_t* B = array_container_create();
@@ -156,6 +195,7 @@ int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(printf_test), cmocka_unit_test(add_contains_test),
         cmocka_unit_test(and_or_test), cmocka_unit_test(to_uint32_array_test),
+        cmocka_unit_test(cardinality_only_test),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 
 #include "containers/bitset.h"
+#include "containers/pool.h"
 #include "misc/configreport.h"
 
 #include "test.h"
@@ -208,11 +209,48 @@ void to_uint32_array_test() {
     }
 }
 
+// payloads released by bitset_container_free get recycled
+void pool_test() {
+    roaring_pool_trim(0);
+    roaring_pool_stats_t before, after;
+    roaring_pool_get_stats(&before);
+    assert_int_equal(before.cached_bytes, 0);
+
+    bitset_container_t* B1 = bitset_container_create();
+    bitset_container_set(B1, 1234);
+    uint64_t* words = B1->array;
+    bitset_container_free(B1);
+    roaring_pool_get_stats(&after);
+    assert_int_equal(after.cached_bitsets, 1);
+
+    bitset_container_t* B2 = bitset_container_create();
+    assert_ptr_equal(B2->array, words);
+    assert_int_equal(bitset_container_cardinality(B2), 0);
+    assert_false(bitset_container_get(B2, 1234));  // cleared on reuse
+    roaring_pool_get_stats(&after);
+    assert_int_equal(after.bitset_hits, before.bitset_hits + 1);
+
+    bitset_container_t* B3 = bitset_container_clone(B2);
+    bitset_container_free(B2);
+    bitset_container_free(B3);
+    roaring_pool_get_stats(&after);
+    assert_int_equal(after.cached_bitsets, 2);
+    assert_int_equal(roaring_pool_trim(0),
+                     2 * sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+
+    roaring_pool_set_enabled(false);
+    bitset_container_free(bitset_container_create());
+    roaring_pool_get_stats(&after);
+    assert_int_equal(after.cached_bytes, 0);
+    roaring_pool_set_enabled(true);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(printf_test), cmocka_unit_test(set_get_test),
         cmocka_unit_test(and_or_test), cmocka_unit_test(xor_test),
         cmocka_unit_test(andnot_test), cmocka_unit_test(to_uint32_array_test),
+        cmocka_unit_test(pool_test),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "containers/mixed_intersection.h"
 #include "containers/mixed_union.h"
@@ -711,11 +712,153 @@ void run_negation_range_test9() {
                                     RUN_CONTAINER_TYPE_CODE, false, false);
 }
 
+/* about nruns random runs, written into the reference too */
+static run_container_t* random_runs(int nruns, bool* reference) {
+    run_container_t* R = run_container_create();
+    const int span = (1 << 16) / nruns;
+    int pos = rand() % span;
+    while (pos < (1 << 16)) {
+        int len = rand() % (span / 2 + 1);
+        if (pos + len >= (1 << 16)) len = (1 << 16) - 1 - pos;
+        for (int x = pos; x <= pos + len; ++x) {
+            run_container_add(R, x);
+            reference[x] = true;
+        }
+        pos += len + 2 + rand() % span;
+    }
+    return R;
+}
+
+static array_container_t* random_values(int n, bool* reference) {
+    array_container_t* A = array_container_create();
+    for (int i = 0; i < n; ++i) {
+        int x = rand() % (1 << 16);
+        array_container_add(A, x);
+        reference[x] = true;
+    }
+    return A;
+}
+
+/* galloping kicks in when one side has many more runs (or values) */
+void skewed_run_and_or_test() {
+    static bool r1[1 << 16], r2[1 << 16];
+    const int sizes[] = {1, 3, 10, 50, 200, 2000};
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    srand(1234);
+    for (int i = 0; i < nsizes; ++i) {
+        for (int j = 0; j < nsizes; ++j) {
+            memset(r1, 0, sizeof(r1));
+            memset(r2, 0, sizeof(r2));
+            run_container_t* R1 = random_runs(sizes[i], r1);
+            run_container_t* R2 = random_runs(sizes[j], r2);
+            run_container_t* RI = run_container_create();
+            run_container_t* RO = run_container_create();
+            run_container_intersection(R1, R2, RI);
+            run_container_union(R1, R2, RO);
+            int card_inter = 0, card_union = 0;
+            for (int x = 0; x < (1 << 16); ++x) {
+                assert_int_equal(run_container_contains(RI, x), r1[x] && r2[x]);
+                assert_int_equal(run_container_contains(RO, x), r1[x] || r2[x]);
+                card_inter += r1[x] && r2[x];
+                card_union += r1[x] || r2[x];
+            }
+            assert_int_equal(run_container_cardinality(RI), card_inter);
+            assert_int_equal(run_container_cardinality(RO), card_union);
+            run_container_free(RI);
+            run_container_free(RO);
+
+            memset(r1, 0, sizeof(r1));
+            array_container_t* A = random_values(sizes[i], r1);
+            array_container_t* AI = array_container_create();
+            RO = run_container_create();
+            array_run_container_intersection(A, R2, AI);
+            array_run_container_union(A, R2, RO);
+            card_inter = card_union = 0;
+            for (int x = 0; x < (1 << 16); ++x) {
+                assert_int_equal(array_container_contains(AI, x),
+                                 r1[x] && r2[x]);
+                assert_int_equal(run_container_contains(RO, x), r1[x] || r2[x]);
+                card_inter += r1[x] && r2[x];
+                card_union += r1[x] || r2[x];
+            }
+            assert_int_equal(array_container_cardinality(AI), card_inter);
+            assert_int_equal(run_container_cardinality(RO), card_union);
+            // dst may be the array itself
+            array_run_container_intersection(A, R2, A);
+            assert_int_equal(array_container_cardinality(A), card_inter);
+            assert_true(array_container_equals(A, AI));
+            array_container_free(A);
+            array_container_free(AI);
+            run_container_free(RO);
+            run_container_free(R1);
+            run_container_free(R2);
+        }
+    }
+}
+
+/* the values of reference as a container of the given type */
+static void* container_of(const bool* reference, uint8_t type) {
+    array_container_t* A = array_container_create();
+    bitset_container_t* B = bitset_container_create();
+    run_container_t* R = run_container_create();
+    for (int x = 0; x < (1 << 16); ++x) {
+        if (!reference[x]) continue;
+        array_container_add(A, x);
+        bitset_container_add(B, x);
+        run_container_add(R, x);
+    }
+    void* answer = type == ARRAY_CONTAINER_TYPE_CODE    ? (void*)A
+                   : type == BITSET_CONTAINER_TYPE_CODE ? (void*)B
+                                                        : (void*)R;
+    if (answer != A) array_container_free(A);
+    if (answer != B) bitset_container_free(B);
+    if (answer != R) run_container_free(R);
+    return answer;
+}
+
+/* all the type pairs, including those that roaring_bitmap_is_subset never
+ * reaches (a bitset in a smaller array) */
+void subset_test() {
+    static bool r1[1 << 16], r2[1 << 16];
+    const uint8_t types[] = {ARRAY_CONTAINER_TYPE_CODE,
+                             BITSET_CONTAINER_TYPE_CODE,
+                             RUN_CONTAINER_TYPE_CODE};
+    srand(99);
+    for (int trial = 0; trial < 40; ++trial) {
+        memset(r2, 0, sizeof(r2));
+        for (int k = 0; k < 20; ++k) {  // a few runs and isolated values
+            const int start = rand() % 65000, length = rand() % 300;
+            for (int x = start; x <= start + length; x += 1 + (k % 2))
+                r2[x] = true;
+        }
+        memcpy(r1, r2, sizeof(r1));
+        for (int k = 0; k < 100; ++k) r1[rand() % 65536] = false;
+        if (trial % 4 == 0) r1[rand() % 65536] = true;  // probably not in r2
+        if (trial % 4 == 1) r1[0] = r1[65535] = true;
+        if (trial % 4 == 2) memcpy(r1, r2, sizeof(r1));
+        bool expected = true;
+        for (int x = 0; x < (1 << 16); ++x) expected &= !r1[x] || r2[x];
+        for (int t1 = 0; t1 < 3; ++t1)
+            for (int t2 = 0; t2 < 3; ++t2) {
+                void* c1 = container_of(r1, types[t1]);
+                void* c2 = container_of(r2, types[t2]);
+                assert_int_equal(
+                    container_is_subset(c1, types[t1], c2, types[t2]),
+                    expected);
+                assert_true(container_is_subset(c1, types[t1], c1, types[t1]));
+                container_free(c1, types[t1]);
+                container_free(c2, types[t2]);
+            }
+    }
+}
+
 /* now tests that negate just part of the range:  18
  * more... */
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(array_bitset_and_or_test),
+        cmocka_unit_test(skewed_run_and_or_test),
+        cmocka_unit_test(subset_test),
         cmocka_unit_test(array_negation_empty_test),
         cmocka_unit_test(array_negation_test),
         cmocka_unit_test(array_negation_range_test1),
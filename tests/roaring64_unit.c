@@ -0,0 +1,302 @@
+/*
+ * roaring64_unit.c
+ *
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roaring64.h"
+#include "roaring_memory.h"
+
+#include "test.h"
+
+enum { NUM_VALUES = 20000 };
+
+/* values spread over a few buckets, with arrays, bitsets and runs */
+static uint64_t random_value(void) {
+    static const uint64_t highs[] = {0, 1, 7, UINT64_C(0xFFFFFFFF)};
+    const uint64_t high = highs[rand() % 4] << 32;
+    switch (rand() % 3) {
+        case 0:
+            return high | ((uint32_t)rand() << 8 ^ (uint32_t)rand());
+        case 1:
+            return high | (uint32_t)(rand() % (1 << 17));
+        default:
+            return high | (UINT32_C(5) << 16) | (rand() % 1000);
+    }
+}
+
+static roaring64_bitmap_t *random_bitmap(uint64_t *values, bool runs) {
+    roaring64_bitmap_t *r = roaring64_bitmap_create();
+    for (int i = 0; i < NUM_VALUES; ++i) {
+        values[i] = random_value();
+        roaring64_bitmap_add(r, values[i]);
+    }
+    if (runs) roaring64_bitmap_run_optimize(r);
+    return r;
+}
+
+static void sum_iterator(uint64_t value, void *param) {
+    uint64_t *acc = (uint64_t *)param;
+    acc[0]++;
+    acc[1] += value;
+}
+
+void test_add_remove() {
+    roaring64_bitmap_t *r = roaring64_bitmap_create();
+    const uint64_t big = UINT64_C(0xFFFFFFFFFFFFFFFF);
+    roaring64_bitmap_add(r, big);
+    roaring64_bitmap_add(r, 5);
+    roaring64_bitmap_add(r, UINT64_C(1) << 40);
+    roaring64_bitmap_add(r, 5);
+    assert_int_equal(roaring64_bitmap_get_cardinality(r), 3);
+    assert_int_equal(r->size, 3);
+    assert_true(roaring64_bitmap_contains(r, big));
+    assert_true(roaring64_bitmap_contains(r, UINT64_C(1) << 40));
+    assert_false(roaring64_bitmap_contains(r, (UINT64_C(1) << 40) + 5));
+    assert_false(roaring64_bitmap_contains(r, UINT64_C(1) << 32));
+
+    uint64_t cardinality;
+    uint64_t *values = roaring64_bitmap_to_uint64_array(r, &cardinality);
+    assert_int_equal(cardinality, 3);
+    assert_true(values[0] == 5 && values[1] == UINT64_C(1) << 40 &&
+                values[2] == big);
+    free(values);
+
+    roaring64_bitmap_remove(r, UINT64_C(1) << 40);
+    roaring64_bitmap_remove(r, 6);  // absent
+    assert_int_equal(roaring64_bitmap_get_cardinality(r), 2);
+    assert_int_equal(r->size, 2);  // the emptied bucket is dropped
+    roaring64_bitmap_free(r);
+}
+
+void test_copy_on_write() {
+    uint64_t values[NUM_VALUES];
+    roaring64_bitmap_t *r = roaring64_bitmap_create();
+    r->copy_on_write = true;
+    for (int i = 0; i < NUM_VALUES; ++i) {
+        values[i] = random_value();
+        roaring64_bitmap_add(r, values[i]);
+    }
+    const uint64_t card = roaring64_bitmap_get_cardinality(r);
+    roaring64_bitmap_t *copy = roaring64_bitmap_copy(r);
+    assert_true(roaring64_bitmap_equals(r, copy));
+    for (int i = 0; i < NUM_VALUES; i += 2) roaring64_bitmap_remove(copy, values[i]);
+    roaring64_bitmap_add(copy, UINT64_C(3) << 32);
+    assert_int_equal(roaring64_bitmap_get_cardinality(r), card);
+    for (int i = 0; i < NUM_VALUES; ++i)
+        assert_true(roaring64_bitmap_contains(r, values[i]));
+    assert_false(roaring64_bitmap_contains(r, UINT64_C(3) << 32));
+    roaring64_bitmap_free(copy);
+    roaring64_bitmap_free(r);
+}
+
+/* checks every value of x1 and x2 against the four operations */
+static void check_operations(bool runs) {
+    uint64_t *values = malloc(2 * NUM_VALUES * sizeof(uint64_t));
+    roaring64_bitmap_t *x1 = random_bitmap(values, runs);
+    roaring64_bitmap_t *x2 = random_bitmap(values + NUM_VALUES, false);
+    roaring64_bitmap_t *results[4] = {
+        roaring64_bitmap_and(x1, x2), roaring64_bitmap_or(x1, x2),
+        roaring64_bitmap_xor(x1, x2), roaring64_bitmap_andnot(x1, x2)};
+    roaring64_bitmap_t *all = roaring64_bitmap_of_ptr(2 * NUM_VALUES, values);
+    uint64_t n;
+    uint64_t *distinct = roaring64_bitmap_to_uint64_array(all, &n);
+    uint64_t expected[4] = {0, 0, 0, 0};
+    for (uint64_t i = 0; i < n; ++i) {
+        const bool in1 = roaring64_bitmap_contains(x1, distinct[i]);
+        const bool in2 = roaring64_bitmap_contains(x2, distinct[i]);
+        const bool want[4] = {in1 && in2, in1 || in2, in1 != in2,
+                              in1 && !in2};
+        for (int op = 0; op < 4; ++op) {
+            assert_true(roaring64_bitmap_contains(results[op], distinct[i]) ==
+                        want[op]);
+            expected[op] += want[op];
+        }
+    }
+    for (int op = 0; op < 4; ++op)
+        assert_int_equal(roaring64_bitmap_get_cardinality(results[op]),
+                         expected[op]);
+    assert_true(roaring64_bitmap_equals(results[1], all));
+
+    roaring64_bitmap_t *inplace = roaring64_bitmap_copy(x1);
+    roaring64_bitmap_and_inplace(inplace, x2);
+    assert_true(roaring64_bitmap_equals(inplace, results[0]));
+    roaring64_bitmap_free(inplace);
+    inplace = roaring64_bitmap_copy(x2);
+    roaring64_bitmap_or_inplace(inplace, x1);
+    assert_true(roaring64_bitmap_equals(inplace, results[1]));
+    roaring64_bitmap_free(inplace);
+
+    roaring64_bitmap_t *x3 = roaring64_bitmap_create();
+    roaring64_bitmap_add(x3, UINT64_C(42) << 32);
+    const roaring64_bitmap_t *many[3] = {x1, x2, x3};
+    roaring64_bitmap_t *u = roaring64_bitmap_or_many(3, many);
+    roaring64_bitmap_add(all, UINT64_C(42) << 32);
+    assert_true(roaring64_bitmap_equals(u, all));
+    roaring64_bitmap_free(u);
+    roaring64_bitmap_free(x3);
+
+    for (int op = 0; op < 4; ++op) roaring64_bitmap_free(results[op]);
+    roaring64_bitmap_free(all);
+    roaring64_bitmap_free(x1);
+    roaring64_bitmap_free(x2);
+    free(distinct);
+    free(values);
+}
+
+void test_operations() { check_operations(false); }
+
+void test_operations_with_runs() { check_operations(true); }
+
+void test_iterate() {
+    uint64_t values[NUM_VALUES];
+    roaring64_bitmap_t *r = random_bitmap(values, true);
+    uint64_t acc[2] = {0, 0}, expected = 0;
+    roaring64_iterate(r, sum_iterator, acc);
+    uint64_t n;
+    uint64_t *array = roaring64_bitmap_to_uint64_array(r, &n);
+    for (uint64_t i = 0; i < n; ++i) {
+        if (i > 0) assert_true(array[i - 1] < array[i]);
+        expected += array[i];
+    }
+    assert_int_equal(acc[0], n);
+    assert_true(acc[1] == expected);
+    free(array);
+    roaring64_bitmap_free(r);
+}
+
+void test_portable_serialize() {
+    // the layout of the Java and Go versions
+    roaring64_bitmap_t *r = roaring64_bitmap_create();
+    roaring64_bitmap_add(r, (UINT64_C(0x01020304) << 32) | 7);
+    const size_t size = roaring64_bitmap_portable_size_in_bytes(r);
+    char *buf = malloc(size);
+    assert_int_equal(roaring64_bitmap_portable_serialize(r, buf), size);
+    const char header[] = {1, 0, 0, 0, 0, 0, 0, 0, 4, 3, 2, 1};
+    assert_int_equal(size, sizeof(header) +
+                               roaring_bitmap_portable_size_in_bytes(
+                                   r->bitmaps[0]));
+    assert_memory_equal(buf, header, sizeof(header));
+    roaring_bitmap_t *bucket =
+        roaring_bitmap_portable_deserialize(buf + sizeof(header));
+    assert_true(roaring_bitmap_contains(bucket, 7));
+    roaring_bitmap_free(bucket);
+    free(buf);
+    roaring64_bitmap_free(r);
+
+    uint64_t values[NUM_VALUES];
+    r = random_bitmap(values, true);
+    buf = malloc(roaring64_bitmap_portable_size_in_bytes(r));
+    const size_t written = roaring64_bitmap_portable_serialize(r, buf);
+    assert_int_equal(written, roaring64_bitmap_portable_size_in_bytes(r));
+    roaring64_bitmap_t *r2 = roaring64_bitmap_portable_deserialize(buf);
+    assert_true(roaring64_bitmap_equals(r, r2));
+
+    roaring64_frozen_t *f = roaring64_frozen_view(buf);
+    assert_non_null(f);
+    assert_int_equal(roaring64_frozen_size_in_bytes(f), written);
+    assert_int_equal(roaring64_frozen_get_cardinality(f),
+                     roaring64_bitmap_get_cardinality(r));
+    for (int i = 0; i < NUM_VALUES; ++i) {
+        assert_true(roaring64_frozen_contains(f, values[i]));
+        assert_true(roaring64_frozen_contains(f, values[i] + 1) ==
+                    roaring64_bitmap_contains(r, values[i] + 1));
+        assert_true(roaring64_frozen_contains(f, values[i] ^ (1 << 20)) ==
+                    roaring64_bitmap_contains(r, values[i] ^ (1 << 20)));
+    }
+    assert_false(roaring64_frozen_contains(f, UINT64_C(2) << 32));
+    uint64_t acc[2] = {0, 0}, expected[2] = {0, 0};
+    roaring64_frozen_iterate(f, sum_iterator, acc);
+    roaring64_iterate(r, sum_iterator, expected);
+    assert_true(acc[0] == expected[0] && acc[1] == expected[1]);
+    roaring64_frozen_free(f);
+
+    roaring64_bitmap_free(r2);
+    memset(buf + 12, 0, 4);  // not a cookie
+    assert_null(roaring64_frozen_view(buf));
+    assert_null(roaring64_bitmap_portable_deserialize(buf));
+    free(buf);
+    roaring64_bitmap_free(r);
+}
+
+/* an allocator failing once `allowed` allocations have been made */
+static int allowed;
+static void *failing_malloc(size_t size) {
+    return allowed-- > 0 ? malloc(size) : NULL;
+}
+static void *failing_realloc(void *ptr, size_t size) {
+    return allowed-- > 0 ? realloc(ptr, size) : NULL;
+}
+static void *failing_calloc(size_t nmemb, size_t size) {
+    return allowed-- > 0 ? calloc(nmemb, size) : NULL;
+}
+static void *failing_aligned_malloc(size_t alignment, size_t size) {
+    void *p;
+    if (allowed-- <= 0 || posix_memalign(&p, alignment, size)) return NULL;
+    return p;
+}
+
+static const roaring_memory_t failing_hook = {
+    .malloc = failing_malloc,
+    .realloc = failing_realloc,
+    .calloc = failing_calloc,
+    .free = free,
+    .aligned_malloc = failing_aligned_malloc,
+    .aligned_free = free,
+};
+
+void test_or_inplace_failure() {
+    roaring64_bitmap_t *x2 = roaring64_bitmap_create();
+    for (uint64_t high = 1; high <= 3; ++high)
+        for (uint64_t i = 0; i < 5000; i += 1 + high)
+            roaring64_bitmap_add(x2, high << 32 | i);
+    // a bucket shared with x1: its odd values go into the bitset of x1 in
+    // place, without allocating
+    for (uint64_t i = 1; i < 2000; i += 2)
+        roaring64_bitmap_add(x2, UINT64_C(7) << 32 | i);
+    // every allocation of the union fails in turn until it succeeds
+    for (int budget = 0;; ++budget) {
+        roaring64_bitmap_t *x1 = roaring64_bitmap_create();
+        roaring64_bitmap_add(x1, 12);
+        for (uint64_t i = 0; i < 20000; i += 2)
+            roaring64_bitmap_add(x1, UINT64_C(7) << 32 | i);
+        roaring64_bitmap_t *before = roaring64_bitmap_copy(x1);
+        roaring64_bitmap_t *expected = roaring64_bitmap_or(x1, x2);
+        allowed = budget;
+        roaring_set_thread_memory_hook(&failing_hook);
+        const bool ok = roaring64_bitmap_or_inplace(x1, x2);
+        roaring_set_thread_memory_hook(NULL);
+        if (ok) {
+            assert_true(allowed >= 0);  // no allocation failed in the merge
+            assert_true(roaring64_bitmap_equals(x1, expected));
+            assert_true(roaring64_bitmap_contains(x1, UINT64_C(3) << 32));
+            assert_true(roaring64_bitmap_contains(x1, UINT64_C(7) << 32 | 1));
+        } else {
+            assert_true(roaring64_bitmap_equals(x1, before));
+        }
+        roaring64_bitmap_free(expected);
+        roaring64_bitmap_free(before);
+        roaring64_bitmap_free(x1);
+        if (ok) break;
+    }
+    roaring64_bitmap_free(x2);
+}
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_add_remove),
+        cmocka_unit_test(test_copy_on_write),
+        cmocka_unit_test(test_operations),
+        cmocka_unit_test(test_operations_with_runs),
+        cmocka_unit_test(test_or_inplace_failure),
+        cmocka_unit_test(test_iterate),
+        cmocka_unit_test(test_portable_serialize),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
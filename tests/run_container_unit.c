@@ -119,6 +119,38 @@ void and_or_test() {
     run_container_free(TMP);
 }
 
+/* every step-th run of width width, starting at offset */
+static run_container_t* strided_runs(int offset, int step, int width) {
+    run_container_t* r = run_container_create();
+    for (int x = offset; x < (1 << 16); x += step)
+        for (int y = x; y < x + width && y < (1 << 16); ++y)
+            run_container_add(r, y);
+    return r;
+}
+
+void intersection_inplace_test() {
+    // (offset, step, width): one long run, many short runs, skewed sizes...
+    const int shapes[][3] = {{100, 1 << 16, 60000}, {0, 7, 3},   {5, 11, 6},
+                             {0, 4096, 100},        {3, 2, 1},   {0, 1000, 999},
+                             {1, 1 << 16, 1}};
+    const int nshapes = sizeof(shapes) / sizeof(shapes[0]);
+    for (int i = 0; i < nshapes; ++i) {
+        for (int j = 0; j < nshapes; ++j) {
+            run_container_t* A = strided_runs(shapes[i][0], shapes[i][1],
+                                              shapes[i][2]);
+            run_container_t* B = strided_runs(shapes[j][0], shapes[j][1],
+                                              shapes[j][2]);
+            run_container_t* expected = run_container_create();
+            run_container_intersection(A, B, expected);
+            run_container_intersection_inplace(A, B);
+            assert_true(run_container_equals(expected, A));
+            run_container_free(A);
+            run_container_free(B);
+            run_container_free(expected);
+        }
+    }
+}
+
 // returns 0 on error, 1 if ok.
 void to_uint32_array_test() {
     for (size_t offset = 1; offset < 128; offset *= 2) {
@@ -147,6 +179,7 @@ int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(printf_test), cmocka_unit_test(add_contains_test),
         cmocka_unit_test(and_or_test), cmocka_unit_test(to_uint32_array_test),
+        cmocka_unit_test(intersection_inplace_test),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
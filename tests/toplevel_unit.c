@@ -5,6 +5,9 @@
 #include <time.h>
 
 #include "roaring.h"
+#include "roaring_bsi.h"
+#include "roaring_expression.h"
+#include "roaring_trace.h"
 
 #include "test.h"
 
@@ -510,6 +513,36 @@ void test_contains() {
     roaring_bitmap_free(r1);
 }
 
+void test_remove() {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t i = 0; i < 10000; ++i) roaring_bitmap_add(r, 3 * i);
+    roaring_bitmap_add(r, 1000000);
+    assert_int_equal(roaring_bitmap_get_cardinality(r), 10001);
+    // removing values turns the bitset into an array
+    for (uint32_t i = 0; i < 10000; i += 2) roaring_bitmap_remove(r, 3 * i);
+    roaring_bitmap_remove(r, 1);  // absent
+    assert_int_equal(roaring_bitmap_get_cardinality(r), 5001);
+    for (uint32_t i = 0; i < 10000; ++i)
+        assert_true(roaring_bitmap_contains(r, 3 * i) == (i % 2 == 1));
+    // an emptied container is dropped
+    roaring_bitmap_remove(r, 1000000);
+    assert_int_equal(r->high_low_container->size, 1);
+    assert_false(roaring_bitmap_contains(r, 1000000));
+    roaring_bitmap_free(r);
+
+    r = roaring_bitmap_from_range(100, 200, 1);
+    roaring_bitmap_run_optimize(r);
+    roaring_bitmap_remove(r, 150);
+    roaring_bitmap_remove(r, 100);
+    assert_int_equal(roaring_bitmap_get_cardinality(r), 98);
+    assert_false(roaring_bitmap_contains(r, 150));
+    assert_true(roaring_bitmap_contains(r, 151));
+    assert_true(roaring_bitmap_contains(r, 101));
+    for (uint32_t i = 101; i < 200; ++i) roaring_bitmap_remove(r, i);
+    assert_int_equal(r->high_low_container->size, 0);
+    roaring_bitmap_free(r);
+}
+
 void test_intersection_array_x_array() {
     roaring_bitmap_t *r1 = roaring_bitmap_create();
     assert_non_null(r1);
@@ -1414,6 +1447,915 @@ void test_inplace_rand_flips() {
     free(input);
 }
 
+static void check_key_presence(const roaring_bitmap_t *r, const bool *present,
+                               uint32_t nkeys) {
+    for (uint32_t k = 0; k < nkeys; ++k) {
+        assert_true(roaring_bitmap_contains(r, (k << 16) | 7) == present[k]);
+        assert_false(roaring_bitmap_contains(r, (k << 16) | 8));
+    }
+}
+
+// enough containers for the key index to kick in, exercises all the paths
+// that maintain it
+void test_many_containers() {
+    const uint32_t nkeys = 5000;
+    bool *present = calloc(nkeys, sizeof(bool));
+    uint32_t *order = malloc(nkeys * sizeof(uint32_t));
+    for (uint32_t k = 0; k < nkeys; ++k) order[k] = k;
+    srand(1234);
+    for (uint32_t k = nkeys - 1; k > 0; --k) {
+        uint32_t j = rand() % (k + 1);
+        uint32_t tmp = order[k];
+        order[k] = order[j];
+        order[j] = tmp;
+    }
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t i = 0; i < nkeys; ++i) {
+        if (order[i] % 2 == 0) {  // out-of-order insertions
+            roaring_bitmap_add(r, (order[i] << 16) | 7);
+            present[order[i]] = true;
+        }
+    }
+    check_key_presence(r, present, nkeys);
+
+    // removing containers (they become empty)
+    for (uint32_t k = 0; k < nkeys; k += 4) {
+        roaring_bitmap_flip_inplace(r, (k << 16) | 7, (k << 16) | 8);
+        present[k] = false;
+    }
+    // adding containers back in the middle
+    for (uint32_t k = 1; k < nkeys; k += 10) {
+        roaring_bitmap_flip_inplace(r, (k << 16) | 7, (k << 16) | 8);
+        present[k] = true;
+    }
+    check_key_presence(r, present, nkeys);
+
+    roaring_bitmap_t *copy = roaring_bitmap_copy(r);
+    check_key_presence(copy, present, nkeys);
+    uint32_t expectedsize = roaring_bitmap_portable_size_in_bytes(r);
+    char *serializedbytes = malloc(expectedsize);
+    roaring_bitmap_portable_serialize(r, serializedbytes);
+    roaring_bitmap_t *t = roaring_bitmap_portable_deserialize(serializedbytes);
+    check_key_presence(t, present, nkeys);
+    roaring_bitmap_free(t);
+    free(serializedbytes);
+
+    // in-place intersection compacts the keys
+    roaring_bitmap_t *threes = roaring_bitmap_create();
+    for (uint32_t k = 0; k < nkeys; k += 3) roaring_bitmap_add(threes, (k << 16) | 7);
+    roaring_bitmap_and_inplace(copy, threes);
+    for (uint32_t k = 0; k < nkeys; ++k) present[k] = present[k] && (k % 3 == 0);
+    check_key_presence(copy, present, nkeys);
+
+    roaring_bitmap_free(threes);
+    roaring_bitmap_free(copy);
+    roaring_bitmap_free(r);
+    free(order);
+    free(present);
+}
+
+void test_statistics() {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_statistics_t stats;
+    roaring_bitmap_statistics(r, &stats);
+    assert_int_equal(stats.n_containers, 0);
+    assert_true(stats.min_value > stats.max_value);
+
+    for (uint32_t i = 100; i < 1000; i += 3) roaring_bitmap_add(r, i);  // array
+    for (uint32_t i = 65536; i < 2 * 65536; i += 2)
+        roaring_bitmap_add(r, i);  // bitset
+    for (uint32_t i = 5 * 65536; i < 5 * 65536 + 20000; ++i)
+        roaring_bitmap_add(r, i);  // run once optimized
+    roaring_bitmap_run_optimize(r);
+    roaring_bitmap_statistics(r, &stats);
+    assert_int_equal(stats.n_containers, 3);
+    assert_int_equal(stats.n_array_containers, 1);
+    assert_int_equal(stats.n_bitset_containers, 1);
+    assert_int_equal(stats.n_run_containers, 1);
+    assert_int_equal(stats.n_shared_containers, 0);
+    assert_int_equal(stats.n_values_array_containers, 300);
+    assert_int_equal(stats.n_values_bitset_containers, 32768);
+    assert_int_equal(stats.n_values_run_containers, 20000);
+    assert_int_equal(stats.cardinality, roaring_bitmap_get_cardinality(r));
+    assert_int_equal(stats.min_value, 100);
+    assert_int_equal(stats.max_value, 5 * 65536 + 20000 - 1);
+    assert_int_equal(stats.portable_size_in_bytes,
+                     roaring_bitmap_portable_size_in_bytes(r));
+    // the array container grew past its cardinality
+    assert_true(stats.n_bytes_array_containers >= 300 * sizeof(uint16_t));
+    assert_true(stats.n_bytes_bitset_containers >= 8192);
+    assert_int_equal(stats.n_bytes, stats.n_bytes_directory +
+                                        stats.n_bytes_array_containers +
+                                        stats.n_bytes_bitset_containers +
+                                        stats.n_bytes_run_containers);
+
+    r->copy_on_write = true;
+    roaring_bitmap_t *c = roaring_bitmap_copy(r);
+    roaring_bitmap_statistics(c, &stats);
+    assert_int_equal(stats.n_shared_containers, 3);
+    assert_int_equal(stats.n_run_containers, 1);
+    roaring_bitmap_free(c);
+    roaring_bitmap_free(r);
+}
+
+void test_shrink_to_fit() {
+    for (int parallel = 0; parallel <= 1; ++parallel) {
+        roaring_bitmap_t *r = roaring_bitmap_create();
+        for (uint32_t k = 0; k < 1000; ++k) {
+            for (uint32_t i = 0; i < 70 + k % 50; ++i)
+                roaring_bitmap_add(r, (k << 16) + 3 * i);
+            if (k % 3 == 0) {  // some runs too
+                for (uint32_t i = 0; i < 20 + k % 7; ++i)
+                    roaring_bitmap_add(r, (k << 16) + 1000 + 10 * i);
+            }
+        }
+        for (uint32_t i = 2000 << 16; i < (2001 << 16); i += 5)
+            roaring_bitmap_add(r, i);  // bitset
+        roaring_bitmap_run_optimize(r);
+        roaring_bitmap_t *copy = roaring_bitmap_copy(r);
+        roaring_statistics_t before, after;
+        roaring_bitmap_statistics(r, &before);
+        size_t saved = parallel ? roaring_bitmap_shrink_to_fit_parallel(r, 4)
+                                : roaring_bitmap_shrink_to_fit(r);
+        roaring_bitmap_statistics(r, &after);
+        assert_true(saved > 0);
+        assert_int_equal(before.n_bytes - after.n_bytes, saved);
+        assert_int_equal(r->high_low_container->allocation_size,
+                         r->high_low_container->size);
+        assert_true(roaring_bitmap_equals(r, copy));
+        assert_int_equal(roaring_bitmap_shrink_to_fit(r), 0);
+        // still usable after shrinking
+        roaring_bitmap_add(r, 5);
+        roaring_bitmap_add(r, 3000u << 16);
+        assert_true(roaring_bitmap_contains(r, 5));
+        assert_true(roaring_bitmap_contains(r, 3000u << 16));
+        roaring_bitmap_free(copy);
+        roaring_bitmap_free(r);
+    }
+}
+
+static int64_t containers_size_in_bytes(const roaring_bitmap_t *r) {
+    const roaring_array_t *ra = r->high_low_container;
+    int64_t bytes = 0;
+    for (int32_t i = 0; i < ra->size; ++i)
+        bytes += container_size_in_bytes(ra->containers[i], ra->typecodes[i]);
+    return bytes;
+}
+
+void test_run_optimize_parallel() {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    r->copy_on_write = true;
+    uint32_t runny = 0;
+    for (uint32_t k = 0; k < 1000; ++k) {
+        if (k % 3 == 0) {  // long runs
+            for (uint32_t i = 0; i < 500; ++i)
+                roaring_bitmap_add(r, (k << 16) + 100 + i);
+            runny++;
+        } else {
+            for (uint32_t i = 0; i < 100; ++i)
+                roaring_bitmap_add(r, (k << 16) + 7 * i);
+        }
+    }
+    for (int parallel = 0; parallel <= 1; ++parallel) {
+        const int threads = parallel ? 4 : 1;
+        // all the containers of the copy are shared with r
+        roaring_bitmap_t *copy = roaring_bitmap_copy(r);
+        const int64_t size_before = containers_size_in_bytes(copy);
+        roaring_conversion_stats_t stats;
+        assert_true(roaring_bitmap_run_optimize_parallel(copy, threads, &stats));
+        assert_int_equal(stats.n_containers_converted, runny);
+        assert_int_equal(stats.n_bytes_saved,
+                         size_before - containers_size_in_bytes(copy));
+        assert_true(stats.n_bytes_saved > 0);
+        assert_true(roaring_bitmap_equals(r, copy));
+        const roaring_array_t *ra = copy->high_low_container;
+        for (int32_t i = 0; i < ra->size; ++i)
+            assert_int_equal(ra->typecodes[i],
+                             ra->keys[i] % 3 == 0 ? RUN_CONTAINER_TYPE_CODE
+                                                  : SHARED_CONTAINER_TYPE_CODE);
+        const int64_t stats_saved = stats.n_bytes_saved;
+        // nothing left to convert
+        assert_true(roaring_bitmap_run_optimize_parallel(copy, threads, &stats));
+        assert_int_equal(stats.n_containers_converted, 0);
+
+        roaring_bitmap_t *copy2 = roaring_bitmap_copy(copy);
+        roaring_conversion_stats_t removed;
+        assert_true(
+            roaring_bitmap_remove_run_compression_parallel(copy2, threads,
+                                                           &removed));
+        assert_int_equal(removed.n_containers_converted, runny);
+        assert_int_equal(removed.n_bytes_saved, -stats_saved);
+        assert_true(roaring_bitmap_equals(copy2, r));
+        assert_false(roaring_bitmap_remove_run_compression(copy2));
+        roaring_bitmap_free(copy);
+        assert_true(roaring_bitmap_equals(copy2, r));
+        roaring_bitmap_free(copy2);
+    }
+    roaring_bitmap_free(r);
+}
+
+enum { EXPR_KEYS = 6, EXPR_UNIVERSE = EXPR_KEYS << 16 };
+
+/* a bitmap mixing array, bitset and run containers, missing some keys; its
+ * values are also flagged in set */
+static roaring_bitmap_t *expression_operand(int seed, bool *set) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    memset(set, 0, EXPR_UNIVERSE * sizeof(bool));
+    for (uint32_t key = 0; key < EXPR_KEYS; ++key) {
+        const int shape = (seed + key) % 4;
+        for (uint32_t x = 0; x < (1 << 16); ++x) {
+            bool in;
+            switch (shape) {
+                case 0:  // array
+                    in = (x * (seed + 7)) % 211 == 0;
+                    break;
+                case 1:  // bitset
+                    in = (x * 2654435761u + seed) % 3 == 0;
+                    break;
+                case 2:  // runs
+                    in = (x + 100 * seed) % 1000 < 300;
+                    break;
+                default:  // missing
+                    in = false;
+            }
+            if (in) {
+                roaring_bitmap_add(r, (key << 16) | x);
+                set[(key << 16) | x] = true;
+            }
+        }
+    }
+    roaring_bitmap_run_optimize(r);
+    return r;
+}
+
+void test_expression() {
+    enum { N = 6 };
+    bool *sets[N];
+    roaring_bitmap_t *bitmaps[N];
+    roaring_expression_t *e = roaring_expression_create();
+    int32_t leaf[N];
+    for (int i = 0; i < N; ++i) {
+        sets[i] = malloc(EXPR_UNIVERSE * sizeof(bool));
+        bitmaps[i] = expression_operand(i, sets[i]);
+        leaf[i] = roaring_expression_bitmap(e, bitmaps[i]);
+        assert_int_equal(leaf[i], i);
+    }
+    assert_int_equal(roaring_expression_and(e, 0, 100), -1);
+    assert_int_equal(roaring_expression_bitmap(e, NULL), -1);
+    // (A | B | C) & ~D & (E | F), sharing A | B with A | B ^ F
+    const int32_t ab = roaring_expression_or(e, leaf[0], leaf[1]);
+    const int32_t abc = roaring_expression_or(e, ab, leaf[2]);
+    const int32_t ef = roaring_expression_or(e, leaf[4], leaf[5]);
+    const int32_t filter =
+        roaring_expression_andnot(e, roaring_expression_and(e, abc, ef), leaf[3]);
+    const int32_t abf = roaring_expression_xor(e, ab, leaf[5]);
+    const int32_t both = roaring_expression_or(e, filter, abf);
+    const int32_t self = roaring_expression_and(e, ab, ab);
+    const int32_t nothing = roaring_expression_andnot(e, ab, ab);
+    const int32_t nodes[] = {filter, abf, both, self, nothing};
+    bool *expected = malloc(EXPR_UNIVERSE * sizeof(bool));
+    for (int which = 0; which < 5; ++which) {
+        for (uint32_t x = 0; x < EXPR_UNIVERSE; ++x) {
+            const bool a = sets[0][x], b = sets[1][x], c = sets[2][x],
+                       d = sets[3][x], f = sets[5][x], ee = sets[4][x];
+            const bool filtered = (a || b || c) && !d && (ee || f);
+            switch (which) {
+                case 0:
+                    expected[x] = filtered;
+                    break;
+                case 1:
+                    expected[x] = (a || b) != f;
+                    break;
+                case 2:
+                    expected[x] = filtered || ((a || b) != f);
+                    break;
+                case 3:
+                    expected[x] = a || b;
+                    break;
+                default:
+                    expected[x] = false;
+            }
+        }
+        roaring_bitmap_t *r = roaring_expression_evaluate(e, nodes[which]);
+        assert_non_null(r);
+        uint64_t card = 0;
+        for (uint32_t x = 0; x < EXPR_UNIVERSE; ++x) {
+            assert_true(roaring_bitmap_contains(r, x) == expected[x]);
+            card += expected[x];
+        }
+        assert_int_equal(roaring_bitmap_get_cardinality(r), card);
+        roaring_bitmap_free(r);
+    }
+    // a single operand is copied
+    roaring_bitmap_t *copy = roaring_expression_evaluate(e, leaf[2]);
+    assert_true(roaring_bitmap_equals(copy, bitmaps[2]));
+    roaring_bitmap_free(copy);
+    assert_null(roaring_expression_evaluate(e, 1000));
+    free(expected);
+    for (int i = 0; i < N; ++i) {
+        free(sets[i]);
+        roaring_bitmap_free(bitmaps[i]);
+    }
+    roaring_expression_free(e);
+}
+
+void test_threshold() {
+    enum { N = 12, KEYS = 5 };
+    roaring_bitmap_t *bitmaps[N];
+    uint8_t *counts = calloc(KEYS << 16, sizeof(uint8_t));
+    for (int i = 0; i < N; ++i) {
+        bitmaps[i] = roaring_bitmap_create();
+        for (uint32_t key = 0; key < KEYS; ++key) {
+            // key 0: sparse arrays, 1: bitsets, 2: runs, 3: all kinds,
+            // 4: only in a few bitmaps
+            const int kind = key == 3 ? i % 3 : key == 4 ? (i < 3 ? 0 : -1)
+                                                         : (int)key;
+            for (uint32_t x = 0; x < (1 << 16); ++x) {
+                bool in;
+                switch (kind) {
+                    case 0:  // larger arrays for key 3
+                        in = ((x * 2654435761u) >> (i % 4 + 8)) %
+                                 (key == 3 ? 29 : 509) == 0;
+                        break;
+                    case 1:
+                        in = ((x * 2654435761u + i * 40503u) >> 7) % 3 != 0;
+                        break;
+                    case 2:
+                        in = (x + 37 * i) % 500 < 200;
+                        break;
+                    default:
+                        in = false;
+                }
+                if (in) {
+                    roaring_bitmap_add(bitmaps[i], (key << 16) | x);
+                    counts[(key << 16) | x]++;
+                }
+            }
+        }
+        roaring_bitmap_run_optimize(bitmaps[i]);
+    }
+    for (uint32_t t = 0; t <= N + 1; ++t) {
+        roaring_bitmap_t *r =
+            roaring_bitmap_threshold(N, (const roaring_bitmap_t **)bitmaps, t);
+        assert_non_null(r);
+        uint64_t card = 0;
+        for (uint32_t x = 0; x < (KEYS << 16); ++x) {
+            const bool expected = counts[x] >= (t == 0 ? 1 : t);
+            assert_true(roaring_bitmap_contains(r, x) == expected);
+            card += expected;
+        }
+        assert_int_equal(roaring_bitmap_get_cardinality(r), card);
+        if (t <= 1) {
+            roaring_bitmap_t *u =
+                roaring_bitmap_or_many(N, (const roaring_bitmap_t **)bitmaps);
+            assert_true(roaring_bitmap_equals(r, u));
+            roaring_bitmap_free(u);
+        }
+        roaring_bitmap_free(r);
+    }
+    free(counts);
+    for (int i = 0; i < N; ++i) roaring_bitmap_free(bitmaps[i]);
+}
+
+static int64_t counted_live;
+
+static void *counting_malloc(size_t size) {
+    counted_live++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) counted_live++;
+    return realloc(ptr, size);
+}
+
+static void *counting_calloc(size_t nmemb, size_t size) {
+    counted_live++;
+    return calloc(nmemb, size);
+}
+
+static void counting_free(void *ptr) {
+    if (ptr != NULL) counted_live--;
+    free(ptr);
+}
+
+static void *counting_aligned_malloc(size_t alignment, size_t size) {
+    void *p;
+    if (posix_memalign(&p, alignment, size)) return NULL;
+    counted_live++;
+    return p;
+}
+
+static const roaring_memory_t counting_hook = {
+    .malloc = counting_malloc,
+    .realloc = counting_realloc,
+    .calloc = counting_calloc,
+    .free = counting_free,
+    .aligned_malloc = counting_aligned_malloc,
+    .aligned_free = counting_free,
+};
+
+static void memory_hook_workload(void) {
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 500000, 3);
+    roaring_bitmap_t *r2 = roaring_bitmap_from_range(100000, 300000, 1);
+    roaring_bitmap_run_optimize(r2);
+    roaring_bitmap_t *r3 = roaring_bitmap_copy(r1);
+    roaring_bitmap_or_inplace(r3, r2);
+    const roaring_bitmap_t *all[] = {r1, r2, r3};
+    roaring_bitmap_t *u = roaring_bitmap_or_many(3, all);
+    roaring_bitmap_t *a = roaring_bitmap_and(u, r2);
+    assert_int_equal(roaring_bitmap_get_cardinality(a), 200000);
+    roaring_bitmap_free(a);
+    roaring_bitmap_free(u);
+    roaring_bitmap_free(r3);
+    roaring_bitmap_free(r2);
+    roaring_bitmap_free(r1);
+}
+
+void test_memory_hooks() {
+    counted_live = 0;
+    roaring_init_memory_hook(&counting_hook);
+    memory_hook_workload();
+    roaring_init_memory_hook(NULL);
+    assert_int_equal(counted_live, 0);
+
+    counted_live = 0;
+    roaring_set_thread_memory_hook(&counting_hook);
+    assert_true(roaring_has_thread_memory_hook());
+    roaring_bitmap_t *r = roaring_bitmap_from_range(0, 100000, 1);
+    assert_true(counted_live > 0);
+    roaring_bitmap_free(r);
+    memory_hook_workload();
+    roaring_set_thread_memory_hook(NULL);
+    assert_false(roaring_has_thread_memory_hook());
+    assert_int_equal(counted_live, 0);
+}
+
+enum { BSI_COLUMNS = 200000 };
+
+/* the columns of foundset (or all) with a value that satisfies op */
+static roaring_bitmap_t *bsi_brute_force(const uint64_t *values,
+                                         const bool *has_value,
+                                         const roaring_bitmap_t *foundset,
+                                         roaring_bsi_operation_t op,
+                                         uint64_t x) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c) {
+        if (!has_value[c]) continue;
+        if (foundset != NULL && !roaring_bitmap_contains(foundset, c))
+            continue;
+        const uint64_t v = values[c];
+        const bool in[] = {v < x, v <= x, v == x, v >= x, v > x};
+        if (in[op]) roaring_bitmap_add(r, c);
+    }
+    return r;
+}
+
+void test_bsi() {
+    uint64_t *values = malloc(BSI_COLUMNS * sizeof(uint64_t));
+    bool *has_value = malloc(BSI_COLUMNS * sizeof(bool));
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c) {
+        // a skewed column: mostly small values, a few large ones
+        values[c] = rand() % 4 == 0 ? (uint64_t)rand() * 1000
+                                    : (uint64_t)(rand() % 300);
+        has_value[c] = true;
+    }
+    roaring_bsi_t *appended = roaring_bsi_create();
+    assert_true(roaring_bsi_append(appended, 0, values, BSI_COLUMNS));
+    assert_false(roaring_bsi_append(appended, 1 << 16, values, 1));
+    // the same values one at a time, leaving some columns out
+    roaring_bsi_t *b = roaring_bsi_create();
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c) {
+        if (c % 7 == 3) {
+            has_value[c] = false;
+            continue;
+        }
+        roaring_bsi_set_value(b, c, rand());  // overwritten
+        roaring_bsi_set_value(b, c, values[c]);
+    }
+    roaring_bitmap_t *foundset = roaring_bitmap_create();
+    for (uint32_t c = 0; c < BSI_COLUMNS; c += 1 + c % 5)
+        roaring_bitmap_add(foundset, c);
+    roaring_bitmap_run_optimize(foundset);
+
+    uint64_t value;
+    assert_true(roaring_bsi_get_value(b, 12, &value));
+    assert_true(value == values[12]);
+    assert_false(roaring_bsi_get_value(b, BSI_COLUMNS, &value));
+
+    const uint64_t probes[] = {0, 1, 150, 299, 300, values[42], UINT64_MAX};
+    for (size_t p = 0; p < sizeof(probes) / sizeof(probes[0]); ++p) {
+        for (int op = ROARING_BSI_LT; op <= ROARING_BSI_GT; ++op) {
+            for (int withfoundset = 0; withfoundset <= 1; ++withfoundset) {
+                const roaring_bitmap_t *fs = withfoundset ? foundset : NULL;
+                roaring_bitmap_t *expected =
+                    bsi_brute_force(values, has_value, fs, op, probes[p]);
+                roaring_bitmap_t *got = roaring_bsi_compare(b, op, probes[p], fs);
+                assert_true(roaring_bitmap_equals(expected, got));
+                roaring_bitmap_free(got);
+                roaring_bitmap_free(expected);
+            }
+        }
+    }
+    roaring_bitmap_t *between = roaring_bsi_range(b, 100, 200, foundset);
+    roaring_bitmap_t *ge = roaring_bsi_compare(b, ROARING_BSI_GE, 100, foundset);
+    roaring_bitmap_t *le = roaring_bsi_compare(b, ROARING_BSI_LE, 200, NULL);
+    roaring_bitmap_and_inplace(ge, le);
+    assert_true(roaring_bitmap_get_cardinality(between) > 0);
+    assert_true(roaring_bitmap_equals(between, ge));
+    roaring_bitmap_free(between);
+    roaring_bitmap_free(ge);
+    roaring_bitmap_free(le);
+
+    uint64_t sum = 0, count = 0, all_sum = 0;
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c) {
+        all_sum += values[c];
+        if (has_value[c] && roaring_bitmap_contains(foundset, c)) {
+            sum += values[c];
+            count++;
+        }
+    }
+    uint64_t n;
+    assert_true(roaring_bsi_sum(b, foundset, &n) == sum);
+    assert_true(n == count);
+    assert_true(roaring_bsi_sum(appended, NULL, &n) == all_sum);
+    assert_true(n == BSI_COLUMNS);
+
+    // the top k are above a threshold, with ties broken by column
+    const uint64_t k = 1000;
+    roaring_bitmap_t *top = roaring_bsi_top_k(b, k, foundset);
+    assert_int_equal(roaring_bitmap_get_cardinality(top), k);
+    uint64_t lowest = UINT64_MAX;
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c)
+        if (roaring_bitmap_contains(top, c) && values[c] < lowest)
+            lowest = values[c];
+    roaring_bitmap_t *above =
+        roaring_bsi_compare(b, ROARING_BSI_GT, lowest, foundset);
+    assert_true(roaring_bitmap_get_cardinality(above) < k);
+    for (uint32_t c = 0; c < BSI_COLUMNS; ++c)
+        if (roaring_bitmap_contains(above, c))
+            assert_true(roaring_bitmap_contains(top, c));
+    roaring_bitmap_free(above);
+    roaring_bitmap_free(top);
+    top = roaring_bsi_top_k(appended, 3 * BSI_COLUMNS, NULL);
+    assert_true(roaring_bitmap_equals(top, appended->ebm));
+    roaring_bitmap_free(top);
+    // only ties: the smallest columns
+    roaring_bsi_t *constant = roaring_bsi_create();
+    for (uint32_t c = 10; c < 100; ++c) roaring_bsi_set_value(constant, c, 5);
+    top = roaring_bsi_top_k(constant, 3, NULL);
+    assert_true(roaring_bitmap_get_cardinality(top) == 3 &&
+                roaring_bitmap_contains(top, 10) &&
+                roaring_bitmap_contains(top, 12));
+    roaring_bitmap_free(top);
+
+    roaring_bsi_free(constant);
+    roaring_bitmap_free(foundset);
+    roaring_bsi_free(appended);
+    roaring_bsi_free(b);
+    free(has_value);
+    free(values);
+}
+
+static void check_index_build(const uint32_t *values, const uint32_t *rows,
+                              uint32_t n, uint32_t number_of_values) {
+    roaring_bitmap_t **equal =
+        roaring_bitmap_index_build(values, rows, n, number_of_values, false);
+    roaring_bitmap_t **range =
+        roaring_bitmap_index_build(values, rows, n, number_of_values, true);
+    assert_non_null(equal);
+    assert_non_null(range);
+    roaring_bitmap_t *below = roaring_bitmap_create();
+    for (uint32_t v = 0; v < number_of_values; ++v) {
+        roaring_bitmap_t *expected = roaring_bitmap_create();
+        for (uint32_t i = 0; i < n; ++i)
+            if (values[i] == v)
+                roaring_bitmap_add(expected, rows == NULL ? i : rows[i]);
+        assert_true(roaring_bitmap_equals(equal[v], expected));
+        roaring_bitmap_or_inplace(below, expected);
+        assert_true(roaring_bitmap_equals(range[v], below));
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(equal[v]);
+        roaring_bitmap_free(range[v]);
+    }
+    roaring_bitmap_free(below);
+    free(equal);
+    free(range);
+}
+
+void test_index_build() {
+    enum { N = 300000, NUMBER_OF_VALUES = 7 };
+    uint32_t *values = malloc(N * sizeof(uint32_t));
+    uint32_t *rows = malloc(N * sizeof(uint32_t));
+    // sparse rows in any order, with repeats
+    for (uint32_t i = 0; i < N; ++i) {
+        values[i] = (i * 2654435761u >> 13) % NUMBER_OF_VALUES;
+        rows[i] = (i * 40503u) % (N / 2) * 3;
+    }
+    check_index_build(values, rows, N, NUMBER_OF_VALUES);
+    // dense rows, and a clustered column that makes runs
+    check_index_build(values, NULL, N, NUMBER_OF_VALUES);
+    for (uint32_t i = 0; i < N; ++i) values[i] = i / 10000 % NUMBER_OF_VALUES;
+    check_index_build(values, NULL, N, NUMBER_OF_VALUES);
+    roaring_bitmap_t **equal =
+        roaring_bitmap_index_build(values, NULL, N, NUMBER_OF_VALUES, false);
+    assert_int_equal(equal[0]->high_low_container->typecodes[0],
+                     RUN_CONTAINER_TYPE_CODE);
+    for (uint32_t v = 0; v < NUMBER_OF_VALUES; ++v)
+        roaring_bitmap_free(equal[v]);
+    free(equal);
+    // with a memory hook, the array still comes from malloc
+    counted_live = 0;
+    roaring_set_thread_memory_hook(&counting_hook);
+    equal =
+        roaring_bitmap_index_build(values, NULL, N, NUMBER_OF_VALUES, false);
+    for (uint32_t v = 0; v < NUMBER_OF_VALUES; ++v)
+        roaring_bitmap_free(equal[v]);
+    roaring_set_thread_memory_hook(NULL);
+    assert_int_equal(counted_live, 0);
+    free(equal);
+    // out of range values
+    values[N / 2] = NUMBER_OF_VALUES;
+    assert_null(
+        roaring_bitmap_index_build(values, rows, N, NUMBER_OF_VALUES, false));
+    free(values);
+    free(rows);
+}
+
+static void trace_callback(const char *operation, uint64_t nanoseconds,
+                           void *param) {
+    (void)nanoseconds;
+    const char **last = param;
+    assert_null(*last);  // one call per top-level operation
+    *last = operation;
+}
+
+void test_trace() {
+    roaring_bitmap_t *x1 = roaring_bitmap_create();
+    roaring_bitmap_t *x2 = roaring_bitmap_create();
+    // key 0: two arrays, key 1: two bitsets whose intersection is an array
+    for (uint32_t i = 0; i < 100; ++i) {
+        roaring_bitmap_add(x1, i);
+        roaring_bitmap_add(x2, i + 50);
+    }
+    for (uint32_t i = 0; i < 5000; ++i) {
+        roaring_bitmap_add(x1, 65536 + i);
+        roaring_bitmap_add(x2, 65536 + 2 * i);
+    }
+    roaring_trace_counters_t counters;
+    roaring_trace_reset_counters();
+    roaring_bitmap_t *and = roaring_bitmap_and(x1, x2);
+    roaring_trace_get_counters(&counters);
+    const bool enabled = roaring_trace_enabled();
+    const int A = ARRAY_CONTAINER_TYPE_CODE, B = BITSET_CONTAINER_TYPE_CODE;
+    assert_int_equal(counters.kernel_calls[ROARING_TRACE_AND][4 * A + A],
+                     enabled);
+    assert_int_equal(counters.kernel_calls[ROARING_TRACE_AND][4 * B + B],
+                     enabled);
+    assert_int_equal(counters.kernel_calls[ROARING_TRACE_OR][4 * B + B], 0);
+    assert_int_equal(counters.conversions[B][A], enabled);
+    assert_int_equal(counters.allocations[A], 2 * enabled);
+    assert_int_equal(counters.allocations[B], 0);
+
+    roaring_trace_reset_counters();
+    roaring_bitmap_free(and);
+    roaring_trace_get_counters(&counters);
+    assert_int_equal(counters.frees[A], 2 * enabled);
+
+    // copy on write: the first change to a copy unshares a container
+    x1->copy_on_write = true;
+    roaring_bitmap_t *copy = roaring_bitmap_copy(x1);
+    roaring_bitmap_add(copy, 7);
+    roaring_bitmap_add(copy, 8);
+    roaring_trace_get_counters(&counters);
+    assert_int_equal(counters.unshares, enabled);
+
+    // only the outermost operation is reported
+    const char *last = NULL;
+    roaring_trace_set_callback(trace_callback, &last);
+    const roaring_bitmap_t *many[3] = {x1, x2, copy};
+    roaring_bitmap_t *or = roaring_bitmap_or_many(3, many);
+    if (enabled)
+        assert_string_equal(last, "roaring_bitmap_or_many");
+    else
+        assert_null(last);
+    roaring_trace_set_callback(NULL, NULL);
+    roaring_bitmap_free(or);
+    roaring_bitmap_free(copy);
+    roaring_bitmap_free(x1);
+    roaring_bitmap_free(x2);
+}
+
+void test_range_cardinality() {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    assert_int_equal(roaring_bitmap_minimum(r), UINT32_MAX);
+    assert_int_equal(roaring_bitmap_maximum(r), 0);
+    assert_int_equal(roaring_bitmap_range_cardinality(r, 0, UINT64_MAX), 0);
+    // an array, a bitset, a run and the last container
+    enum { N = 6 };
+    const uint32_t keys[N] = {0, 1, 2, 5, 6, 65535};
+    for (uint32_t i = 0; i < 1000; ++i) roaring_bitmap_add(r, 7 * i + 3);
+    for (uint32_t i = 0; i < 20000; ++i) roaring_bitmap_add(r, 65536 + 3 * i);
+    for (uint32_t i = 0; i < 65536; ++i) roaring_bitmap_add(r, 2 * 65536 + i);
+    for (uint32_t i = 100; i < 30000; ++i) roaring_bitmap_add(r, 5 * 65536 + i);
+    roaring_bitmap_add(r, 6 * 65536 + 65535);
+    roaring_bitmap_add(r, UINT32_MAX);
+    roaring_bitmap_run_optimize(r);
+    assert_int_equal(roaring_bitmap_minimum(r), 3);
+    assert_int_equal(roaring_bitmap_maximum(r), UINT32_MAX);
+    const uint64_t total = roaring_bitmap_get_cardinality(r);
+    assert_int_equal(roaring_bitmap_range_cardinality(r, 0, UINT64_MAX),
+                     total);
+    assert_int_equal(
+        roaring_bitmap_range_cardinality(r, 0, UINT64_C(0x100000000)), total);
+    assert_int_equal(roaring_bitmap_range_cardinality(r, 0, UINT32_MAX),
+                     total - 1);
+    assert_int_equal(roaring_bitmap_range_cardinality(r, 10, 10), 0);
+    assert_int_equal(roaring_bitmap_range_cardinality(r, 11, 10), 0);
+    // bounds on and around the container boundaries and at random
+    uint32_t card;
+    uint32_t *values = roaring_bitmap_to_uint32_array(r, &card);
+    const int64_t offsets[] = {-1, 0, 1, 100, 32768, 65535, 65536};
+    enum { OFFSETS = sizeof(offsets) / sizeof(offsets[0]) };
+    uint64_t bounds[OFFSETS * N + 200];
+    int n = 0;
+    for (int k = 0; k < N; ++k)
+        for (int o = 0; o < OFFSETS; ++o)
+            if (keys[k] > 0 || offsets[o] >= 0)
+                bounds[n++] = ((int64_t)keys[k] << 16) + offsets[o];
+    srand(1234);
+    while (n < (int)(sizeof(bounds) / sizeof(bounds[0])))
+        bounds[n++] = (uint64_t)rand() % (7 * 65536);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; j += 7) {
+            uint64_t expected = 0;
+            for (uint32_t k = 0; k < card; ++k)
+                expected += values[k] >= bounds[i] && values[k] < bounds[j];
+            assert_int_equal(
+                roaring_bitmap_range_cardinality(r, bounds[i], bounds[j]),
+                expected);
+        }
+    free(values);
+    roaring_bitmap_free(r);
+}
+
+// adds to r, in the container of the given key, one of SHAPES sets of values
+// that are subsets of one another in various ways and stored in all the
+// container types
+enum { SHAPES = 7 };
+static void add_shape(roaring_bitmap_t *r, uint32_t key, int shape) {
+    const uint32_t base = key << 16;
+    roaring_bitmap_t *c = roaring_bitmap_create();
+    switch (shape) {
+        case 0:  // a run
+        case 1:  // the same as a bitset
+            for (uint32_t i = 100; i < 30000; ++i)
+                roaring_bitmap_add(c, base + i);
+            break;
+        case 2:  // an array
+            for (uint32_t i = 100; i < 2000; i += 10)
+                roaring_bitmap_add(c, base + i);
+            break;
+        case 3:  // two runs
+        case 4:  // the same as an array
+            for (uint32_t i = 200; i < 300; ++i)
+                roaring_bitmap_add(c, base + i);
+            for (uint32_t i = 1000; i < 1100; ++i)
+                roaring_bitmap_add(c, base + i);
+            break;
+        case 5:  // a sparse bitset
+            for (uint32_t i = 100; i < 30000; i += 3)
+                roaring_bitmap_add(c, base + i);
+            break;
+        default:  // almost everything, as a bitset
+            for (uint32_t i = 0; i < 65536; ++i)
+                if (i % 5000 != 1) roaring_bitmap_add(c, base + i);
+    }
+    if (shape == 0 || shape == 3) roaring_bitmap_run_optimize(c);
+    roaring_bitmap_or_inplace(r, c);
+    roaring_bitmap_free(c);
+}
+
+void test_is_subset() {
+    const uint32_t keys[] = {0, 1, 5, 9, 100, 65535};
+    enum { KEYS = sizeof(keys) / sizeof(keys[0]) };
+    roaring_bitmap_t *empty = roaring_bitmap_create();
+    srand(4321);
+    for (int trial = 0; trial < 300; ++trial) {
+        roaring_bitmap_t *r1 = roaring_bitmap_create();
+        roaring_bitmap_t *r2 = roaring_bitmap_create();
+        for (int k = 0; k < KEYS; ++k) {
+            // r1 misses more keys than r2
+            if (rand() % 4 != 0) add_shape(r1, keys[k], rand() % SHAPES);
+            if (rand() % 8 != 0) add_shape(r2, keys[k], rand() % SHAPES);
+        }
+        for (int pass = 0; pass < 2; ++pass) {
+            roaring_bitmap_t *inter = roaring_bitmap_and(r1, r2);
+            const bool subset = roaring_bitmap_equals(inter, r1);
+            const bool strict =
+                subset && roaring_bitmap_get_cardinality(r1) <
+                              roaring_bitmap_get_cardinality(r2);
+            assert_int_equal(roaring_bitmap_is_subset(r1, r2), subset);
+            assert_int_equal(roaring_bitmap_is_strict_subset(r1, r2), strict);
+            roaring_bitmap_free(inter);
+            assert_true(roaring_bitmap_is_subset(r1, r1));
+            assert_false(roaring_bitmap_is_strict_subset(r1, r1));
+            assert_true(roaring_bitmap_is_subset(empty, r1));
+            assert_int_equal(roaring_bitmap_is_strict_subset(empty, r1),
+                             roaring_bitmap_get_cardinality(r1) > 0);
+            assert_int_equal(roaring_bitmap_is_subset(r1, empty),
+                             roaring_bitmap_get_cardinality(r1) == 0);
+            roaring_bitmap_t *swap = r1;
+            r1 = r2;
+            r2 = swap;
+        }
+        roaring_bitmap_free(r1);
+        roaring_bitmap_free(r2);
+    }
+    assert_true(roaring_bitmap_is_subset(empty, empty));
+    assert_false(roaring_bitmap_is_strict_subset(empty, empty));
+    roaring_bitmap_free(empty);
+}
+
+void test_range_uint32_array() {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    uint32_t one;
+    assert_int_equal(roaring_bitmap_range_uint32_array(r, 0, 1, &one), 0);
+    assert_int_equal(
+        roaring_bitmap_range_values_uint32_array(r, 0, UINT64_MAX, 1, &one), 0);
+    // an array, a bitset, a run and the last container
+    for (uint32_t i = 0; i < 1000; ++i) roaring_bitmap_add(r, 7 * i + 3);
+    for (uint32_t i = 0; i < 20000; ++i) roaring_bitmap_add(r, 65536 + 3 * i);
+    for (uint32_t i = 0; i < 65536; ++i) roaring_bitmap_add(r, 2 * 65536 + i);
+    for (uint32_t i = 100; i < 30000; i += 50)
+        for (uint32_t j = i; j < i + 20; ++j)
+            roaring_bitmap_add(r, 5 * 65536 + j);
+    roaring_bitmap_add(r, UINT32_MAX);
+    roaring_bitmap_run_optimize(r);
+    uint32_t card;
+    uint32_t *values = roaring_bitmap_to_uint32_array(r, &card);
+    // pages of all sizes, in buffers of exactly limit values so that an
+    // overrun is caught by the sanitizers
+    const size_t limits[] = {1, 7, 64, 1000, 65536, 100000};
+    for (size_t l = 0; l < sizeof(limits) / sizeof(limits[0]); ++l) {
+        uint32_t *page = malloc(limits[l] * sizeof(uint32_t));
+        size_t offset = 0;
+        for (;;) {
+            const size_t n =
+                roaring_bitmap_range_uint32_array(r, offset, limits[l], page);
+            const size_t expected =
+                offset + limits[l] <= card ? limits[l] : card - offset;
+            assert_int_equal(n, expected);
+            assert_true(memcmp(page, values + offset, n * sizeof(uint32_t)) ==
+                        0);
+            if (n < limits[l]) break;
+            offset += n;
+        }
+        assert_int_equal(
+            roaring_bitmap_range_uint32_array(r, card + 5, limits[l], page), 0);
+        free(page);
+    }
+    // value ranges, on and around the container boundaries and at random
+    const uint64_t keys[] = {0, 1, 2, 5, 65535};
+    uint64_t bounds[5 * 3 + 60];
+    int n = 0;
+    for (int k = 0; k < 5; ++k) {
+        bounds[n++] = keys[k] << 16;
+        bounds[n++] = (keys[k] << 16) + 1;
+        bounds[n++] = (keys[k] << 16) + 65535;
+    }
+    srand(5678);
+    while (n < (int)(sizeof(bounds) / sizeof(bounds[0])))
+        bounds[n++] = (uint64_t)rand() % (6 * 65536);
+    uint32_t *page = malloc(card * sizeof(uint32_t));
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; j += 3) {
+            uint32_t first = 0;
+            while (first < card && values[first] < bounds[i]) ++first;
+            uint32_t end = first;
+            while (end < card && values[end] < bounds[j]) ++end;
+            const size_t expected = end > first ? end - first : 0;
+            assert_int_equal(roaring_bitmap_range_values_uint32_array(
+                                 r, bounds[i], bounds[j], card, page),
+                             expected);
+            assert_true(memcmp(page, values + first,
+                               expected * sizeof(uint32_t)) == 0);
+            if (expected > 2) {  // a short page
+                assert_int_equal(roaring_bitmap_range_values_uint32_array(
+                                     r, bounds[i], bounds[j], 2, page),
+                                 2);
+                assert_int_equal(page[1], values[first + 1]);
+            }
+        }
+    assert_int_equal(roaring_bitmap_range_values_uint32_array(
+                         r, UINT32_MAX, UINT64_MAX, card, page),
+                     1);
+    assert_int_equal(page[0], UINT32_MAX);
+    free(page);
+    free(values);
+    roaring_bitmap_free(r);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_range_and_serialize), 
@@ -1430,6 +2372,7 @@ int main() {
         cmocka_unit_test(test_serialize),
         cmocka_unit_test(test_portable_serialize), cmocka_unit_test(test_add),
         cmocka_unit_test(test_contains),
+        cmocka_unit_test(test_remove),
         cmocka_unit_test(test_intersection_array_x_array),
         cmocka_unit_test(test_intersection_array_x_array_inplace),
         cmocka_unit_test(test_intersection_bitset_x_bitset),
@@ -1459,6 +2402,19 @@ int main() {
         cmocka_unit_test(test_inplace_negation_run1),
         cmocka_unit_test(test_inplace_negation_run2),
         cmocka_unit_test(test_inplace_rand_flips),
+        cmocka_unit_test(test_many_containers),
+        cmocka_unit_test(test_memory_hooks),
+        cmocka_unit_test(test_statistics),
+        cmocka_unit_test(test_shrink_to_fit),
+        cmocka_unit_test(test_run_optimize_parallel),
+        cmocka_unit_test(test_expression),
+        cmocka_unit_test(test_threshold),
+        cmocka_unit_test(test_bsi),
+        cmocka_unit_test(test_index_build),
+        cmocka_unit_test(test_trace),
+        cmocka_unit_test(test_range_cardinality),
+        cmocka_unit_test(test_is_subset),
+        cmocka_unit_test(test_range_uint32_array),
         // cmocka_unit_test(test_run_to_bitset),
         // cmocka_unit_test(test_run_to_array),
     };
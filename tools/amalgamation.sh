@@ -0,0 +1,65 @@
+#!/bin/bash
+# Writes the library as a single header, roaring.h, and a single source
+# file, roaring.c, into the given directory (default: the current one):
+#
+#   ./tools/amalgamation.sh amalgamation
+#   cc -std=c11 -O3 -march=native -c amalgamation/roaring.c
+#
+# The compiler then sees every kernel and every caller at once, as with LTO.
+# Headers are inlined in the order they are first included, each only once.
+set -e
+BASE=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${1:-.}
+mkdir -p "$OUT"
+
+declare -A SEEN
+
+# print the file, replacing the includes of the headers of include/ by their
+# content the first time and by nothing afterwards
+inline_file() {
+  local line header
+  while IFS= read -r line || [ -n "$line" ]; do
+    if [[ $line =~ ^[[:space:]]*#[[:space:]]*include[[:space:]]*\"([^\"]+)\" ]]; then
+      header=${BASH_REMATCH[1]}
+      [ -f "$BASE/include/$header" ] || header=$(dirname "$2")/$header
+      header=$(realpath -m --relative-to="$BASE/include" "$BASE/include/$header")
+      if [ -f "$BASE/include/$header" ]; then
+        if [ -z "${SEEN[$header]}" ]; then
+          SEEN[$header]=1
+          echo "/* begin file include/$header */"
+          inline_file "$BASE/include/$header" "$header"
+          echo "/* end file include/$header */"
+        fi
+        continue
+      fi
+    fi
+    # the feature test macros must precede every system header, see below
+    [[ $line =~ ^#define[[:space:]]+(_POSIX_C_SOURCE|_GNU_SOURCE) ]] && continue
+    echo "$line"
+  done < "$1"
+}
+
+HEADERS=$(cd "$BASE/include" && find . -name '*.h' | sed 's|^\./||' | sort)
+SOURCES=$(cd "$BASE/src" && find . -name '*.c' | sed 's|^\./||' | sort)
+
+{
+  echo "/* auto-generated by tools/amalgamation.sh, do not edit */"
+  for h in $HEADERS; do
+    # headers included by another one come out where they are first needed
+    echo "#include \"$h\""
+  done > "$OUT/.amalgamation_includes.h"
+  inline_file "$OUT/.amalgamation_includes.h" ""
+} > "$OUT/roaring.h"
+
+{
+  echo "/* auto-generated by tools/amalgamation.sh, do not edit */"
+  echo "#define _POSIX_C_SOURCE 200112L  // posix_memalign, clock_gettime"
+  echo "#include \"roaring.h\""
+  for h in $HEADERS; do SEEN[$h]=1; done  # all in roaring.h
+  for c in $SOURCES; do
+    echo "/* begin file src/$c */"
+    inline_file "$BASE/src/$c" "$c"
+    echo "/* end file src/$c */"
+  done
+} > "$OUT/roaring.c"
+rm "$OUT/.amalgamation_includes.h"
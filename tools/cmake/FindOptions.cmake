@@ -3,6 +3,45 @@ if(SANITIZE)
   set(SANITIZE_FLAGS "-fsanitize=address -fno-omit-frame-pointer -fsanitize=undefined")
 endif()
 
+set(TRACE_FLAGS "")
+if(ROARING_TRACE)
+  set(TRACE_FLAGS "-DROARING_TRACE")
+endif()
+
+# With whole-program inlining decisions (LTO, PGO), -Winline reports every
+# inline function left out of a cold path.
+set(LTO_FLAGS "")
+if(ENABLE_LTO)
+  set(LTO_FLAGS "-flto -Wno-inline")
+  if(CMAKE_C_COMPILER_ID STREQUAL "GNU")
+    if(NOT CMAKE_C_COMPILER_VERSION VERSION_LESS 10)
+      set(LTO_FLAGS "-flto=auto -Wno-inline")  # parallel link-time jobs
+    endif()
+    # the static library needs the plugin-aware archiver
+    find_program(GCC_AR gcc-ar)
+    find_program(GCC_RANLIB gcc-ranlib)
+    if(GCC_AR AND GCC_RANLIB)
+      set(CMAKE_AR ${GCC_AR})
+      set(CMAKE_RANLIB ${GCC_RANLIB})
+    endif()
+  endif()
+endif()
+
+# Profiles are keyed by object file path: GENERATE, train, then reconfigure
+# the same build directory with USE.
+set(PGO_FLAGS "")
+if(PGO STREQUAL "GENERATE")
+  set(PGO_FLAGS "-fprofile-generate=${PGO_DIR} -Wno-inline")
+elseif(PGO STREQUAL "USE")
+  if(CMAKE_C_COMPILER_ID MATCHES "Clang")
+    set(PGO_FLAGS "-fprofile-use=${PGO_DIR}/default.profdata -Wno-inline")
+  else()
+    set(PGO_FLAGS "-fprofile-use=${PGO_DIR} -fprofile-correction -Wno-missing-profile -Wno-inline")
+  endif()
+elseif(NOT PGO STREQUAL "OFF")
+  message(FATAL_ERROR "PGO must be OFF, GENERATE or USE")
+endif()
+
 set(OPT_FLAGS "-march=native")
 if(AVX_TUNING)
   set (OPT_FLAGS "-DUSEAVX -mavx2 ${OPT_FLAGS}" )
@@ -13,4 +52,4 @@ set(WARNING_FLAGS "-Wall -Winline -Wshadow -Wextra -pedantic")
 
 set(CMAKE_C_FLAGS_DEBUG "-ggdb")
 set(CMAKE_C_FLAGS_RELEASE "-O3")
-set(CMAKE_C_FLAGS "${STD_FLAGS} ${OPT_FLAGS} ${INCLUDE_FLAGS} ${WARNING_FLAGS} ${SANITIZE_FLAGS} ")
+set(CMAKE_C_FLAGS "${STD_FLAGS} ${OPT_FLAGS} ${INCLUDE_FLAGS} ${WARNING_FLAGS} ${SANITIZE_FLAGS} ${TRACE_FLAGS} ${LTO_FLAGS} ${PGO_FLAGS} ")